@@ -0,0 +1,107 @@
+///////////////////////////////////////////////////////////////////////////////
+//                       Copyright (c) 2011 - 2012 by                        //
+//                                Simon Pratt                                //
+//                           (All rights reserved)                           //
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// FILE:    Allocator.cpp                                                    //
+//                                                                           //
+// MODULE:  Persistent Skip List                                             //
+//                                                                           //
+// NOTES:   Defined inline, since this file is included by the header.       //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+#ifndef ALLOCATOR_CPP
+#define ALLOCATOR_CPP
+
+#include <new>
+#include <cassert>
+#include "Allocator.hpp"
+
+using namespace persistent_skip_list;
+
+///////////////////////////////////////////////////////////////////////////////
+// HeapAllocator Implementation                                              //
+///////////////////////////////////////////////////////////////////////////////
+
+inline void* HeapAllocator::allocate(size_t bytes) {
+  return ::operator new(bytes);
+}
+
+inline void HeapAllocator::deallocate(void* p, size_t) {
+  ::operator delete(p);
+}
+
+inline void HeapAllocator::release(void) {
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ArenaAllocator Implementation                                             //
+///////////////////////////////////////////////////////////////////////////////
+
+inline ArenaAllocator::ArenaAllocator(size_t chunkSize)
+  : chunk_size(roundUp(chunkSize)), chunks(), cursor(NULL), limit(NULL)
+{
+  assert(chunkSize > 0);
+  for(size_t i = 0; i < SIZE_CLASSES; ++i)
+    free_lists[i] = NULL;
+}
+
+inline ArenaAllocator::~ArenaAllocator(void) {
+  release();
+}
+
+inline size_t ArenaAllocator::roundUp(size_t bytes) {
+  return (bytes + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+}
+
+inline void* ArenaAllocator::allocate(size_t bytes) {
+  bytes = roundUp(bytes > 0 ? bytes : 1);
+  size_t size_class = bytes / ALIGNMENT;
+  // reuse a freed block of the same size class
+  if(size_class < SIZE_CLASSES && free_lists[size_class] != NULL) {
+    void* block = free_lists[size_class];
+    free_lists[size_class] = *(void**)block;
+    return block;
+  }
+  // large blocks get a chunk of their own, so the current one isn't wasted
+  if(bytes > chunk_size / 4) {
+    char* chunk = (char*)::operator new(bytes);
+    // keep the current chunk at the back
+    chunks.insert(chunks.end() - (chunks.empty() ? 0 : 1), chunk);
+    return chunk;
+  }
+  // start a new chunk if the current one is full
+  if(cursor == NULL || (size_t)(limit - cursor) < bytes) {
+    cursor = (char*)::operator new(chunk_size);
+    limit = cursor + chunk_size;
+    chunks.push_back(cursor);
+  }
+  // bump the pointer
+  void* block = cursor;
+  cursor += bytes;
+  return block;
+}
+
+inline void ArenaAllocator::deallocate(void* p, size_t bytes) {
+  if(p == NULL)
+    return;
+  size_t size_class = roundUp(bytes > 0 ? bytes : 1) / ALIGNMENT;
+  // blocks too large for a free list wait for release
+  if(size_class >= SIZE_CLASSES)
+    return;
+  *(void**)p = free_lists[size_class];
+  free_lists[size_class] = p;
+}
+
+inline void ArenaAllocator::release(void) {
+  while(! chunks.empty()) {
+    ::operator delete(chunks.back());
+    chunks.pop_back();
+  }
+  cursor = limit = NULL;
+  for(size_t i = 0; i < SIZE_CLASSES; ++i)
+    free_lists[i] = NULL;
+}
+
+#endif
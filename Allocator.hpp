@@ -0,0 +1,248 @@
+//-*- mode: c++ -*-////////////////////////////////////////////////////////////
+//                       Copyright (c) 2011 - 2012 by                        //
+//                                Simon Pratt                                //
+//                           (All rights reserved)                           //
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// FILE:    Allocator.hpp                                                    //
+//                                                                           //
+// MODULE:  Persistent Skip List                                             //
+//                                                                           //
+// PURPOSE: Provides allocator policies from which the skip list allocates   //
+//          its nodes and next pointer arrays.                               //
+//                                                                           //
+// NOTES:   An allocator policy is any class with the methods below.         //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// Public Variable:                     Description:                         //
+// ----------------                     ------------                         //
+// HeapAllocator                        Allocates each block with operator   //
+//                                      new.                                 //
+// ArenaAllocator                       Bump allocates blocks from large     //
+//                                      chunks, and frees all of them at     //
+//                                      once.                                //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+//                             Public Methods:                               //
+//                                                                           //
+// allocate(size_t)          - returns a block of at least the given size    //
+// deallocate(void*,size_t)  - returns a block of the given size             //
+// release()                 - frees every block at once, if supported       //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+#ifndef ALLOCATOR_HPP
+#define ALLOCATOR_HPP
+
+#include <cstddef>
+#include <vector>
+
+namespace persistent_skip_list {
+
+  /////////////////////////////////////////////////////////////////////////////
+  // HeapAllocator interface                                                 //
+  /////////////////////////////////////////////////////////////////////////////
+  class HeapAllocator {
+  public:
+    ///////////////////////////////////////////////////////////////////////////
+    //                                                                       //
+    // FUNCTION NAME: allocate                                               //
+    //                                                                       //
+    // PURPOSE:       Allocates a block with operator new.                   //
+    //                                                                       //
+    // SECURITY:      public                                                 //
+    //                                                                       //
+    // PARAMETERS                                                            //
+    //   Type/Name:   size_t/bytes                                           //
+    //   Description: The size of the block.                                 //
+    //                                                                       //
+    // RETURN:                                                               //
+    //   Type/Name:   void*                                                  //
+    //   Description: The block.                                             //
+    //                                                                       //
+    // NOTES:         None.                                                  //
+    //                                                                       //
+    ///////////////////////////////////////////////////////////////////////////
+    void* allocate(size_t bytes);
+
+    ///////////////////////////////////////////////////////////////////////////
+    //                                                                       //
+    // FUNCTION NAME: deallocate                                             //
+    //                                                                       //
+    // PURPOSE:       Frees a block with operator delete.                    //
+    //                                                                       //
+    // SECURITY:      public                                                 //
+    //                                                                       //
+    // PARAMETERS                                                            //
+    //   Type/Name:   void*/p                                                //
+    //   Description: The block to free.                                     //
+    //                                                                       //
+    //   Type/Name:   size_t/bytes                                           //
+    //   Description: The size with which the block was allocated.           //
+    //                                                                       //
+    // RETURN:        Void.                                                  //
+    //                                                                       //
+    // NOTES:         None.                                                  //
+    //                                                                       //
+    ///////////////////////////////////////////////////////////////////////////
+    void deallocate(void* p, size_t bytes);
+
+    ///////////////////////////////////////////////////////////////////////////
+    //                                                                       //
+    // FUNCTION NAME: release                                                //
+    //                                                                       //
+    // PURPOSE:       Does nothing, since every block is freed by            //
+    //                deallocate.                                            //
+    //                                                                       //
+    // SECURITY:      public                                                 //
+    //                                                                       //
+    // PARAMETERS                                                            //
+    //   Type/Name:   Void.                                                  //
+    //   Description: None.                                                  //
+    //                                                                       //
+    // RETURN:        Void.                                                  //
+    //                                                                       //
+    // NOTES:         None.                                                  //
+    //                                                                       //
+    ///////////////////////////////////////////////////////////////////////////
+    void release(void);
+  };
+
+  /////////////////////////////////////////////////////////////////////////////
+  // ArenaAllocator interface                                                //
+  /////////////////////////////////////////////////////////////////////////////
+  class ArenaAllocator {
+  public:
+    ///////////////////////////////////////////////////////////////////////////
+    //                                                                       //
+    // FUNCTION NAME: ArenaAllocator                                         //
+    //                                                                       //
+    // PURPOSE:       Constructor.                                           //
+    //                                                                       //
+    // SECURITY:      public                                                 //
+    //                                                                       //
+    // PARAMETERS                                                            //
+    //   Type/Name:   size_t/chunkSize                                       //
+    //   Description: The size of the chunks from which blocks are bump      //
+    //                allocated.                                             //
+    //                                                                       //
+    // NOTES:         No memory is allocated until the first block.          //
+    //                                                                       //
+    ///////////////////////////////////////////////////////////////////////////
+    ArenaAllocator(size_t chunkSize = 1 << 20);
+
+    ///////////////////////////////////////////////////////////////////////////
+    //                                                                       //
+    // FUNCTION NAME: ~ArenaAllocator                                        //
+    //                                                                       //
+    // PURPOSE:       Destructor.                                            //
+    //                                                                       //
+    // SECURITY:      public                                                 //
+    //                                                                       //
+    // PARAMETERS                                                            //
+    //   Type/Name:   Void.                                                  //
+    //   Description: None.                                                  //
+    //                                                                       //
+    // RETURN:        Void.                                                  //
+    //                                                                       //
+    // NOTES:         Releases every chunk.                                  //
+    //                                                                       //
+    ///////////////////////////////////////////////////////////////////////////
+    ~ArenaAllocator(void);
+
+    ///////////////////////////////////////////////////////////////////////////
+    //                                                                       //
+    // FUNCTION NAME: allocate                                               //
+    //                                                                       //
+    // PURPOSE:       Allocates a block, reusing a freed block of the same   //
+    //                size class if there is one, and otherwise bumping a    //
+    //                pointer in the current chunk.                          //
+    //                                                                       //
+    // SECURITY:      public                                                 //
+    //                                                                       //
+    // PARAMETERS                                                            //
+    //   Type/Name:   size_t/bytes                                           //
+    //   Description: The size of the block.                                 //
+    //                                                                       //
+    // RETURN:                                                               //
+    //   Type/Name:   void*                                                  //
+    //   Description: The block, aligned to ALIGNMENT bytes.                 //
+    //                                                                       //
+    // NOTES:         Blocks larger than a quarter chunk get a chunk of      //
+    //                their own.                                             //
+    //                                                                       //
+    ///////////////////////////////////////////////////////////////////////////
+    void* allocate(size_t bytes);
+
+    ///////////////////////////////////////////////////////////////////////////
+    //                                                                       //
+    // FUNCTION NAME: deallocate                                             //
+    //                                                                       //
+    // PURPOSE:       Keeps a block on the free list of its size class for   //
+    //                reuse by allocate.                                     //
+    //                                                                       //
+    // SECURITY:      public                                                 //
+    //                                                                       //
+    // PARAMETERS                                                            //
+    //   Type/Name:   void*/p                                                //
+    //   Description: The block to free.                                     //
+    //                                                                       //
+    //   Type/Name:   size_t/bytes                                           //
+    //   Description: The size with which the block was allocated.           //
+    //                                                                       //
+    // RETURN:        Void.                                                  //
+    //                                                                       //
+    // NOTES:         Memory only returns to the system on release.          //
+    //                                                                       //
+    ///////////////////////////////////////////////////////////////////////////
+    void deallocate(void* p, size_t bytes);
+
+    ///////////////////////////////////////////////////////////////////////////
+    //                                                                       //
+    // FUNCTION NAME: release                                                //
+    //                                                                       //
+    // PURPOSE:       Frees every chunk, and so every block, at once.        //
+    //                                                                       //
+    // SECURITY:      public                                                 //
+    //                                                                       //
+    // PARAMETERS                                                            //
+    //   Type/Name:   Void.                                                  //
+    //   Description: None.                                                  //
+    //                                                                       //
+    // RETURN:        Void.                                                  //
+    //                                                                       //
+    // NOTES:         No destructors are run on the blocks.                  //
+    //                                                                       //
+    ///////////////////////////////////////////////////////////////////////////
+    void release(void);
+
+    // alignment of every block
+    static const size_t ALIGNMENT = 16;
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Kindly ignore my private parts                                        //
+    ///////////////////////////////////////////////////////////////////////////
+  private:
+    // number of size classes with free lists
+    static const size_t SIZE_CLASSES = 64;
+
+    size_t chunk_size;
+    std::vector<char*> chunks;
+    char* cursor;
+    char* limit;
+    // heads of singly linked lists of freed blocks, by size class
+    void* free_lists[SIZE_CLASSES];
+
+    // rounds a size up to a multiple of the alignment
+    static size_t roundUp(size_t bytes);
+
+    // arenas own their chunks, so can't be copied
+    ArenaAllocator(const ArenaAllocator&);
+    ArenaAllocator& operator=(const ArenaAllocator&);
+  };
+}
+
+#include "Allocator.cpp"
+
+#endif
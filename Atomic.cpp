@@ -0,0 +1,31 @@
+///////////////////////////////////////////////////////////////////////////////
+//                       Copyright (c) 2011 - 2012 by                        //
+//                                Simon Pratt                                //
+//                           (All rights reserved)                           //
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// FILE:    Atomic.cpp                                                       //
+//                                                                           //
+// MODULE:  Persistent Skip List                                             //
+//                                                                           //
+// NOTES:   None.                                                            //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+#ifndef ATOMIC_CPP
+#define ATOMIC_CPP
+
+#include "Atomic.hpp"
+
+using namespace persistent_skip_list;
+
+template <class T>
+T persistent_skip_list::atomicLoad(const T* p) {
+  return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+
+template <class T>
+void persistent_skip_list::atomicStore(T* p, T value) {
+  __atomic_store_n(p, value, __ATOMIC_RELEASE);
+}
+
+#endif
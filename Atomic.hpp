@@ -0,0 +1,81 @@
+//-*- mode: c++ -*-////////////////////////////////////////////////////////////
+//                       Copyright (c) 2011 - 2012 by                        //
+//                                Simon Pratt                                //
+//                           (All rights reserved)                           //
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// FILE:    Atomic.hpp                                                       //
+//                                                                           //
+// MODULE:  Persistent Skip List                                             //
+//                                                                           //
+// PURPOSE: Provides the atomic loads and stores with which the single       //
+//          writer publishes new versions to concurrent readers.             //
+//                                                                           //
+// NOTES:   Uses the GCC atomic builtins, which clang also provides, since   //
+//          the published fields are plain ints and pointers, which          //
+//          std::atomic can't wrap in place before C++20's atomic_ref.       //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+//                             Public Methods:                               //
+//                                                                           //
+// atomicLoad(const T*)      - loads a value stored by atomicStore           //
+// atomicStore(T*,T)         - stores a value after every earlier write      //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+#ifndef ATOMIC_HPP
+#define ATOMIC_HPP
+
+namespace persistent_skip_list {
+
+  /////////////////////////////////////////////////////////////////////////////
+  //                                                                         //
+  // FUNCTION NAME: atomicLoad                                               //
+  //                                                                         //
+  // PURPOSE:       Loads a value with acquire ordering, so every write      //
+  //                made before the value was stored is visible after.       //
+  //                                                                         //
+  // SECURITY:      public                                                   //
+  //                                                                         //
+  // PARAMETERS                                                              //
+  //   Type/Name:   const T*/p                                               //
+  //   Description: The location of an int or pointer to load.               //
+  //                                                                         //
+  // RETURN:                                                                 //
+  //   Type/Name:   T                                                        //
+  //   Description: The value at p.                                          //
+  //                                                                         //
+  // NOTES:         None.                                                    //
+  //                                                                         //
+  /////////////////////////////////////////////////////////////////////////////
+  template <class T>
+  T atomicLoad(const T* p);
+
+  /////////////////////////////////////////////////////////////////////////////
+  //                                                                         //
+  // FUNCTION NAME: atomicStore                                              //
+  //                                                                         //
+  // PURPOSE:       Stores a value with release ordering, publishing every   //
+  //                earlier write to readers which load the value.           //
+  //                                                                         //
+  // SECURITY:      public                                                   //
+  //                                                                         //
+  // PARAMETERS                                                              //
+  //   Type/Name:   T*/p                                                     //
+  //   Description: The location of an int or pointer to store.              //
+  //                                                                         //
+  //   Type/Name:   T/value                                                  //
+  //   Description: The value to store.                                      //
+  //                                                                         //
+  // RETURN:        Void.                                                    //
+  //                                                                         //
+  // NOTES:         None.                                                    //
+  //                                                                         //
+  /////////////////////////////////////////////////////////////////////////////
+  template <class T>
+  void atomicStore(T* p, T value);
+}
+
+#include "Atomic.cpp"
+
+#endif
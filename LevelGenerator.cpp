@@ -0,0 +1,48 @@
+///////////////////////////////////////////////////////////////////////////////
+//                       Copyright (c) 2011 - 2012 by                        //
+//                                Simon Pratt                                //
+//                           (All rights reserved)                           //
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// FILE:    LevelGenerator.cpp                                               //
+//                                                                           //
+// MODULE:  Persistent Skip List                                             //
+//                                                                           //
+// NOTES:   Defined inline, since this file is included by the header.       //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+#ifndef LEVELGENERATOR_CPP
+#define LEVELGENERATOR_CPP
+
+#include <cassert>
+#include "LevelGenerator.hpp"
+
+using namespace persistent_skip_list;
+
+///////////////////////////////////////////////////////////////////////////////
+// GeometricLevels Implementation                                            //
+///////////////////////////////////////////////////////////////////////////////
+
+inline GeometricLevels::GeometricLevels(uint64_t seed, int levelBits,
+					int maxHeight)
+  // xorshift never leaves the zero state
+  : state(seed != 0 ? seed : DEFAULT_SEED), level_bits(levelBits),
+    max_height(maxHeight)
+{
+  assert(levelBits > 0);
+  assert(maxHeight > 0);
+}
+
+inline int GeometricLevels::pickHeight(void) {
+  state ^= state >> 12;
+  state ^= state << 25;
+  state ^= state >> 27;
+  uint64_t r = state * 0x2545f4914f6cdd1dULL;
+  // each bit is zero with probability 1/2, so each run of level_bits
+  // zeros from the bottom is a level with probability 1/2^level_bits
+  int zeros = r == 0 ? 64 : __builtin_ctzll(r);
+  int height = 1 + zeros / level_bits;
+  return height < max_height ? height : max_height;
+}
+
+#endif
@@ -0,0 +1,113 @@
+//-*- mode: c++ -*-////////////////////////////////////////////////////////////
+//                       Copyright (c) 2011 - 2012 by                        //
+//                                Simon Pratt                                //
+//                           (All rights reserved)                           //
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// FILE:    LevelGenerator.hpp                                               //
+//                                                                           //
+// MODULE:  Persistent Skip List                                             //
+//                                                                           //
+// PURPOSE: Provides level generator policies, from which the skip list      //
+//          picks the height of each new node.                               //
+//                                                                           //
+// NOTES:   A level generator policy is any default constructible class      //
+//          with the method below.  Each skip list has its own, so lists     //
+//          in different threads share no state.                             //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// Public Variable:                     Description:                         //
+// ----------------                     ------------                         //
+// GeometricLevels                      Picks heights with a seeded          //
+//                                      xorshift generator, each level       //
+//                                      above the first with probability     //
+//                                      1/2^levelBits.                       //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+//                             Public Methods:                               //
+//                                                                           //
+// pickHeight()              - returns the height of a new node              //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+#ifndef LEVELGENERATOR_HPP
+#define LEVELGENERATOR_HPP
+
+#include <stdint.h>
+
+namespace persistent_skip_list {
+
+  /////////////////////////////////////////////////////////////////////////////
+  // GeometricLevels interface                                               //
+  /////////////////////////////////////////////////////////////////////////////
+  class GeometricLevels {
+  public:
+    // the seed of a default constructed generator
+    static constexpr uint64_t DEFAULT_SEED = 0x9e3779b97f4a7c15ULL;
+
+    ///////////////////////////////////////////////////////////////////////////
+    //                                                                       //
+    // FUNCTION NAME: GeometricLevels                                        //
+    //                                                                       //
+    // PURPOSE:       Constructor                                            //
+    //                                                                       //
+    // SECURITY:      public                                                 //
+    //                                                                       //
+    // PARAMETERS                                                            //
+    //   Type/Name:   uint64_t/seed                                          //
+    //   Description: The seed, so the same seed gives the same heights.     //
+    //                                                                       //
+    //   Type/Name:   int/levelBits                                          //
+    //   Description: The number of random bits per level, so a node         //
+    //                reaches each level above the first with probability    //
+    //                1/2^levelBits.                                         //
+    //                                                                       //
+    //   Type/Name:   int/maxHeight                                          //
+    //   Description: The greatest height picked.                            //
+    //                                                                       //
+    // RETURN:        Void.                                                  //
+    //                                                                       //
+    // NOTES:         Heights past 64/levelBits can't be picked.  A larger   //
+    //                levelBits makes shorter nodes, with fewer links to     //
+    //                read per node but more nodes per level to search.      //
+    //                                                                       //
+    ///////////////////////////////////////////////////////////////////////////
+    GeometricLevels(uint64_t seed=DEFAULT_SEED, int levelBits=1,
+		    int maxHeight=32);
+
+    ///////////////////////////////////////////////////////////////////////////
+    //                                                                       //
+    // FUNCTION NAME: pickHeight                                             //
+    //                                                                       //
+    // PURPOSE:       Picks the height of a new node.                        //
+    //                                                                       //
+    // SECURITY:      public                                                 //
+    //                                                                       //
+    // PARAMETERS                                                            //
+    //   Type/Name:   Void.                                                  //
+    //   Description: None.                                                  //
+    //                                                                       //
+    // RETURN:                                                               //
+    //   Type/Name:   int                                                    //
+    //   Description: A height from 1 to maxHeight.                          //
+    //                                                                       //
+    // NOTES:         Counts the trailing zero bits of one xorshift64*       //
+    //                output, levelBits to a level.                          //
+    //                                                                       //
+    ///////////////////////////////////////////////////////////////////////////
+    int pickHeight(void);
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Kindly ignore my private parts                                        //
+    ///////////////////////////////////////////////////////////////////////////
+  private:
+    uint64_t state;
+    int level_bits;
+    int max_height;
+  };
+}
+
+#include "LevelGenerator.cpp"
+
+#endif
@@ -22,79 +22,269 @@ using namespace persistent_skip_list;
 // ListNode Implementation                                                   //
 ///////////////////////////////////////////////////////////////////////////////
 
-template<class T>
-bool ListNode<T>::_SEEDED = false;
+template<class T, class Alloc, bool Ranked>
+Alloc ListNode<T,Alloc,Ranked>::shared_allocator;
 
-template<class T>
-void ListNode<T>::seed() {
-      if(_SEEDED)
-	return;
-      _SEEDED = true;
-      srand( time(0) );
+template<class T, class Alloc, bool Ranked>
+size_t ListNode<T,Alloc,Ranked>::align(size_t bytes) {
+  return (bytes + sizeof(void*) - 1) / sizeof(void*) * sizeof(void*);
 }
 
-template<class T>
-void ListNode<T>::initializeNode() {
-  incoming_nodes = new ListNode<T>*[height];
+template<class T, class Alloc, bool Ranked>
+size_t ListNode<T,Alloc,Ranked>::getStorageSize(int h, int s) {
+  assert(h > 0);
+  assert(s > 0);
+  // the times, the change log, the first change, then the incoming
+  // nodes, which searches never read
+  return align(s * sizeof(int)) + s * sizeof(TSA*) +
+    align(nextBlockSize(h)) + h * sizeof(ListNode<T,Alloc,Ranked>*);
+}
+
+template<class T, class Alloc, bool Ranked>
+void ListNode<T,Alloc,Ranked>::initializeNode(void* storage) {
+  assert(size > 0);
+  assert(allocator != NULL);
+  _ownsStorage = storage == NULL;
+  if(_ownsStorage)
+    storage = allocator->allocate(getStorageSize(height, size));
+  char* cursor = (char*)storage;
+  times = (int*)cursor;
+  cursor += align(size * sizeof(int));
+  next = (TSA**)cursor;
+  cursor += size * sizeof(TSA*) + align(nextBlockSize(height));
+  incoming_nodes = (ListNode<T,Alloc,Ranked>**)cursor;
+  next_count = 0;
+  _isInlineUsed = false;
+  for(int i = 0; i < height; ++i)
+    incoming_nodes[i] = NULL;
 }
 
-template<class T>
-ListNode<T>::ListNode(const T& original_data, int s)
-  : height(1), size(s), next(), data(original_data), 
-    _isPositiveInfinity(false), _isNegativeInfinity(false)
+template<class T, class Alloc, bool Ranked>
+ListNode<T,Alloc,Ranked>::ListNode(const T& original_data, int h, int s,
+				   Alloc* a, void* storage)
+  : ListNode(std::in_place,h,s,a,storage,original_data)
+{}
+
+template<class T, class Alloc, bool Ranked>
+template<class... Args>
+ListNode<T,Alloc,Ranked>::ListNode(std::in_place_t, int h, int s, Alloc* a,
+				   void* storage, Args&&... args)
+  : height(h), next_count(0), times(NULL), next(NULL),
+    data(std::forward<Args>(args)...),
+    _isPositiveInfinity(false), _isNegativeInfinity(false), _isRetired(false),
+    _ownsStorage(true), _isInlineUsed(false), size(s), incoming_nodes(NULL),
+    allocator(a)
 {
-  if(!_SEEDED)
-    seed();
-  // pick height, modified from Pat Morin's Open Data Structures
-  int bitCheck = 1;
-  int r = rand();
-  // check each bit in the binary representation of r, from the
-  // least significant to the most significant.  The number of 1's
-  // in a row from the least significant position determines the
-  // height of the node.
-  while((r & bitCheck) != 0) {
-    // if bit is 1, increment height
-    ++height;
-    // check next bit
-    bitCheck <<= 1;
-  }
-  initializeNode();
+  assert(h > 0);
+  initializeNode(storage);
 }
 
-template<class T>
-ListNode<T>::ListNode(int h, const bool positive)
-  : height(h), next(), data(),
-    _isPositiveInfinity(positive), _isNegativeInfinity(!positive)
+template<class T, class Alloc, bool Ranked>
+ListNode<T,Alloc,Ranked>::ListNode(int h, const bool positive, int s, Alloc* a,
+				   void* storage)
+  : height(h), next_count(0), times(NULL), next(NULL),
+    data(),
+    _isPositiveInfinity(positive), _isNegativeInfinity(!positive),
+    _isRetired(false), _ownsStorage(true), _isInlineUsed(false), size(s),
+    incoming_nodes(NULL), allocator(a)
 {
   assert(h > 0);
-  initializeNode();
+  initializeNode(storage);
+}
+
+template<class T, class Alloc, bool Ranked>
+ListNode<T,Alloc,Ranked>::ListNode(const ListNode<T,Alloc,Ranked>& original,
+				   void* storage)
+  : height(original.height), next_count(0), times(NULL), next(NULL),
+    data(original.data),
+    _isPositiveInfinity(original._isPositiveInfinity),
+    _isNegativeInfinity(original._isNegativeInfinity),
+    _isRetired(false), _ownsStorage(true), _isInlineUsed(false),
+    size(original.size), incoming_nodes(NULL),
+    allocator(original.allocator)
+{
+  initializeNode(storage);
+  // the copy has the same predecessors as the original
+  for(int i = 0; i < height; ++i)
+    incoming_nodes[i] = original.incoming_nodes[i];
 }
 
-template<class T>
-ListNode<T>::~ListNode() {
+template<class T, class Alloc, bool Ranked>
+ListNode<T,Alloc,Ranked>::~ListNode() {
   // clean up next
-  while(! next.empty() ) {
-    TSA* back = next.back();
-    next.pop_back();
-    delete back;
+  while(next_count > 0)
+    destroyNext(next[--next_count]);
+  if(_ownsStorage)
+    allocator->deallocate(times, getStorageSize(height, size));
+}
+
+template<class T, class Alloc, bool Ranked>
+typename ListNode<T,Alloc,Ranked>::TSA*
+ListNode<T,Alloc,Ranked>::inlineNext() {
+  return (TSA*)(next + size);
+}
+
+template<class T, class Alloc, bool Ranked>
+size_t ListNode<T,Alloc,Ranked>::nextBytes(TSA* tsa) {
+  return tsa == inlineNext() ? 0 : nextBlockSize(tsa->getSize());
+}
+
+template<class T, class Alloc, bool Ranked>
+typename ListNode<T,Alloc,Ranked>::TSA*
+ListNode<T,Alloc,Ranked>::allocateNext(int t, int lowest) {
+  assert(this != NULL);
+  assert(lowest >= 0);
+  assert(lowest < height);
+  // the elements and widths are stored right after the array in the
+  // same block, which for the node's first change is the node's own
+  int count = height - lowest;
+  TSA* block;
+  if(lowest == 0 && next_count == 0 && !_isInlineUsed) {
+    block = inlineNext();
+    _isInlineUsed = true;
+  } else
+    block = (TSA*)allocator->allocate(nextBlockSize(count));
+  TSA* tsa = new (block) TSA(t, count, links(block));
+  if constexpr(Ranked)
+    for(int i = 0; i < count; ++i)
+      widths(tsa)[i] = 0;
+  return tsa;
+}
+
+template<class T, class Alloc, bool Ranked>
+typename ListNode<T,Alloc,Ranked>::TSA*
+ListNode<T,Alloc,Ranked>::createNext(int t) {
+  assert(this != NULL);
+  return allocateNext(t, 0);
+}
+
+template<class T, class Alloc, bool Ranked>
+typename ListNode<T,Alloc,Ranked>::TSA*
+ListNode<T,Alloc,Ranked>::createNext(int t, const TSA& old_next) {
+  assert(this != NULL);
+  TSA* tsa = allocateNext(t, 0);
+  for(int i = 0; i < height; ++i) {
+    setLink(tsa,i,getLink(&old_next,i));
+    if constexpr(Ranked)
+      setWidth(tsa,i,getWidth(&old_next,i));
   }
-  delete [] incoming_nodes;
+  return tsa;
 }
 
-template<class T>
-T ListNode<T>::getData() {
+template<class T, class Alloc, bool Ranked>
+typename ListNode<T,Alloc,Ranked>::TSA*
+ListNode<T,Alloc,Ranked>::createNext(int t, const TSA& latest, int lowest) {
+  assert(this != NULL);
+  assert(next_count > 0 && next[next_count-1] == &latest);
+  // replacing the latest change keeps the levels it changed
+  if(latest.getTime() == t && getLowest(&latest) < lowest)
+    lowest = getLowest(&latest);
+  // the first change holds every level
+  if(times[0] >= t)
+    lowest = 0;
+  TSA* tsa = allocateNext(t, lowest);
+  for(int i = lowest; i < height; ++i) {
+    setLink(tsa,i,getLink(&latest,i));
+    if constexpr(Ranked)
+      setWidth(tsa,i,getWidth(&latest,i));
+  }
+  return tsa;
+}
+
+template<class T, class Alloc, bool Ranked>
+void ListNode<T,Alloc,Ranked>::destroyNext(TSA* tsa) {
+  assert(tsa->getSize() <= height);
+  size_t block_size = nextBytes(tsa);
+  tsa->~TSA();
+  if(tsa == inlineNext())
+    _isInlineUsed = false;
+  else
+    allocator->deallocate(tsa, block_size);
+}
+
+template<class T, class Alloc, bool Ranked>
+size_t ListNode<T,Alloc,Ranked>::nextBlockSize(int count) {
+  return sizeof(TSA) + count * (sizeof(Link) + (Ranked ? sizeof(int) : 0));
+}
+
+template<class T, class Alloc, bool Ranked>
+typename ListNode<T,Alloc,Ranked>::Link*
+ListNode<T,Alloc,Ranked>::links(const TSA* next) {
+  return (Link*)(next + 1);
+}
+
+template<class T, class Alloc, bool Ranked>
+int* ListNode<T,Alloc,Ranked>::widths(const TSA* next) {
+  return (int*)(links(next) + next->getSize());
+}
+
+template<class T, class Alloc, bool Ranked>
+const typename ListNode<T,Alloc,Ranked>::TSA*
+ListNode<T,Alloc,Ranked>::getHolder(const TSA* tsa, int h) {
+  assert(h >= 0);
+  assert(h < height);
+  if(h >= getLowest(tsa))
+    return tsa;
+  // the levels below a change are those of the latest change before
+  // it, and changes before the time of tsa are never replaced
+  int index = 0, count = numberOfNextChangeIndices();
+  while(index+1 < count && times[index+1] < tsa->getTime())
+    ++index;
+  assert(times[index] < tsa->getTime());
+  while(h < getLowest(next[index]))
+    --index;
+  return next[index];
+}
+
+template<class T, class Alloc, bool Ranked>
+typename ListNode<T,Alloc,Ranked>::Link
+ListNode<T,Alloc,Ranked>::getLink(const TSA* next, int h) {
+  next = getHolder(next, h);
+  return links(next)[h - getLowest(next)];
+}
+
+template<class T, class Alloc, bool Ranked>
+void ListNode<T,Alloc,Ranked>::setLink(TSA* next, int h, Link link) {
+  assert(h >= getLowest(next));
+  assert(h < height);
+  links(next)[h - getLowest(next)] = link;
+}
+
+template<class T, class Alloc, bool Ranked>
+int ListNode<T,Alloc,Ranked>::getLowest(const TSA* next) {
+  assert(next->getSize() <= height);
+  return height - next->getSize();
+}
+
+template<class T, class Alloc, bool Ranked>
+int ListNode<T,Alloc,Ranked>::getWidth(const TSA* next, int h) {
+  static_assert(Ranked, "Only a Ranked node has widths");
+  next = getHolder(next, h);
+  return widths(next)[h - getLowest(next)];
+}
+
+template<class T, class Alloc, bool Ranked>
+void ListNode<T,Alloc,Ranked>::setWidth(TSA* next, int h, int width) {
+  static_assert(Ranked, "Only a Ranked node has widths");
+  assert(h >= getLowest(next));
+  assert(h < height);
+  widths(next)[h - getLowest(next)] = width;
+}
+
+template<class T, class Alloc, bool Ranked>
+const T& ListNode<T,Alloc,Ranked>::getData() const {
   assert(this != NULL);
   return data;
 }
 
-template<class T>
-int ListNode<T>::getHeight() {
+template<class T, class Alloc, bool Ranked>
+int ListNode<T,Alloc,Ranked>::getHeight() const {
   assert(this != NULL);
   return height;
 }
   
-template<class T>
-int ListNode<T>::getNextChangeIndex(int t) {
+template<class T, class Alloc, bool Ranked>
+int ListNode<T,Alloc,Ranked>::getNextChangeIndex(int t) {
   assert(this != NULL);
   int index = -1;
   int begin = 0, end = numberOfNextChangeIndices() -1;
@@ -102,7 +292,7 @@ int ListNode<T>::getNextChangeIndex(int t) {
   // binary search
   while(begin <= end) {
     index = (begin+end)/2;
-    timeFound = getNextAtIndex(index)->getTime();
+    timeFound = times[index];
     if(timeFound == t) {
       // done, break out of loop
       break;
@@ -118,93 +308,160 @@ int ListNode<T>::getNextChangeIndex(int t) {
   return index;
 }
 
-template <class T>
-TimeStampedArray< SmartPointer< ListNode<T> > >*
-ListNode<T>::getNextAtIndex(int ci) {
+template <class T, class Alloc, bool Ranked>
+typename ListNode<T,Alloc,Ranked>::TSA*
+ListNode<T,Alloc,Ranked>::getNextAtIndex(int ci) {
   assert(this != NULL);
   assert(ci >= 0);
   assert(ci < numberOfNextChangeIndices());
   return next[ci];
 }
 
-template <class T>
-int ListNode<T>::numberOfNextChangeIndices() {
+template <class T, class Alloc, bool Ranked>
+int ListNode<T,Alloc,Ranked>::numberOfNextChangeIndices() {
   assert(this != NULL);
-  return (int)next.size();
+  // the writer publishes each entry before counting it
+  return atomicLoad(&next_count);
 }
   
-template <class T>
-TimeStampedArray< SmartPointer< ListNode<T> > >*
-ListNode<T>::getNext(int t) {
+template <class T, class Alloc, bool Ranked>
+typename ListNode<T,Alloc,Ranked>::TSA*
+ListNode<T,Alloc,Ranked>::getNext(int t) {
   assert(this != NULL);
   assert(t >= 0);
-  // find nearest time
-  int index = getNextChangeIndex(t);
-  // if there are no pointers, bail
-  if(index == -1) return NULL;
-  // use this to store the node to be returned
-  TSA* tsa = getNextAtIndex(index);
-  // since the nearest time might be later than the desired time, we
-  // go backwards in time until we reach the point which immediately
-  // precedes the query time
-  while(tsa->getTime() > t) {
-    --index;
-    if(index < 0)
-      return NULL;
-    tsa = getNextAtIndex(index);
+  // the change log holds at most size entries, so a reverse linear
+  // search from the latest change is constant time and finds the
+  // present in one step
+  for(int index = numberOfNextChangeIndices()-1; index >= 0; --index)
+    if(times[index] <= t)
+      return next[index];
+  // no next pointers at or before time t
+  return NULL;
+}
+
+template <class T, class Alloc, bool Ranked>
+void ListNode<T,Alloc,Ranked>::getNexts(const int* at, int count,
+					TSA** nexts) {
+  assert(this != NULL);
+  int changes = numberOfNextChangeIndices();
+  // the times are sorted, so the change in effect only moves forward
+  int index = -1;
+  for(int i = 0; i < count; ++i) {
+    assert(i == 0 || at[i-1] <= at[i]);
+    while(index+1 < changes && times[index+1] <= at[i])
+      ++index;
+    nexts[i] = index >= 0 ? next[index] : NULL;
   }
-  return tsa;
 }
 
-template <class T>
-void ListNode<T>::setIncoming(int h, ListNode<T>* in) {
+template <class T, class Alloc, bool Ranked>
+bool ListNode<T,Alloc,Ranked>::isFull(int t) {
+  assert(this != NULL);
+  if(next_count < size)
+    return false;
+  // a change at the time of the latest change replaces it
+  return times[next_count-1] != t;
+}
+
+template <class T, class Alloc, bool Ranked>
+void ListNode<T,Alloc,Ranked>::setIncoming(int h,
+					   ListNode<T,Alloc,Ranked>* in) {
   assert(this != NULL);
   assert(h >= 0);
   assert(h < height);
   incoming_nodes[h] = in;
 }
 
-template <class T>
-ListNode<T>* ListNode<T>::getIncoming(int h) {
+template <class T, class Alloc, bool Ranked>
+ListNode<T,Alloc,Ranked>* ListNode<T,Alloc,Ranked>::getIncoming(int h) {
   assert(this != NULL);
   assert(h >= 0);
   assert(h < height);
   return incoming_nodes[h];
 }
 
-template <class T>
-int ListNode<T>::addNext(TimeStampedArray< SmartPointer< ListNode<T> > >* tsa) {
+template <class T, class Alloc, bool Ranked>
+int ListNode<T,Alloc,Ranked>::addNext(TSA* tsa) {
   assert(this != NULL);
   // since NULL is the default
   if(tsa == NULL)
     return -1; // bail if trying to set next to NULL
-  // if we have reached the max node size, create a new node with the new
-  // next array
-  if(next.size() >= size) {
-    // create new node
-    // add next on new node
-    // set next arrays on nodes with incoming pointers
-    //return 0;
-  }
+  // the skip list must copy this node if the change log is full
+  assert(! isFull(tsa->getTime()));
   // make sure time is strictly increasing
-  int lastIndex = (int)next.size()-1;
-  assert(lastIndex < 0 || tsa->getTime() >= next[lastIndex]->getTime());
-  if(lastIndex >= 0 && tsa->getTime() == next[lastIndex]->getTime()) {
-    TSA* prev = next[lastIndex];
+  int lastIndex = next_count-1;
+  assert(lastIndex < 0 || tsa->getTime() >= times[lastIndex]);
+  if(lastIndex >= 0 && tsa->getTime() == times[lastIndex]) {
+    // replace the latest change and free it at once.  This is safe
+    // only because no one holds a pointer to it: readers use times
+    // before the present, so they compare times[lastIndex] but never
+    // load next[lastIndex], and the writer must not keep an array
+    // from getNext(present) across a call which adds a change at
+    // present, but read it again from the node afterwards
+    assert(lastIndex > 0 || getLowest(tsa) == 0);
+    TSA* latest = next[lastIndex];
     next[lastIndex] = tsa;
-    delete prev;
+    destroyNext(latest);
   } else {
-    // finally, save the new set of next pointers
-    next.push_back(tsa);
+    // the first change holds every level
+    assert(lastIndex >= 0 || getLowest(tsa) == 0);
+    // finally, save the new set of next pointers, then publish them
+    next[next_count] = tsa;
+    times[next_count] = tsa->getTime();
+    atomicStore(&next_count, next_count+1);
   }
-  for(int i = 0; i < height; ++i)
-    tsa->getElement(i)->setIncoming(i,this);
+  // the levels below are unchanged
+  for(int i = getLowest(tsa); i < height; ++i)
+    getLink(tsa,i)->setIncoming(i,this);
   // success
   return 0;
 }
 
-template <class T>
-bool ListNode<T>::operator<(ListNode<T>& other) {
+template <class T, class Alloc, bool Ranked>
+size_t ListNode<T,Alloc,Ranked>::dropNextBefore(int t) {
+  assert(this != NULL);
+  // the first change still in effect at t
+  int first = 0;
+  while(first+1 < next_count && times[first+1] <= t)
+    ++first;
+  if(first == 0)
+    return 0;
+  size_t freed = 0, allocated = 0;
+  if(getLowest(next[first]) > 0) {
+    // the first change must hold every level, so gets a full copy
+    TSA* full = createNext(times[first],*next[first]);
+    allocated += nextBytes(full);
+    freed += nextBytes(next[first]);
+    destroyNext(next[first]);
+    next[first] = full;
+  }
+  for(int i = 0; i < first; ++i) {
+    freed += nextBytes(next[i]);
+    destroyNext(next[i]);
+  }
+  for(int i = first; i < next_count; ++i) {
+    next[i-first] = next[i];
+    times[i-first] = times[i];
+  }
+  next_count -= first;
+  // the changes destroyed include a full one, unless it was in the
+  // node's storage
+  return freed > allocated ? freed - allocated : 0;
+}
+
+template <class T, class Alloc, bool Ranked>
+size_t ListNode<T,Alloc,Ranked>::getBytes() {
+  assert(this != NULL);
+  size_t bytes =
+    sizeof(ListNode<T,Alloc,Ranked>) + getStorageSize(height, size);
+  for(int i = 0; i < next_count; ++i)
+    bytes += nextBytes(next[i]);
+  return bytes;
+}
+
+template <class T, class Alloc, bool Ranked>
+bool ListNode<T,Alloc,Ranked>::operator<(
+  const ListNode<T,Alloc,Ranked>& other) const {
   if(other._isNegativeInfinity)
     return false;
   else if(other._isPositiveInfinity)
@@ -212,8 +469,9 @@ bool ListNode<T>::operator<(ListNode<T>& other) {
   return operator<(other.data);
 }
 
-template <class T>
-bool ListNode<T>::operator>(ListNode<T>& other) {
+template <class T, class Alloc, bool Ranked>
+bool ListNode<T,Alloc,Ranked>::operator>(
+  const ListNode<T,Alloc,Ranked>& other) const {
   if(other._isNegativeInfinity)
     return true;
   else if(other._isPositiveInfinity)
@@ -221,23 +479,26 @@ bool ListNode<T>::operator>(ListNode<T>& other) {
   return operator>(other.data);
 }
 
-template <class T>
-bool ListNode<T>::operator<=(ListNode<T>& other) {
+template <class T, class Alloc, bool Ranked>
+bool ListNode<T,Alloc,Ranked>::operator<=(
+  const ListNode<T,Alloc,Ranked>& other) const {
   return !(operator>(other));
 }
 
-template <class T>
-bool ListNode<T>::operator>=(ListNode<T>& other) {
+template <class T, class Alloc, bool Ranked>
+bool ListNode<T,Alloc,Ranked>::operator>=(
+  const ListNode<T,Alloc,Ranked>& other) const {
   return !(operator<(other));
 }
 
-template <class T>
-bool ListNode<T>::operator==(ListNode<T>& other) {
+template <class T, class Alloc, bool Ranked>
+bool ListNode<T,Alloc,Ranked>::operator==(
+  const ListNode<T,Alloc,Ranked>& other) const {
   return operator<=(other) && operator>=(other);
 }
 
-template <class T>
-bool ListNode<T>::operator<(const T& datum) {
+template <class T, class Alloc, bool Ranked>
+bool ListNode<T,Alloc,Ranked>::operator<(const T& datum) const {
   if(this->_isPositiveInfinity)
     return false;
   if(this->_isNegativeInfinity)
@@ -245,8 +506,8 @@ bool ListNode<T>::operator<(const T& datum) {
   return data < datum;
 }
 
-template <class T>
-bool ListNode<T>::operator>(const T& datum) {
+template <class T, class Alloc, bool Ranked>
+bool ListNode<T,Alloc,Ranked>::operator>(const T& datum) const {
   if(this->_isPositiveInfinity)
     return true;
   if(this->_isNegativeInfinity)
@@ -254,55 +515,39 @@ bool ListNode<T>::operator>(const T& datum) {
   return data > datum;
 }
 
-template <class T>
-bool ListNode<T>::operator<=(const T& datum) {
+template <class T, class Alloc, bool Ranked>
+bool ListNode<T,Alloc,Ranked>::operator<=(const T& datum) const {
   return !(operator>(datum));
 }
 
-template <class T>
-bool ListNode<T>::operator>=(const T& datum) {
+template <class T, class Alloc, bool Ranked>
+bool ListNode<T,Alloc,Ranked>::operator>=(const T& datum) const {
   return !(operator<(datum));
 }
 
-template <class T>
-bool ListNode<T>::operator==(const T& datum) {
+template <class T, class Alloc, bool Ranked>
+bool ListNode<T,Alloc,Ranked>::operator==(const T& datum) const {
   return operator<=(datum) && operator>=(datum);
 }
 
-template <class T>
-bool ListNode<T>::isPositiveInfinity() {
+template <class T, class Alloc, bool Ranked>
+bool ListNode<T,Alloc,Ranked>::isPositiveInfinity() const {
   return _isPositiveInfinity;
 }
 
-template <class T>
-bool ListNode<T>::isNegativeInfinity() {
+template <class T, class Alloc, bool Ranked>
+bool ListNode<T,Alloc,Ranked>::isNegativeInfinity() const {
   return _isNegativeInfinity;
 }
 
-template < class T >
-void ListNode<T>::remove(int present) {
-  assert(! this->isNegativeInfinity());
-  assert(! this->isPositiveInfinity());
-  // start at the uppermost level
-  int start = height-1;
-  while(start >= 0) {
-    // determine how many levels are the same incoming node
-    int end = start;
-    while(end >= 0 && incoming_nodes[start] == incoming_nodes[end])
-      --end;
-    // set the next node on the incoming node
-    ListNode<T>* incoming = incoming_nodes[start];
-    TSA* this_next = next.back();
-    TSA* new_inc_next = new TSA(present,
-				incoming->getHeight(),
-				*(incoming->getNext(present)));
-    while(start > end) {
-      new_inc_next->setElement(start,
-			       this_next->getElement(start));
-      --start;
-    }
-    incoming->addNext(new_inc_next);
-  }
+template <class T, class Alloc, bool Ranked>
+void ListNode<T,Alloc,Ranked>::retire() {
+  _isRetired = true;
+}
+
+template <class T, class Alloc, bool Ranked>
+bool ListNode<T,Alloc,Ranked>::isRetired() const {
+  return _isRetired;
 }
 
 #endif
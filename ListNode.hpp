@@ -22,27 +22,31 @@
 #define LISTNODE_HPP
 
 // Standard libraries
-#include <vector>
+#include <cassert>
 #include <cstddef>
-#include <cstdlib>
+#include <utility>
 
 // My libraries
 #include "TimeStampedArray.hpp"
-#include "lib/SmartPointer/SmartPointer.hpp"
+#include "Allocator.hpp"
+#include "Atomic.hpp"
 
 namespace persistent_skip_list {
 
-  template <class T>
+  // A Ranked node keeps the width of each link beside it
+  template <class T, class Alloc = HeapAllocator, bool Ranked = false>
   class ListNode {
   public:
+    // a pointer to another node, owned by the skip list
+    typedef ListNode<T,Alloc,Ranked>* Link;
     // hereafter refered to as TSA
-    typedef TimeStampedArray< SmartPointer< ListNode<T> > > TSA;
+    typedef TimeStampedArray< Link > TSA;
 
     ///////////////////////////////////////////////////////////////////////////
     //                                                                       //
     // FUNCTION NAME: ListNode                                               //
     //                                                                       //
-    // PURPOSE:       Basic constructor                                      //
+    // PURPOSE:       Fixed height constructor                               //
     //                                                                       //
     // SECURITY:      public                                                 //
     //                                                                       //
@@ -50,10 +54,50 @@ namespace persistent_skip_list {
     //   Type/Name:   T/original_data                                        //
     //   Description: The value to store in the data of the ListNode         //
     //                                                                       //
-    // NOTES:         None.                                                  //
+    //   Type/Name:   int/h                                                  //
+    //   Description: The height of this node.                               //
+    //                                                                       //
+    //   Type/Name:   int/size                                               //
+    //   Description: The maximum number of next pointer changes stored at   //
+    //                this node before it must be copied.                    //
+    //                                                                       //
+    //   Type/Name:   Alloc*/allocator                                       //
+    //   Description: The allocator for the next pointers of this node.      //
+    //                                                                       //
+    //   Type/Name:   void*/storage                                          //
+    //   Description: getStorageSize(h,size) bytes following the node in     //
+    //                its block, or NULL to allocate them separately.        //
+    //                                                                       //
+    // NOTES:         Used when the skip list chooses the height.            //
     //                                                                       //
     ///////////////////////////////////////////////////////////////////////////
-    ListNode(const T&, int size=3);
+    ListNode(const T&, int h, int size, Alloc* allocator, void* storage=NULL);
+
+    ///////////////////////////////////////////////////////////////////////////
+    //                                                                       //
+    // FUNCTION NAME: ListNode                                               //
+    //                                                                       //
+    // PURPOSE:       In place constructor, which constructs the data from   //
+    //                arguments instead of copying it.                       //
+    //                                                                       //
+    // SECURITY:      public                                                 //
+    //                                                                       //
+    // PARAMETERS                                                            //
+    //   Type/Name:   std::in_place_t                                        //
+    //   Description: Selects this constructor.                              //
+    //                                                                       //
+    //   Type/Name:   int/h, int/size, Alloc*/allocator, void*/storage       //
+    //   Description: As for the fixed height constructor.                   //
+    //                                                                       //
+    //   Type/Name:   Args&&.../args                                         //
+    //   Description: The arguments of a constructor of T.                   //
+    //                                                                       //
+    // NOTES:         Passing a T&& moves it into the node.                  //
+    //                                                                       //
+    ///////////////////////////////////////////////////////////////////////////
+    template <class... Args>
+    ListNode(std::in_place_t, int h, int size, Alloc* allocator,
+	     void* storage, Args&&... args);
 
     ///////////////////////////////////////////////////////////////////////////
     //                                                                       //
@@ -71,10 +115,44 @@ namespace persistent_skip_list {
     //   Description: True for positive infinity, false for negative         //
     //                infinity.                                              //
     //                                                                       //
+    //   Type/Name:   int/size                                               //
+    //   Description: The maximum number of next pointer changes stored at   //
+    //                this node before it must be copied.                    //
+    //                                                                       //
+    //   Type/Name:   Alloc*/allocator                                       //
+    //   Description: The allocator for the next pointers of this node.      //
+    //                                                                       //
+    //   Type/Name:   void*/storage                                          //
+    //   Description: As for the fixed height constructor.                   //
+    //                                                                       //
     // NOTES:         None.                                                  //
     //                                                                       //
     ///////////////////////////////////////////////////////////////////////////
-    ListNode(int h, const bool positive);
+    ListNode(int h, const bool positive, int size=3,
+	     Alloc* allocator=&shared_allocator, void* storage=NULL);
+
+    ///////////////////////////////////////////////////////////////////////////
+    //                                                                       //
+    // FUNCTION NAME: ListNode                                               //
+    //                                                                       //
+    // PURPOSE:       Copy constructor used when a node's change log is      //
+    //                full.                                                  //
+    //                                                                       //
+    // SECURITY:      public                                                 //
+    //                                                                       //
+    // PARAMETERS                                                            //
+    //   Type/Name:   const ListNode<T>&/original                            //
+    //   Description: The node to copy.  Data, height, size, allocator and   //
+    //                incoming nodes are copied, the change log starts       //
+    //                empty.                                                 //
+    //                                                                       //
+    //   Type/Name:   void*/storage                                          //
+    //   Description: As for the fixed height constructor.                   //
+    //                                                                       //
+    // NOTES:         None.                                                  //
+    //                                                                       //
+    ///////////////////////////////////////////////////////////////////////////
+    ListNode(const ListNode<T,Alloc,Ranked>& original, void* storage=NULL);
     
     ///////////////////////////////////////////////////////////////////////////
     //                                                                       //
@@ -95,6 +173,34 @@ namespace persistent_skip_list {
     ///////////////////////////////////////////////////////////////////////////
     ~ListNode();
 
+    ///////////////////////////////////////////////////////////////////////////
+    //                                                                       //
+    // FUNCTION NAME: getStorageSize                                         //
+    //                                                                       //
+    // PURPOSE:       Returns the bytes a node keeps after itself in its     //
+    //                block.                                                 //
+    //                                                                       //
+    // SECURITY:      public                                                 //
+    //                                                                       //
+    // PARAMETERS                                                            //
+    //   Type/Name:   int/h                                                  //
+    //   Description: The height of the node.                                //
+    //                                                                       //
+    //   Type/Name:   int/size                                               //
+    //   Description: The size of the node's change log.                     //
+    //                                                                       //
+    // RETURN:                                                               //
+    //   Type/Name:   size_t                                                 //
+    //   Description: The bytes of the times, the change log, the first      //
+    //                change and the incoming nodes.                         //
+    //                                                                       //
+    // NOTES:         A block of sizeof(ListNode) plus this many bytes holds //
+    //                a node and what a search reads of it, while the first  //
+    //                change of its next pointers is the latest.             //
+    //                                                                       //
+    ///////////////////////////////////////////////////////////////////////////
+    static size_t getStorageSize(int h, int size);
+
     ///////////////////////////////////////////////////////////////////////////
     //                                                                       //
     // FUNCTION NAME: setHeight                                              //
@@ -133,7 +239,7 @@ namespace persistent_skip_list {
     // NOTES:         None.                                                  //
     //                                                                       //
     ///////////////////////////////////////////////////////////////////////////
-    T getData();
+    const T& getData() const;
 
     ///////////////////////////////////////////////////////////////////////////
     //                                                                       //
@@ -154,7 +260,7 @@ namespace persistent_skip_list {
     // NOTES:         None.                                                  //
     //                                                                       //
     ///////////////////////////////////////////////////////////////////////////
-    int getHeight();
+    int getHeight() const;
 
     ///////////////////////////////////////////////////////////////////////////
     //                                                                       //
@@ -241,11 +347,204 @@ namespace persistent_skip_list {
     //   Description: The array of next pointers at or immediately           //
     //                preceding the given time.                              //
     //                                                                       //
-    // NOTES:         None.                                                  //
+    // NOTES:         Scans at most size change indices, so runs in          //
+    //                constant time.                                         //
     //                                                                       //
     ///////////////////////////////////////////////////////////////////////////
     TSA* getNext(int t);
 
+    ///////////////////////////////////////////////////////////////////////////
+    //                                                                       //
+    // FUNCTION NAME: getNexts                                               //
+    //                                                                       //
+    // PURPOSE:       Retrieves the arrays of next pointers at many times,   //
+    //                as getNext does for each.                              //
+    //                                                                       //
+    // SECURITY:      public                                                 //
+    //                                                                       //
+    // PARAMETERS                                                            //
+    //   Type/Name:   const int*/at                                          //
+    //   Description: The times at which to retrieve the pointers, sorted.   //
+    //                                                                       //
+    //   Type/Name:   int/count                                              //
+    //   Description: The number of times.                                   //
+    //                                                                       //
+    //   Type/Name:   TSA**/nexts                                            //
+    //   Description: Where to write the array at each time, or NULL if      //
+    //                there is none.                                         //
+    //                                                                       //
+    // RETURN:        Void.                                                  //
+    //                                                                       //
+    // NOTES:         Scans the change log once for every time together.     //
+    //                                                                       //
+    ///////////////////////////////////////////////////////////////////////////
+    void getNexts(const int* at, int count, TSA** nexts);
+
+    ///////////////////////////////////////////////////////////////////////////
+    //                                                                       //
+    // FUNCTION NAME: isFull                                                 //
+    //                                                                       //
+    // PURPOSE:       Returns true if adding next pointers at time t would   //
+    //                exceed the size of the change log.                     //
+    //                                                                       //
+    // SECURITY:      public                                                 //
+    //                                                                       //
+    // PARAMETERS                                                            //
+    //   Type/Name:   int/t                                                  //
+    //   Description: The time at which next pointers would be added.        //
+    //                                                                       //
+    // RETURN:        bool - true if the node must be copied before next     //
+    //                pointers can be added at time t.                       //
+    //                                                                       //
+    // NOTES:         Next pointers at the time of the latest change replace //
+    //                that change, so never fill the log.                    //
+    //                                                                       //
+    ///////////////////////////////////////////////////////////////////////////
+    bool isFull(int t);
+
+    ///////////////////////////////////////////////////////////////////////////
+    //                                                                       //
+    // FUNCTION NAME: createNext                                             //
+    //                                                                       //
+    // PURPOSE:       Creates an array of next pointers for this node with   //
+    //                the node's allocator.                                  //
+    //                                                                       //
+    // SECURITY:      public                                                 //
+    //                                                                       //
+    // PARAMETERS                                                            //
+    //   Type/Name:   int/t                                                  //
+    //   Description: The timestamp of the array.                            //
+    //                                                                       //
+    //   Type/Name:   const TSA&/old_next                                    //
+    //   Description: An optional array of next pointers to copy.            //
+    //                                                                       //
+    // RETURN:                                                               //
+    //   Type/Name:   TSA*                                                   //
+    //   Description: An array as tall as this node, which must be given     //
+    //                to addNext.                                            //
+    //                                                                       //
+    // NOTES:         The array, its elements and, if Ranked, their widths   //
+    //                are one allocation.  Widths start at 0, or are copied  //
+    //                along with the elements.  old_next must be of this     //
+    //                node, unless it holds every level.                     //
+    //                                                                       //
+    ///////////////////////////////////////////////////////////////////////////
+    TSA* createNext(int t);
+    TSA* createNext(int t, const TSA& old_next);
+
+    ///////////////////////////////////////////////////////////////////////////
+    //                                                                       //
+    // FUNCTION NAME: createNext                                             //
+    //                                                                       //
+    // PURPOSE:       Creates a change to the next pointers of this node at  //
+    //                and above a level, which shares the levels below with  //
+    //                the latest change.                                     //
+    //                                                                       //
+    // SECURITY:      public                                                 //
+    //                                                                       //
+    // PARAMETERS                                                            //
+    //   Type/Name:   int/t                                                  //
+    //   Description: The timestamp of the array.                            //
+    //                                                                       //
+    //   Type/Name:   const TSA&/latest                                      //
+    //   Description: The latest next pointers of this node.                 //
+    //                                                                       //
+    //   Type/Name:   int/lowest                                             //
+    //   Description: The lowest level which may be changed.                 //
+    //                                                                       //
+    // RETURN:                                                               //
+    //   Type/Name:   TSA*                                                   //
+    //   Description: An array of the levels from lowest up, copied from     //
+    //                latest, which must be given to addNext.                //
+    //                                                                       //
+    // NOTES:         Levels below lowest are read from the change before,   //
+    //                so only levels from lowest up may be set.  If latest   //
+    //                is from time t the array replaces it, keeping any      //
+    //                levels it changed.                                     //
+    //                                                                       //
+    ///////////////////////////////////////////////////////////////////////////
+    TSA* createNext(int t, const TSA& latest, int lowest);
+
+    ///////////////////////////////////////////////////////////////////////////
+    //                                                                       //
+    // FUNCTION NAME: getLink                                                //
+    //                                                                       //
+    // PURPOSE:       Gets the next node at height h in an array from        //
+    //                createNext.                                            //
+    //                                                                       //
+    // SECURITY:      public                                                 //
+    //                                                                       //
+    // PARAMETERS                                                            //
+    //   Type/Name:   const TSA*/next                                        //
+    //   Description: The array of next pointers.                            //
+    //                                                                       //
+    //   Type/Name:   int/h                                                  //
+    //   Description: The height of the next pointer.                        //
+    //                                                                       //
+    // RETURN:                                                               //
+    //   Type/Name:   Link                                                   //
+    //   Description: The next node at height h.                             //
+    //                                                                       //
+    // NOTES:         The array must be of this node.  Levels below its      //
+    //                lowest are read from the changes before it, at most    //
+    //                size of them.  Use this rather than TSA::getElement,   //
+    //                which only indexes the levels the array holds.         //
+    //                                                                       //
+    ///////////////////////////////////////////////////////////////////////////
+    Link getLink(const TSA* next, int h);
+    void setLink(TSA* next, int h, Link link);  // same but sets
+    int getLowest(const TSA* next);  // the lowest level held
+
+    ///////////////////////////////////////////////////////////////////////////
+    //                                                                       //
+    // FUNCTION NAME: getWidth                                               //
+    //                                                                       //
+    // PURPOSE:       Gets the width of the next pointer at height h in an   //
+    //                array from createNext.                                 //
+    //                                                                       //
+    // SECURITY:      public                                                 //
+    //                                                                       //
+    // PARAMETERS                                                            //
+    //   Type/Name:   const TSA*/next                                        //
+    //   Description: The array of next pointers.                            //
+    //                                                                       //
+    //   Type/Name:   int/h                                                  //
+    //   Description: The height of the next pointer.                        //
+    //                                                                       //
+    // RETURN:                                                               //
+    //   Type/Name:   int                                                    //
+    //   Description: The number of steps along the bottom level from the    //
+    //                node to the next node at height h.                     //
+    //                                                                       //
+    // NOTES:         The skip list keeps the widths, which let it count     //
+    //                elements while searching.  As with getLink, the array  //
+    //                must be of this node.  Only a Ranked node has widths.  //
+    //                                                                       //
+    ///////////////////////////////////////////////////////////////////////////
+    int getWidth(const TSA* next, int h);
+    void setWidth(TSA* next, int h, int width);  // same but sets
+
+    ///////////////////////////////////////////////////////////////////////////
+    //                                                                       //
+    // FUNCTION NAME: destroyNext                                            //
+    //                                                                       //
+    // PURPOSE:       Returns an array of next pointers from createNext to   //
+    //                the node's allocator.                                  //
+    //                                                                       //
+    // SECURITY:      public                                                 //
+    //                                                                       //
+    // PARAMETERS                                                            //
+    //   Type/Name:   TSA*/tsa                                               //
+    //   Description: The array to destroy.                                  //
+    //                                                                       //
+    // RETURN:        Void.                                                  //
+    //                                                                       //
+    // NOTES:         Only for arrays never given to addNext, which the      //
+    //                node destroys itself.                                  //
+    //                                                                       //
+    ///////////////////////////////////////////////////////////////////////////
+    void destroyNext(TSA* tsa);
+
     ///////////////////////////////////////////////////////////////////////////
     //                                                                       //
     // FUNCTION NAME: addNext                                                //
@@ -260,11 +559,45 @@ namespace persistent_skip_list {
     //                                                                       //
     // RETURN:        int return code.  0 means success                      //
     //                                                                       //
-    // NOTES:         None.                                                  //
+    // NOTES:         The node must not be full at the time of next.  The    //
+    //                skip list copies full nodes before adding to them.     //
+    //                The node takes ownership of next, which must come      //
+    //                from createNext.  Next pointers at the time of the     //
+    //                latest change replace it, and the old array is freed   //
+    //                at once, so callers must not keep a pointer to it.     //
+    //                Readers only check the time of a change from the       //
+    //                present, never its next pointers.                      //
     //                                                                       //
     ///////////////////////////////////////////////////////////////////////////
     int addNext(TSA* next);
 
+    ///////////////////////////////////////////////////////////////////////////
+    //                                                                       //
+    // FUNCTION NAME: dropNextBefore                                         //
+    //                                                                       //
+    // PURPOSE:       Destroys the next pointers no longer in effect at any  //
+    //                time at or after t.                                    //
+    //                                                                       //
+    // SECURITY:      public                                                 //
+    //                                                                       //
+    // PARAMETERS                                                            //
+    //   Type/Name:   int/t                                                  //
+    //   Description: The earliest time still searched.                      //
+    //                                                                       //
+    // RETURN:                                                               //
+    //   Type/Name:   size_t                                                 //
+    //   Description: The number of bytes returned to the allocator.         //
+    //                                                                       //
+    // NOTES:         Keeps the latest next pointers at or before t, and     //
+    //                every later one, moving them to the front of the       //
+    //                change log, so not safe with concurrent readers.       //
+    //                                                                       //
+    ///////////////////////////////////////////////////////////////////////////
+    size_t dropNextBefore(int t);
+
+    // the number of bytes allocated for this node and its change log
+    size_t getBytes();
+
     ///////////////////////////////////////////////////////////////////////////
     //                                                                       //
     // FUNCTION NAME: operator<                                              //
@@ -283,17 +616,17 @@ namespace persistent_skip_list {
     // NOTES:         None.                                                  //
     //                                                                       //
     ///////////////////////////////////////////////////////////////////////////
-    bool operator<(ListNode<T>& other);
-    bool operator>(ListNode<T>& other);
-    bool operator<=(ListNode<T>& other);
-    bool operator>=(ListNode<T>& other);
-    bool operator==(ListNode<T>& other);
+    bool operator<(const ListNode<T,Alloc,Ranked>& other) const;
+    bool operator>(const ListNode<T,Alloc,Ranked>& other) const;
+    bool operator<=(const ListNode<T,Alloc,Ranked>& other) const;
+    bool operator>=(const ListNode<T,Alloc,Ranked>& other) const;
+    bool operator==(const ListNode<T,Alloc,Ranked>& other) const;
 
-    bool operator<(const T& datum);
-    bool operator>(const T& datum);
-    bool operator<=(const T& datum);
-    bool operator>=(const T& datum);
-    bool operator==(const T& datum);
+    bool operator<(const T& datum) const;
+    bool operator>(const T& datum) const;
+    bool operator<=(const T& datum) const;
+    bool operator>=(const T& datum) const;
+    bool operator==(const T& datum) const;
 
     ///////////////////////////////////////////////////////////////////////////
     //                                                                       //
@@ -316,7 +649,7 @@ namespace persistent_skip_list {
     // NOTES:         None.                                                  //
     //                                                                       //
     ///////////////////////////////////////////////////////////////////////////
-    void setIncoming(int h, ListNode<T>* in);
+    void setIncoming(int h, ListNode<T,Alloc,Ranked>* in);
 
     ///////////////////////////////////////////////////////////////////////////
     //                                                                       //
@@ -337,7 +670,7 @@ namespace persistent_skip_list {
     // NOTES:         None.                                                  //
     //                                                                       //
     ///////////////////////////////////////////////////////////////////////////
-    ListNode<T>* getIncoming(int h);
+    ListNode<T,Alloc,Ranked>* getIncoming(int h);
 
     ///////////////////////////////////////////////////////////////////////////
     //                                                                       //
@@ -357,27 +690,76 @@ namespace persistent_skip_list {
     // NOTES:         None.                                                  //
     //                                                                       //
     ///////////////////////////////////////////////////////////////////////////
-    bool isPositiveInfinity();
-    bool isNegativeInfinity();  // same but for negative infinity
+    bool isPositiveInfinity() const;
+    bool isNegativeInfinity() const;  // same but for negative infinity
+
+    ///////////////////////////////////////////////////////////////////////////
+    //                                                                       //
+    // FUNCTION NAME: retire                                                 //
+    //                                                                       //
+    // PURPOSE:       Marks this node as no longer in the present version,   //
+    //                because it was copied or removed.                      //
+    //                                                                       //
+    // SECURITY:      public                                                 //
+    //                                                                       //
+    // PARAMETERS                                                            //
+    //   Type/Name:   Void.                                                  //
+    //   Description: None.                                                  //
+    //                                                                       //
+    // RETURN:        Void.                                                  //
+    //                                                                       //
+    // NOTES:         Past versions may still reach a retired node.          //
+    //                                                                       //
+    ///////////////////////////////////////////////////////////////////////////
+    void retire();
+    bool isRetired() const;  // true if retire has been called
 
-    void remove(int);
-    
     ///////////////////////////////////////////////////////////////////////////
     // Kindly ignore my private parts                                        //
     ///////////////////////////////////////////////////////////////////////////
   private:
+    // the members read on every hop of a search come first
     int height;
-    unsigned int size;
-    vector<TSA*> next;
+    int next_count;
+    // the time of each change, first in the node's storage, so readers
+    // needn't follow changes from after the time they search
+    int* times;
+    // the change log, a fixed array of size entries so it never moves
+    // under concurrent readers, of which next_count are published
+    TSA** next;
     T data;
-    static bool _SEEDED; // must be initialized to false
     bool _isPositiveInfinity;
     bool _isNegativeInfinity;
+    bool _isRetired;
+    // false if the storage follows the node in the skip list's block
+    bool _ownsStorage;
+    // true while the first change's slot in the storage holds a change
+    bool _isInlineUsed;
+    int size;
+
+    ListNode<T,Alloc,Ranked>** incoming_nodes;
+    Alloc* allocator;
 
-    ListNode<T>** incoming_nodes;
+    // used by dummy nodes created without an allocator
+    static Alloc shared_allocator;
 
-    static void seed();
-    void initializeNode();
+    void initializeNode(void* storage);
+    // rounds a size up to keep the pointers which follow it aligned
+    static size_t align(size_t bytes);
+    // the slot for a change holding every level, after the change log
+    TSA* inlineNext();
+    // bytes allocated for a change, none if it is in the node's storage
+    size_t nextBytes(TSA* next);
+    // creates an array of next pointers at and above a level
+    TSA* allocateNext(int t, int lowest);
+    // size of the block holding an array of count levels
+    static size_t nextBlockSize(int count);
+    // the elements and widths, which follow the array in an array from
+    // createNext.  An unranked array has no widths
+    static Link* links(const TSA* next);
+    static int* widths(const TSA* next);
+    // the array of this node holding level h at the time of next
+    const TSA* getHolder(const TSA* next, int h);
   };
 }
 
@@ -18,139 +18,152 @@
 
 using namespace persistent_skip_list;
 
-template < class T >
-PSLIterator<T>::PSLIterator(SmartPointer<ListNode<T> >& node,
-			    PersistentSkipList<T>& psl,
-			    int time,
-			    int height)
+template < class T, class Alloc, class LevelGen, bool Ranked >
+PSLIterator<T,Alloc,LevelGen,Ranked>::PSLIterator(
+  ListNode<T,Alloc,Ranked>* node,
+  PersistentSkipList<T,Alloc,LevelGen,Ranked>& psl,
+  int time,
+  int height)
   : _psl(psl), _node(node), _time(time), _height(height)
 {
   assert(time >= 0);
   assert(height >= 0);
 }
 
-template < class T >
-PSLIterator<T>::~PSLIterator(void) {
+template < class T, class Alloc, class LevelGen, bool Ranked >
+PSLIterator<T,Alloc,LevelGen,Ranked>::~PSLIterator(void) {
 }
 
-template < class T >
-PSLIterator<T> PSLIterator<T>::getNext(void) {
-  PSLIterator<T> next(_node,_psl,_time,_height);
+template < class T, class Alloc, class LevelGen, bool Ranked >
+PSLIterator<T,Alloc,LevelGen,Ranked>
+PSLIterator<T,Alloc,LevelGen,Ranked>::getNext(void) {
+  PSLIterator<T,Alloc,LevelGen,Ranked> next(_node,_psl,_time,_height);
   return ++next;
 }
 
-template < class T >
-int PSLIterator<T>::getHeight(void) {
+template < class T, class Alloc, class LevelGen, bool Ranked >
+int PSLIterator<T,Alloc,LevelGen,Ranked>::getHeight(void) const {
   return _node->getHeight();
 }
 
-template < class T >
-int PSLIterator<T>::getSearchHeight(void) {
+template < class T, class Alloc, class LevelGen, bool Ranked >
+int PSLIterator<T,Alloc,LevelGen,Ranked>::getSearchHeight(void) const {
   return _height;
 }
 
-template < class T >
-void PSLIterator<T>::down(void) {
+template < class T, class Alloc, class LevelGen, bool Ranked >
+void PSLIterator<T,Alloc,LevelGen,Ranked>::down(void) {
   assert(_height > 0);
   --_height;
 }
 
-template < class T >
-void PSLIterator<T>::next(void) {
+template < class T, class Alloc, class LevelGen, bool Ranked >
+void PSLIterator<T,Alloc,LevelGen,Ranked>::next(void) {
   if(_node->isPositiveInfinity())
     return;
-  TimeStampedArray<SmartPointer<ListNode<T> > >* next = _node->getNext(_time);
+  typename ListNode<T,Alloc,Ranked>::TSA* next = _node->getNext(_time);
   assert(next != NULL);
-  assert(_height < next->getSize());
-  SmartPointer<ListNode<T> > nextNode = next->getElement(_height);
+  assert(_height < _node->getHeight());
+  ListNode<T,Alloc,Ranked>* nextNode = _node->getLink(next,_height);
   assert(nextNode != NULL);
   assert(nextNode->getHeight() > _height);
-  next = nextNode->getNext(_time);
-  if(next != NULL)
-    assert(next->getSize() == nextNode->getHeight());
   _node = nextNode;
 }
 
-template < class T >
-PSLIterator<T>& PSLIterator<T>::operator++(void) {
+template < class T, class Alloc, class LevelGen, bool Ranked >
+PSLIterator<T,Alloc,LevelGen,Ranked>&
+PSLIterator<T,Alloc,LevelGen,Ranked>::operator++(void) {
   next();
   return *this;
 }
 
-template < class T >
-T PSLIterator<T>::getDatum(void) {
+template < class T, class Alloc, class LevelGen, bool Ranked >
+const T& PSLIterator<T,Alloc,LevelGen,Ranked>::getDatum(void) const {
   return _node->getData();
 }
 
-template < class T >
-T PSLIterator<T>::operator*(void) {
+template < class T, class Alloc, class LevelGen, bool Ranked >
+const T& PSLIterator<T,Alloc,LevelGen,Ranked>::operator*(void) const {
   return getDatum();
 }
 
-template < class T >
-bool PSLIterator<T>::operator==(const PSLIterator<T>& other) {
+template < class T, class Alloc, class LevelGen, bool Ranked >
+const T* PSLIterator<T,Alloc,LevelGen,Ranked>::operator->(void) const {
+  return &getDatum();
+}
+
+template < class T, class Alloc, class LevelGen, bool Ranked >
+bool PSLIterator<T,Alloc,LevelGen,Ranked>::operator==(
+  const PSLIterator<T,Alloc,LevelGen,Ranked>& other) const {
   return _node == other._node;
 }
 
-template < class T >
-bool PSLIterator<T>::operator!=(const PSLIterator<T>& other) {
+template < class T, class Alloc, class LevelGen, bool Ranked >
+bool PSLIterator<T,Alloc,LevelGen,Ranked>::operator!=(
+  const PSLIterator<T,Alloc,LevelGen,Ranked>& other) const {
   return !(operator==(other));
 }
 
-template < class T >
-bool PSLIterator<T>::operator<(const PSLIterator<T>& other) {
+template < class T, class Alloc, class LevelGen, bool Ranked >
+bool PSLIterator<T,Alloc,LevelGen,Ranked>::operator<(
+  const PSLIterator<T,Alloc,LevelGen,Ranked>& other) const {
   return *_node < *(other._node);
 }
 
-template < class T >
-bool PSLIterator<T>::operator>(const PSLIterator<T>& other) {
+template < class T, class Alloc, class LevelGen, bool Ranked >
+bool PSLIterator<T,Alloc,LevelGen,Ranked>::operator>(
+  const PSLIterator<T,Alloc,LevelGen,Ranked>& other) const {
   return *_node > *(other._node);
 }
 
-template < class T >
-bool PSLIterator<T>::operator<=(const PSLIterator<T>& other) {
+template < class T, class Alloc, class LevelGen, bool Ranked >
+bool PSLIterator<T,Alloc,LevelGen,Ranked>::operator<=(
+  const PSLIterator<T,Alloc,LevelGen,Ranked>& other) const {
   return !(*_node > *(other._node));
 }
 
-template < class T >
-bool PSLIterator<T>::operator>=(const PSLIterator<T>& other) {
+template < class T, class Alloc, class LevelGen, bool Ranked >
+bool PSLIterator<T,Alloc,LevelGen,Ranked>::operator>=(
+  const PSLIterator<T,Alloc,LevelGen,Ranked>& other) const {
   return !(*_node < *(other._node));
 }
 
 // datum
 
-template < class T >
-bool PSLIterator<T>::operator==(const T& datum) {
+template < class T, class Alloc, class LevelGen, bool Ranked >
+bool PSLIterator<T,Alloc,LevelGen,Ranked>::operator==(const T& datum) const {
   return operator<=(datum) && operator>=(datum);
 }
 
-template < class T >
-bool PSLIterator<T>::operator!=(const T& datum) {
+template < class T, class Alloc, class LevelGen, bool Ranked >
+bool PSLIterator<T,Alloc,LevelGen,Ranked>::operator!=(const T& datum) const {
   return !operator==(datum);
 }
 
-template < class T >
-bool PSLIterator<T>::operator<(const T& datum) {
+template < class T, class Alloc, class LevelGen, bool Ranked >
+bool PSLIterator<T,Alloc,LevelGen,Ranked>::operator<(const T& datum) const {
   return *_node < datum;
 }
 
-template < class T >
-bool PSLIterator<T>::operator>(const T& datum) {
+template < class T, class Alloc, class LevelGen, bool Ranked >
+bool PSLIterator<T,Alloc,LevelGen,Ranked>::operator>(const T& datum) const {
   return *_node > datum;
 }
 
-template < class T >
-bool PSLIterator<T>::operator<=(const T& datum) {
+template < class T, class Alloc, class LevelGen, bool Ranked >
+bool PSLIterator<T,Alloc,LevelGen,Ranked>::operator<=(const T& datum) const {
   return !(*_node > datum);
 }
 
-template < class T >
-bool PSLIterator<T>::operator>=(const T& datum) {
+template < class T, class Alloc, class LevelGen, bool Ranked >
+bool PSLIterator<T,Alloc,LevelGen,Ranked>::operator>=(const T& datum) const {
   return !(*_node < datum);
 }
 
-template < class T >
-const PSLIterator<T>& PSLIterator<T>::operator=(PSLIterator<T>& other) {
+template < class T, class Alloc, class LevelGen, bool Ranked >
+const PSLIterator<T,Alloc,LevelGen,Ranked>&
+PSLIterator<T,Alloc,LevelGen,Ranked>::operator=(
+  PSLIterator<T,Alloc,LevelGen,Ranked>& other) {
   this->_node = other._node;
   this->_time = other._time;
   this->_height = other._height;
@@ -158,8 +171,10 @@ const PSLIterator<T>& PSLIterator<T>::operator=(PSLIterator<T>& other) {
   return *this;
 }
 
-template < class T >
-const PSLIterator<T>& PSLIterator<T>::operator=(const PSLIterator<T>& other) {
+template < class T, class Alloc, class LevelGen, bool Ranked >
+const PSLIterator<T,Alloc,LevelGen,Ranked>&
+PSLIterator<T,Alloc,LevelGen,Ranked>::operator=(
+  const PSLIterator<T,Alloc,LevelGen,Ranked>& other) {
   this->_node = other._node;
   this->_time = other._time;
   this->_height = other._height;
@@ -167,12 +182,19 @@ const PSLIterator<T>& PSLIterator<T>::operator=(const PSLIterator<T>& other) {
   return *this;
 }
 
-template < class T >
-void PSLIterator<T>::remove(void) {
-  SmartPointer<ListNode<T> > node = this->_node;
+template < class T, class Alloc, class LevelGen, bool Ranked >
+const PSLIterator<T,Alloc,LevelGen,Ranked>&
+PSLIterator<T,Alloc,LevelGen,Ranked>::operator=(
+  PSLIterator<T,Alloc,LevelGen,Ranked>&& other) {
+  return operator=((const PSLIterator<T,Alloc,LevelGen,Ranked>&)other);
+}
+
+template < class T, class Alloc, class LevelGen, bool Ranked >
+void PSLIterator<T,Alloc,LevelGen,Ranked>::remove(void) {
+  assert(_time == _psl.getPresent());
+  ListNode<T,Alloc,Ranked>* node = this->_node;
   next();
-  _psl.data_set.erase(node->getData());
-  node->remove(_time);
+  _psl.removeNode(node);
 }
 
 #endif
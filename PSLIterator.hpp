@@ -24,54 +24,66 @@
 #include <cassert>
 
 #include "ListNode.hpp"
+#include "LevelGenerator.hpp"
 
 namespace persistent_skip_list {
-  template < class T >
+  template < class T, class Alloc, class LevelGen, bool Ranked >
   class PersistentSkipList;
   
-  template < class T >
+  template < class T, class Alloc = HeapAllocator,
+	     class LevelGen = GeometricLevels, bool Ranked = false >
   class PSLIterator {
+    // for searching from a hint
+    friend class PersistentSkipList<T,Alloc,LevelGen,Ranked>;
   public:
-    PSLIterator(SmartPointer<ListNode<T> >& node,
-		PersistentSkipList<T>& psl,
+    PSLIterator(ListNode<T,Alloc,Ranked>* node,
+		PersistentSkipList<T,Alloc,LevelGen,Ranked>& psl,
 		int time=0,
 		int height=0);
     ~PSLIterator(void);
+    // an iterator is a position, so copying and moving are the same
+    PSLIterator(const PSLIterator<T,Alloc,LevelGen,Ranked>& other) = default;
+    PSLIterator(PSLIterator<T,Alloc,LevelGen,Ranked>&& other) = default;
 
-    PSLIterator<T> getNext(void);
-    int getHeight(void);
-    int getSearchHeight(void);
+    PSLIterator<T,Alloc,LevelGen,Ranked> getNext(void);
+    int getHeight(void) const;
+    int getSearchHeight(void) const;
     
     void next(void);
     void down(void);
-    PSLIterator<T>& operator++(void);
+    PSLIterator<T,Alloc,LevelGen,Ranked>& operator++(void);
     
-    T getDatum(void);
-    T operator*(void);
+    const T& getDatum(void) const;
+    const T& operator*(void) const;
+    const T* operator->(void) const;
 
-    bool operator==(const PSLIterator<T>& other);
-    bool operator!=(const PSLIterator<T>& other);
+    bool operator==(const PSLIterator<T,Alloc,LevelGen,Ranked>& other) const;
+    bool operator!=(const PSLIterator<T,Alloc,LevelGen,Ranked>& other) const;
 
-    bool operator<(const PSLIterator<T>& other);
-    bool operator<=(const PSLIterator<T>& other);
-    bool operator>(const PSLIterator<T>& other);
-    bool operator>=(const PSLIterator<T>& other);
+    bool operator<(const PSLIterator<T,Alloc,LevelGen,Ranked>& other) const;
+    bool operator<=(const PSLIterator<T,Alloc,LevelGen,Ranked>& other) const;
+    bool operator>(const PSLIterator<T,Alloc,LevelGen,Ranked>& other) const;
+    bool operator>=(const PSLIterator<T,Alloc,LevelGen,Ranked>& other) const;
 
-    bool operator==(const T& datum);
-    bool operator!=(const T& datum);
+    bool operator==(const T& datum) const;
+    bool operator!=(const T& datum) const;
 
-    bool operator<(const T& datum);
-    bool operator<=(const T& datum);
-    bool operator>(const T& datum);
-    bool operator>=(const T& datum);
+    bool operator<(const T& datum) const;
+    bool operator<=(const T& datum) const;
+    bool operator>(const T& datum) const;
+    bool operator>=(const T& datum) const;
 
-    const PSLIterator<T>& operator=(PSLIterator<T>& other);
-    const PSLIterator<T>& operator=(const PSLIterator<T>& other);
+    const PSLIterator<T,Alloc,LevelGen,Ranked>& operator=(
+      PSLIterator<T,Alloc,LevelGen,Ranked>& other);
+    const PSLIterator<T,Alloc,LevelGen,Ranked>& operator=(
+      const PSLIterator<T,Alloc,LevelGen,Ranked>& other);
+    const PSLIterator<T,Alloc,LevelGen,Ranked>& operator=(
+      PSLIterator<T,Alloc,LevelGen,Ranked>&& other);
 
     void remove(void);
   private:
-    PersistentSkipList<T>& _psl;
-    SmartPointer<ListNode<T> > _node;
+    PersistentSkipList<T,Alloc,LevelGen,Ranked>& _psl;
+    ListNode<T,Alloc,Ranked>* _node;
     int _time;
     int _height;
   };
@@ -0,0 +1,182 @@
+///////////////////////////////////////////////////////////////////////////////
+//                       Copyright (c) 2011 - 2012 by                        //
+//                                Simon Pratt                                //
+//                           (All rights reserved)                           //
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// FILE:    PSLJournal.cpp                                                   //
+//                                                                           //
+// MODULE:  Persistent Skip List                                             //
+//                                                                           //
+// NOTES:   None.                                                            //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+#ifndef PSLJOURNAL_CPP
+#define PSLJOURNAL_CPP
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "PSLJournal.hpp"
+
+using namespace persistent_skip_list;
+
+///////////////////////////////////////////////////////////////////////////////
+// JournalReader Implementation                                              //
+///////////////////////////////////////////////////////////////////////////////
+
+template < class T >
+JournalReader<T>::JournalReader(const char* path)
+  : in(path,std::ios::in | std::ios::binary), length(0)
+{
+  JournalHeader header;
+  // a crash while creating the journal may leave a partial header
+  if(! in.read((char*)&header,sizeof(header)))
+    return;
+  if(memcmp(header.magic,PSLJournal<T>::magic(),sizeof(header.magic)) != 0 ||
+     header.format != PSLJournal<T>::FORMAT || header.data_size != sizeof(T))
+    throw "Journal was not written for this type";
+  length = sizeof(header);
+}
+
+template < class T >
+bool JournalReader<T>::next(char& op, T& datum) {
+  if(length == 0 || ! in.get(op))
+    return false;
+  switch(op) {
+  case PSLJournal<T>::INSERT:
+  case PSLJournal<T>::REMOVE:
+    if(! in.read((char*)&datum,sizeof(T)))
+      return false;
+    length += 1 + sizeof(T);
+    return true;
+  case PSLJournal<T>::CLEAR:
+  case PSLJournal<T>::INC_TIME:
+    length += 1;
+    return true;
+  }
+  // not a record, so the rest of the file can't be trusted
+  return false;
+}
+
+template < class T >
+size_t JournalReader<T>::getLength(void) const {
+  return length;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// PSLJournal Implementation                                                 //
+///////////////////////////////////////////////////////////////////////////////
+
+template < class T >
+PSLJournal<T>::PSLJournal(const char* path, int g)
+  : fd(-1), group(g), unsynced(0), buffer()
+{
+  assert(g >= 0);
+  // find the end of the last complete record
+  size_t length = 0;
+  {
+    JournalReader<T> reader(path);
+    char op;
+    T datum;
+    while(reader.next(op,datum))
+      ;
+    length = reader.getLength();
+  }
+  fd = open(path,O_WRONLY | O_CREAT,0644);
+  if(fd < 0)
+    throw "Unable to open journal";
+  if(ftruncate(fd,length) != 0 || lseek(fd,length,SEEK_SET) < 0) {
+    close(fd);
+    throw "Unable to open journal";
+  }
+  if(length == 0) {
+    JournalHeader header;
+    memset(&header,0,sizeof(header));
+    strncpy(header.magic,magic(),sizeof(header.magic));
+    header.format = FORMAT;
+    header.data_size = sizeof(T);
+    buffer.insert(buffer.end(),(const char*)&header,
+		  (const char*)&header + sizeof(header));
+    if(! flush() || fsync(fd) != 0) {
+      close(fd);
+      throw "Unable to write journal";
+    }
+  }
+}
+
+template < class T >
+PSLJournal<T>::~PSLJournal(void) {
+  if(flush())
+    fsync(fd);
+  close(fd);
+}
+
+template < class T >
+const char* PSLJournal<T>::magic(void) {
+  return "PSLJRNL";
+}
+
+template < class T >
+void PSLJournal<T>::logInsert(const T& datum) {
+  append(INSERT,&datum);
+}
+
+template < class T >
+void PSLJournal<T>::logRemove(const T& datum) {
+  append(REMOVE,&datum);
+}
+
+template < class T >
+void PSLJournal<T>::logClear(void) {
+  append(CLEAR,NULL);
+}
+
+template < class T >
+void PSLJournal<T>::logIncTime(void) {
+  append(INC_TIME,NULL);
+  if(group == SYNC_PER_VERSION)
+    sync();
+}
+
+template < class T >
+void PSLJournal<T>::sync(void) {
+  if(! flush() || fsync(fd) != 0)
+    throw "Unable to write journal";
+  unsynced = 0;
+}
+
+template < class T >
+void PSLJournal<T>::append(char op, const T* datum) {
+  buffer.push_back(op);
+  if(datum != NULL)
+    buffer.insert(buffer.end(),(const char*)datum,
+		  (const char*)datum + sizeof(T));
+  ++unsynced;
+  if(group != SYNC_PER_VERSION && unsynced >= group)
+    sync();
+  else if(buffer.size() >= BUFFER_SIZE && ! flush())
+    throw "Unable to write journal";
+}
+
+template < class T >
+bool PSLJournal<T>::flush(void) {
+  size_t written = 0;
+  while(written < buffer.size()) {
+    ssize_t count = write(fd,&buffer[written],buffer.size() - written);
+    if(count < 0 && errno == EINTR)
+      continue;
+    if(count < 0) {
+      // drop what was written, so it isn't written twice
+      buffer.erase(buffer.begin(),buffer.begin() + written);
+      return false;
+    }
+    written += count;
+  }
+  buffer.clear();
+  return true;
+}
+
+#endif
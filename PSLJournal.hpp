@@ -0,0 +1,254 @@
+//-*- mode: c++ -*-////////////////////////////////////////////////////////////
+//                       Copyright (c) 2011 - 2012 by                        //
+//                                Simon Pratt                                //
+//                           (All rights reserved)                           //
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// FILE:    PSLJournal.hpp                                                   //
+//                                                                           //
+// MODULE:  Persistent Skip List                                             //
+//                                                                           //
+// PURPOSE: Appends the changes made to a skip list to a journal file, so    //
+//          that PersistentSkipList::replayJournal can rebuild its versions  //
+//          after a crash.                                                   //
+//                                                                           //
+// NOTES:   Records are buffered, and synced to disk in groups, either       //
+//          every so many records or at the end of every version, so a       //
+//          crash loses at most the unsynced group.  A crash in the middle   //
+//          of a write leaves a partial record at the end of the file,       //
+//          which is ignored by the reader and cut off by the writer.        //
+//          Data is written and read as raw bytes, so T must be trivially    //
+//          copyable, and the file can only be read on a machine with the    //
+//          same byte order and type sizes.                                  //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// Public Variable:                     Description:                         //
+// ----------------                     ------------                         //
+// JournalHeader                        The start of the file.               //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+//                             Public Methods:                               //
+//                                                                           //
+// PSLJournal(const char*,int) - opens a journal for appending               //
+// logInsert(const T&)         - records an insert                           //
+// logRemove(const T&)         - records a remove                            //
+// logClear()                  - records the present being emptied           //
+// logIncTime()                - records the end of a version                //
+// sync()                      - writes and syncs every buffered record      //
+//                                                                           //
+// JournalReader(const char*)  - opens a journal for reading                 //
+// next(char&,T&)              - reads the next complete record              //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+#ifndef PSLJOURNAL_HPP
+#define PSLJOURNAL_HPP
+
+#include <cassert>
+#include <cstddef>
+#include <fstream>
+#include <type_traits>
+#include <vector>
+#include <stdint.h>
+
+namespace persistent_skip_list {
+
+  /////////////////////////////////////////////////////////////////////////////
+  // Journal file format                                                     //
+  /////////////////////////////////////////////////////////////////////////////
+
+  // The header is followed by records of one operation byte, then for
+  // inserts and removes the bytes of the datum, with no padding.
+  struct JournalHeader {
+    char magic[8];
+    uint32_t format;
+    uint32_t data_size;
+  };
+
+  /////////////////////////////////////////////////////////////////////////////
+  // JournalReader interface                                                 //
+  /////////////////////////////////////////////////////////////////////////////
+  template < class T >
+  class JournalReader {
+  public:
+    ///////////////////////////////////////////////////////////////////////////
+    //                                                                       //
+    // FUNCTION NAME: JournalReader                                          //
+    //                                                                       //
+    // PURPOSE:       Constructor.                                           //
+    //                                                                       //
+    // SECURITY:      public                                                 //
+    //                                                                       //
+    // PARAMETERS                                                            //
+    //   Type/Name:   const char*/path                                       //
+    //   Description: The journal to read.                                   //
+    //                                                                       //
+    // NOTES:         A missing file, or one too short to have a header,     //
+    //                reads as an empty journal.  Throws if the header       //
+    //                wasn't written for this T.                             //
+    //                                                                       //
+    ///////////////////////////////////////////////////////////////////////////
+    JournalReader(const char* path);
+
+    ///////////////////////////////////////////////////////////////////////////
+    //                                                                       //
+    // FUNCTION NAME: next                                                   //
+    //                                                                       //
+    // PURPOSE:       Reads the next record.                                 //
+    //                                                                       //
+    // SECURITY:      public                                                 //
+    //                                                                       //
+    // PARAMETERS                                                            //
+    //   Type/Name:   char&/op                                               //
+    //   Description: Set to the operation of the record.                    //
+    //                                                                       //
+    //   Type/Name:   T&/datum                                               //
+    //   Description: Set to the datum of an insert or remove.               //
+    //                                                                       //
+    // RETURN:                                                               //
+    //   Type/Name:   bool                                                   //
+    //   Description: False at the end of the journal.                       //
+    //                                                                       //
+    // NOTES:         A partial or unknown record ends the journal.          //
+    //                                                                       //
+    ///////////////////////////////////////////////////////////////////////////
+    bool next(char& op, T& datum);
+
+    // the length of the header and the records read so far, or 0 if
+    // there is no header
+    size_t getLength(void) const;
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Kindly ignore my private parts                                        //
+    ///////////////////////////////////////////////////////////////////////////
+  private:
+    // each datum is read into a T as raw bytes
+    static_assert(std::is_trivially_copyable<T>::value,
+		  "A journal needs trivially copyable data");
+
+    std::ifstream in;
+    size_t length;
+  };
+
+  /////////////////////////////////////////////////////////////////////////////
+  // PSLJournal interface                                                    //
+  /////////////////////////////////////////////////////////////////////////////
+  template < class T >
+  class PSLJournal {
+  public:
+    ///////////////////////////////////////////////////////////////////////////
+    //                                                                       //
+    // FUNCTION NAME: PSLJournal                                             //
+    //                                                                       //
+    // PURPOSE:       Constructor.                                           //
+    //                                                                       //
+    // SECURITY:      public                                                 //
+    //                                                                       //
+    // PARAMETERS                                                            //
+    //   Type/Name:   const char*/path                                       //
+    //   Description: The journal to append to, created if missing.          //
+    //                                                                       //
+    //   Type/Name:   int/group                                              //
+    //   Description: The number of records to sync at once, or              //
+    //                SYNC_PER_VERSION to sync at the end of each version.   //
+    //                                                                       //
+    // NOTES:         Reads an existing journal through, to cut off any      //
+    //                partial record left by a crash.  Throws if the file    //
+    //                can't be opened, or wasn't written for this T.         //
+    //                                                                       //
+    ///////////////////////////////////////////////////////////////////////////
+    PSLJournal(const char* path, int group = SYNC_PER_VERSION);
+
+    ///////////////////////////////////////////////////////////////////////////
+    //                                                                       //
+    // FUNCTION NAME: ~PSLJournal                                            //
+    //                                                                       //
+    // PURPOSE:       Destructor.                                            //
+    //                                                                       //
+    // SECURITY:      public                                                 //
+    //                                                                       //
+    // PARAMETERS                                                            //
+    //   Type/Name:   Void.                                                  //
+    //   Description: None.                                                  //
+    //                                                                       //
+    // RETURN:        Void.                                                  //
+    //                                                                       //
+    // NOTES:         Syncs the buffered records, ignoring any error.  Call  //
+    //                sync first to find out whether they were written.      //
+    //                                                                       //
+    ///////////////////////////////////////////////////////////////////////////
+    ~PSLJournal(void);
+
+    void logInsert(const T& datum);
+    void logRemove(const T& datum);
+    void logClear(void);
+    void logIncTime(void);
+
+    ///////////////////////////////////////////////////////////////////////////
+    //                                                                       //
+    // FUNCTION NAME: sync                                                   //
+    //                                                                       //
+    // PURPOSE:       Writes every buffered record, and waits until they     //
+    //                are on disk.                                           //
+    //                                                                       //
+    // SECURITY:      public                                                 //
+    //                                                                       //
+    // PARAMETERS                                                            //
+    //   Type/Name:   Void.                                                  //
+    //   Description: None.                                                  //
+    //                                                                       //
+    // RETURN:        Void.                                                  //
+    //                                                                       //
+    // NOTES:         Called by the log methods at the end of each group.    //
+    //                Throws if the records can't be written.                //
+    //                                                                       //
+    ///////////////////////////////////////////////////////////////////////////
+    void sync(void);
+
+    // identifies journal files, and their format
+    static const char* magic(void);
+    static const uint32_t FORMAT = 1;
+
+    // the operation of each record
+    static const char INSERT = 'i';
+    static const char REMOVE = 'r';
+    static const char CLEAR = 'c';
+    static const char INC_TIME = 't';
+
+    // group size which syncs at the end of each version
+    static const int SYNC_PER_VERSION = 0;
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Kindly ignore my private parts                                        //
+    ///////////////////////////////////////////////////////////////////////////
+  private:
+    // each datum is written from a T as raw bytes
+    static_assert(std::is_trivially_copyable<T>::value,
+		  "A journal needs trivially copyable data");
+
+    int fd;
+    const int group;
+    // the number of records not yet synced
+    int unsynced;
+    // the records not yet written
+    std::vector< char > buffer;
+
+    // buffered records are written, without syncing, past this size
+    static const size_t BUFFER_SIZE = 1 << 16;
+
+    // buffers a record, syncing at the end of a group
+    void append(char op, const T* datum);
+
+    // writes the buffered records, returning false on error
+    bool flush(void);
+
+    // the file is owned, so can't be copied
+    PSLJournal(const PSLJournal<T>&);
+    PSLJournal<T>& operator=(const PSLJournal<T>&);
+  };
+}
+
+#include "PSLJournal.cpp"
+
+#endif
@@ -0,0 +1,305 @@
+///////////////////////////////////////////////////////////////////////////////
+//                       Copyright (c) 2011 - 2012 by                        //
+//                                Simon Pratt                                //
+//                           (All rights reserved)                           //
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// FILE:    PSLSnapshot.cpp                                                  //
+//                                                                           //
+// MODULE:  Persistent Skip List                                             //
+//                                                                           //
+// NOTES:   None.                                                            //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+#ifndef PSLSNAPSHOT_CPP
+#define PSLSNAPSHOT_CPP
+
+#include <cstring>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "PSLSnapshot.hpp"
+
+using namespace persistent_skip_list;
+
+///////////////////////////////////////////////////////////////////////////////
+// SnapshotIterator Implementation                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+template < class T >
+SnapshotIterator<T>::SnapshotIterator(const PSLSnapshot<T>& snapshot,
+				      uint64_t node, int time)
+  : _snapshot(&snapshot), _node(node), _time(time)
+{
+  assert(time >= 0);
+}
+
+template < class T >
+const T& SnapshotIterator<T>::operator*(void) const {
+  return _snapshot->getData(_node);
+}
+
+template < class T >
+SnapshotIterator<T>& SnapshotIterator<T>::operator++(void) {
+  // the tail has no next pointers, and stays where it is
+  if(_snapshot->getNode(_node).flags & PSLSnapshot<T>::POSITIVE_INFINITY)
+    return *this;
+  _node = _snapshot->getLink(_snapshot->getSearchNext(_node,_time),0);
+  return *this;
+}
+
+template < class T >
+bool SnapshotIterator<T>::operator==(const SnapshotIterator<T>& other) const {
+  return _node == other._node;
+}
+
+template < class T >
+bool SnapshotIterator<T>::operator!=(const SnapshotIterator<T>& other) const {
+  return _node != other._node;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// PSLSnapshot Implementation                                                //
+///////////////////////////////////////////////////////////////////////////////
+
+template < class T >
+PSLSnapshot<T>::PSLSnapshot(const char* path)
+  : fd(-1), base(NULL), length(0), header(NULL)
+{
+  fd = open(path,O_RDONLY);
+  if(fd < 0)
+    throw "Unable to open snapshot";
+  struct stat status;
+  if(fstat(fd,&status) != 0 ||
+     (size_t)status.st_size < sizeof(SnapshotHeader)) {
+    close(fd);
+    throw "Snapshot is too short";
+  }
+  length = (size_t)status.st_size;
+  void* mapped = mmap(NULL,length,PROT_READ,MAP_SHARED,fd,0);
+  if(mapped == MAP_FAILED) {
+    close(fd);
+    throw "Unable to map snapshot";
+  }
+  base = (const char*)mapped;
+  header = (const SnapshotHeader*)base;
+  if(memcmp(header->magic,magic(),sizeof(header->magic)) != 0 ||
+     header->format != FORMAT || header->data_size != sizeof(T)) {
+    munmap((void*)base,length);
+    close(fd);
+    throw "Snapshot was not written for this type";
+  }
+  if(! hasRoots()) {
+    munmap((void*)base,length);
+    close(fd);
+    throw "Snapshot is corrupt";
+  }
+}
+
+template < class T >
+PSLSnapshot<T>::~PSLSnapshot(void) {
+  munmap((void*)base,length);
+  close(fd);
+}
+
+template < class T >
+const char* PSLSnapshot<T>::magic(void) {
+  return "PSLSNAP";
+}
+
+template < class T >
+size_t PSLSnapshot<T>::pad(size_t bytes) {
+  return (bytes + 7) & ~(size_t)7;
+}
+
+template < class T >
+bool PSLSnapshot<T>::hasRoots(void) const {
+  // the roots follow the header
+  if(header->root_count <= 0 || header->roots % 8 != 0 ||
+     header->roots < sizeof(SnapshotHeader) || header->roots > length ||
+     (length - header->roots) / sizeof(SnapshotRoot) <
+     (size_t)header->root_count)
+    return false;
+  // every head and tail starts a node record within the file, and the
+  // roots are sorted by time
+  const SnapshotRoot* roots = (const SnapshotRoot*)(base + header->roots);
+  for(int i = 0; i < header->root_count; ++i) {
+    if((i > 0 && roots[i].time <= roots[i-1].time) ||
+       roots[i].head % 8 != 0 || roots[i].tail % 8 != 0 ||
+       roots[i].head > length - sizeof(SnapshotNode) ||
+       roots[i].tail > length - sizeof(SnapshotNode))
+      return false;
+  }
+  return true;
+}
+
+template < class T >
+void PSLSnapshot<T>::verify(void) const {
+  // the nodes follow the roots, and must fit before the end of the
+  // file, which keeps each one at a multiple of 8, since the sizes are
+  // padded
+  uint64_t node = header->roots + header->root_count * sizeof(SnapshotRoot);
+  std::vector< uint64_t > starts;
+  starts.reserve(std::min(header->node_count,
+			  (uint64_t)(length / sizeof(SnapshotNode))));
+  for(uint64_t i = 0; i < header->node_count; ++i) {
+    if(length - node < sizeof(SnapshotNode))
+      throw "Snapshot is corrupt";
+    const SnapshotNode& record = getNode(node);
+    if(record.height <= 0 || record.next_count < 0 ||
+       length - node < nodeSize(record.height,0) ||
+       (length - node - nodeSize(record.height,0)) /
+       nextSize(record.height) < (size_t)record.next_count)
+      throw "Snapshot is corrupt";
+    // getNext searches the changes by time
+    const char* log = base + node + nodeSize(record.height,0);
+    for(int j = 1; j < record.next_count; ++j) {
+      const SnapshotNext* before =
+	(const SnapshotNext*)(log + (j-1) * nextSize(record.height));
+      const SnapshotNext* after =
+	(const SnapshotNext*)(log + j * nextSize(record.height));
+      if(after->time <= before->time)
+	throw "Snapshot is corrupt";
+    }
+    starts.push_back(node);
+    node += nodeSize(record.height,record.next_count);
+  }
+  if(node != length)
+    throw "Snapshot is corrupt";
+  // the starts are sorted, so each link is checked by binary search
+  for(size_t i = 0; i < starts.size(); ++i) {
+    const SnapshotNode& record = getNode(starts[i]);
+    const char* log = base + starts[i] + nodeSize(record.height,0);
+    for(int j = 0; j < record.next_count; ++j) {
+      const SnapshotNext* next =
+	(const SnapshotNext*)(log + j * nextSize(record.height));
+      for(int level = 0; level < record.height; ++level) {
+	uint64_t link = getLink(next,level);
+	if(! std::binary_search(starts.begin(),starts.end(),link) ||
+	   getNode(link).height <= level)
+	  throw "Snapshot is corrupt";
+      }
+    }
+  }
+  const SnapshotRoot* roots = (const SnapshotRoot*)(base + header->roots);
+  for(int i = 0; i < header->root_count; ++i) {
+    if(! std::binary_search(starts.begin(),starts.end(),roots[i].head) ||
+       ! std::binary_search(starts.begin(),starts.end(),roots[i].tail) ||
+       ! (getNode(roots[i].head).flags & NEGATIVE_INFINITY) ||
+       ! (getNode(roots[i].tail).flags & POSITIVE_INFINITY))
+      throw "Snapshot is corrupt";
+  }
+}
+
+template < class T >
+size_t PSLSnapshot<T>::nextSize(int height) {
+  return sizeof(SnapshotNext) + height * sizeof(uint64_t) +
+    pad(height * sizeof(int32_t));
+}
+
+template < class T >
+size_t PSLSnapshot<T>::nodeSize(int height, int next_count) {
+  return sizeof(SnapshotNode) + pad(sizeof(T)) +
+    next_count * nextSize(height);
+}
+
+template < class T >
+int PSLSnapshot<T>::getPresent(void) const {
+  return header->present;
+}
+
+template < class T >
+const SnapshotRoot& PSLSnapshot<T>::getRoot(int t) const {
+  assert(t >= 0);
+  const SnapshotRoot* roots = (const SnapshotRoot*)(base + header->roots);
+  // binary search for the last root at or before time t
+  int begin = 0, end = header->root_count -1;
+  while(begin < end) {
+    int index = (begin+end+1)/2;
+    if(roots[index].time > t)
+      end = index -1;
+    else
+      begin = index;
+  }
+  return roots[begin];
+}
+
+template < class T >
+const SnapshotNode& PSLSnapshot<T>::getNode(uint64_t node) const {
+  assert(node + sizeof(SnapshotNode) <= length);
+  return *(const SnapshotNode*)(base + node);
+}
+
+template < class T >
+const T& PSLSnapshot<T>::getData(uint64_t node) const {
+  return *(const T*)(base + node + sizeof(SnapshotNode));
+}
+
+template < class T >
+const SnapshotNext* PSLSnapshot<T>::getNext(uint64_t node, int t) const {
+  const SnapshotNode& record = getNode(node);
+  const char* log = base + node + sizeof(SnapshotNode) + pad(sizeof(T));
+  size_t size = nextSize(record.height);
+  // reverse linear search from the latest change, as in ListNode
+  for(int index = record.next_count-1; index >= 0; --index) {
+    const SnapshotNext* next = (const SnapshotNext*)(log + index * size);
+    if(next->time <= t)
+      return next;
+  }
+  return NULL;
+}
+
+template < class T >
+const SnapshotNext* PSLSnapshot<T>::getSearchNext(uint64_t node,
+						  int t) const {
+  const SnapshotNext* next = getNext(node,t);
+  // only a corrupt file, or a time dropped from the list before it was
+  // written, leaves a node on a search without next pointers
+  if(next == NULL)
+    throw "Snapshot has no next pointers at that time";
+  return next;
+}
+
+template < class T >
+uint64_t PSLSnapshot<T>::getLink(const SnapshotNext* next, int level) const {
+  return ((const uint64_t*)(next + 1))[level];
+}
+
+template < class T >
+bool PSLSnapshot<T>::isAfter(uint64_t node, const T& datum) const {
+  const SnapshotNode& record = getNode(node);
+  if(record.flags & POSITIVE_INFINITY)
+    return true;
+  if(record.flags & NEGATIVE_INFINITY)
+    return false;
+  return getData(node) > datum;
+}
+
+template < class T >
+SnapshotIterator<T> PSLSnapshot<T>::begin(int t) const {
+  SnapshotIterator<T> head(*this,getRoot(t).head,t);
+  return ++head;
+}
+
+template < class T >
+SnapshotIterator<T> PSLSnapshot<T>::end(int t) const {
+  return SnapshotIterator<T>(*this,getRoot(t).tail,t);
+}
+
+template < class T >
+SnapshotIterator<T> PSLSnapshot<T>::find(const T& toFind, int t) const {
+  uint64_t node = getRoot(t).head;
+  const SnapshotNext* next = getSearchNext(node,t);
+  for(int level = getNode(node).height-1; level >= 0; --level) {
+    while(! isAfter(getLink(next,level),toFind)) {
+      node = getLink(next,level);
+      next = getSearchNext(node,t);
+    }
+  }
+  return SnapshotIterator<T>(*this,node,t);
+}
+
+#endif
@@ -0,0 +1,307 @@
+//-*- mode: c++ -*-////////////////////////////////////////////////////////////
+//                       Copyright (c) 2011 - 2012 by                        //
+//                                Simon Pratt                                //
+//                           (All rights reserved)                           //
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// FILE:    PSLSnapshot.hpp                                                  //
+//                                                                           //
+// MODULE:  Persistent Skip List                                             //
+//                                                                           //
+// PURPOSE: Defines the file format written by                               //
+//          PersistentSkipList::writeSnapshot, and reads every version of    //
+//          such a file in place from a read only memory map.                //
+//                                                                           //
+// NOTES:   Links are offsets from the start of the file rather than         //
+//          pointers, so a snapshot is searched where it is mapped, without  //
+//          reading it in first.  Data is written and read as raw bytes, so  //
+//          T must be trivially copyable, and the file can only be read on   //
+//          a machine with the same byte order and type sizes.               //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// Public Variable:                     Description:                         //
+// ----------------                     ------------                         //
+// SnapshotHeader                       The start of the file.               //
+// SnapshotRoot                         The head and tail from a time        //
+//                                      onwards.                             //
+// SnapshotNode                         The start of a node, followed by its //
+//                                      data and change log.                 //
+// SnapshotNext                         The start of an array of next        //
+//                                      pointers, followed by the links and  //
+//                                      their widths.                        //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+//                             Public Methods:                               //
+//                                                                           //
+// PSLSnapshot(const char*)  - maps a snapshot file                          //
+// getPresent()              - the latest time in the snapshot               //
+// begin(int)                - iterator to the first element at a time       //
+// end(int)                  - iterator past the last element at a time      //
+// find(const T&,int)        - iterator to the last element at or before a   //
+//                             datum at a time                               //
+// verify()                  - checks every node and link in the snapshot    //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+#ifndef PSLSNAPSHOT_HPP
+#define PSLSNAPSHOT_HPP
+
+#include <cassert>
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+#include <stdint.h>
+
+namespace persistent_skip_list {
+
+  /////////////////////////////////////////////////////////////////////////////
+  // Snapshot file format                                                    //
+  /////////////////////////////////////////////////////////////////////////////
+
+  // Every record starts at an offset which is a multiple of 8.  The
+  // header is followed by root_count roots, then node_count nodes.
+  struct SnapshotHeader {
+    char magic[8];
+    uint32_t format;
+    uint32_t data_size;
+    int32_t present;
+    int32_t root_count;
+    uint64_t roots;
+    uint64_t node_count;
+  };
+
+  struct SnapshotRoot {
+    int32_t time;
+    int32_t unused;
+    uint64_t head;
+    uint64_t tail;
+  };
+
+  // followed by the data, padded to a multiple of 8, then next_count
+  // arrays of next pointers sorted by time
+  struct SnapshotNode {
+    int32_t height;
+    int32_t next_count;
+    int32_t flags;
+    int32_t unused;
+  };
+
+  // followed by height offsets of the next nodes, then height widths,
+  // which are 0 unless the list was Ranked, padded to a multiple of 8
+  struct SnapshotNext {
+    int32_t time;
+    int32_t unused;
+  };
+
+  template < class T >
+  class PSLSnapshot;
+
+  /////////////////////////////////////////////////////////////////////////////
+  // SnapshotIterator interface                                              //
+  /////////////////////////////////////////////////////////////////////////////
+  template < class T >
+  class SnapshotIterator {
+  public:
+    SnapshotIterator(const PSLSnapshot<T>& snapshot, uint64_t node, int time);
+
+    ///////////////////////////////////////////////////////////////////////////
+    //                                                                       //
+    // FUNCTION NAME: operator*                                              //
+    //                                                                       //
+    // PURPOSE:       Gets the datum of the element, in the mapped file.     //
+    //                                                                       //
+    // SECURITY:      public                                                 //
+    //                                                                       //
+    // PARAMETERS                                                            //
+    //   Type/Name:   Void.                                                  //
+    //   Description: None.                                                  //
+    //                                                                       //
+    // RETURN:                                                               //
+    //   Type/Name:   const T&                                               //
+    //   Description: The datum, valid until the snapshot is destroyed.      //
+    //                                                                       //
+    // NOTES:         None.                                                  //
+    //                                                                       //
+    ///////////////////////////////////////////////////////////////////////////
+    const T& operator*(void) const;
+
+    SnapshotIterator<T>& operator++(void);
+
+    bool operator==(const SnapshotIterator<T>& other) const;
+    bool operator!=(const SnapshotIterator<T>& other) const;
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Kindly ignore my private parts                                        //
+    ///////////////////////////////////////////////////////////////////////////
+  private:
+    const PSLSnapshot<T>* _snapshot;
+    uint64_t _node;
+    int _time;
+  };
+
+  /////////////////////////////////////////////////////////////////////////////
+  // PSLSnapshot interface                                                   //
+  /////////////////////////////////////////////////////////////////////////////
+  template < class T >
+  class PSLSnapshot {
+    friend class SnapshotIterator<T>;
+  public:
+    ///////////////////////////////////////////////////////////////////////////
+    //                                                                       //
+    // FUNCTION NAME: PSLSnapshot                                            //
+    //                                                                       //
+    // PURPOSE:       Constructor.                                           //
+    //                                                                       //
+    // SECURITY:      public                                                 //
+    //                                                                       //
+    // PARAMETERS                                                            //
+    //   Type/Name:   const char*/path                                       //
+    //   Description: The file written by writeSnapshot.                     //
+    //                                                                       //
+    // NOTES:         Maps the file read only, and reads only the header and //
+    //                the roots, checking their offsets against the size of  //
+    //                the file, so takes time linear in the number of roots. //
+    //                Throws if the file can't be mapped, wasn't written for //
+    //                this T, or its roots are corrupt.  The nodes are       //
+    //                trusted until verify is called.                        //
+    //                                                                       //
+    ///////////////////////////////////////////////////////////////////////////
+    PSLSnapshot(const char* path);
+
+    ///////////////////////////////////////////////////////////////////////////
+    //                                                                       //
+    // FUNCTION NAME: ~PSLSnapshot                                           //
+    //                                                                       //
+    // PURPOSE:       Destructor.                                            //
+    //                                                                       //
+    // SECURITY:      public                                                 //
+    //                                                                       //
+    // PARAMETERS                                                            //
+    //   Type/Name:   Void.                                                  //
+    //   Description: None.                                                  //
+    //                                                                       //
+    // RETURN:        Void.                                                  //
+    //                                                                       //
+    // NOTES:         Unmaps the file, which invalidates every iterator.     //
+    //                                                                       //
+    ///////////////////////////////////////////////////////////////////////////
+    ~PSLSnapshot(void);
+
+    int getPresent(void) const;
+
+    SnapshotIterator<T> begin(int t) const;
+    SnapshotIterator<T> end(int t) const;
+
+    ///////////////////////////////////////////////////////////////////////////
+    //                                                                       //
+    // FUNCTION NAME: find                                                   //
+    //                                                                       //
+    // PURPOSE:       Finds the last element at or before a datum at         //
+    //                time t.                                                //
+    //                                                                       //
+    // SECURITY:      public                                                 //
+    //                                                                       //
+    // PARAMETERS                                                            //
+    //   Type/Name:   const T&/toFind                                        //
+    //   Description: The datum to find.                                     //
+    //                                                                       //
+    //   Type/Name:   int/t                                                  //
+    //   Description: The time at which to find it.                          //
+    //                                                                       //
+    // RETURN:                                                               //
+    //   Type/Name:   SnapshotIterator<T>                                    //
+    //   Description: The same element as PersistentSkipList::find.          //
+    //                                                                       //
+    // NOTES:         Takes logarithmic time, touching only the pages of     //
+    //                the nodes searched.  Throws if a node searched has no  //
+    //                next pointers at time t, as does incrementing an       //
+    //                iterator at such a node.                               //
+    //                                                                       //
+    ///////////////////////////////////////////////////////////////////////////
+    SnapshotIterator<T> find(const T& toFind, int t) const;
+
+    ///////////////////////////////////////////////////////////////////////////
+    //                                                                       //
+    // FUNCTION NAME: verify                                                 //
+    //                                                                       //
+    // PURPOSE:       Checks every node and link in the file, so that no     //
+    //                search of it can read outside the file.                //
+    //                                                                       //
+    // SECURITY:      public                                                 //
+    //                                                                       //
+    // PARAMETERS                                                            //
+    //   Type/Name:   Void.                                                  //
+    //   Description: None.                                                  //
+    //                                                                       //
+    // RETURN:        Void.                                                  //
+    //                                                                       //
+    // NOTES:         Every node must lie within the file with its change    //
+    //                times increasing, and the nodes must end at its end.   //
+    //                Every link and root must be to the start of a node     //
+    //                tall enough for it.  Reads the whole file, taking      //
+    //                O(n log n) time for n links.  Throws if the file is    //
+    //                corrupt.  A node without next pointers at a time it is //
+    //                searched, which a list with dropped versions can have  //
+    //                at those times, is only found by the search, which     //
+    //                throws.                                                //
+    //                                                                       //
+    ///////////////////////////////////////////////////////////////////////////
+    void verify(void) const;
+
+    // identifies snapshot files, and their format
+    static const char* magic(void);
+    static const uint32_t FORMAT = 1;
+
+    // flags of the dummy nodes
+    static const int32_t POSITIVE_INFINITY = 1;
+    static const int32_t NEGATIVE_INFINITY = 2;
+
+    // sizes of the records, which the writer shares
+    static size_t nodeSize(int height, int next_count);
+    static size_t nextSize(int height);
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Kindly ignore my private parts                                        //
+    ///////////////////////////////////////////////////////////////////////////
+  private:
+    // the data is mapped as raw bytes
+    static_assert(std::is_trivially_copyable<T>::value,
+		  "A snapshot needs trivially copyable data");
+
+    int fd;
+    const char* base;
+    size_t length;
+    const SnapshotHeader* header;
+
+    // rounds a size up to a multiple of 8
+    static size_t pad(size_t bytes);
+
+    // true if the roots, and the heads and tails they point to, start
+    // within the file
+    bool hasRoots(void) const;
+
+    // the root in effect at time t
+    const SnapshotRoot& getRoot(int t) const;
+
+    const SnapshotNode& getNode(uint64_t node) const;
+    const T& getData(uint64_t node) const;
+    // the next pointers of a node at time t
+    const SnapshotNext* getNext(uint64_t node, int t) const;
+    // the same, for a node other than the tail, throwing if there are
+    // none
+    const SnapshotNext* getSearchNext(uint64_t node, int t) const;
+    // the next node at a level
+    uint64_t getLink(const SnapshotNext* next, int level) const;
+    // true if the node is after a datum
+    bool isAfter(uint64_t node, const T& datum) const;
+
+    // the mapping is owned, so can't be copied
+    PSLSnapshot(const PSLSnapshot<T>&);
+    PSLSnapshot<T>& operator=(const PSLSnapshot<T>&);
+  };
+}
+
+#include "PSLSnapshot.cpp"
+
+#endif
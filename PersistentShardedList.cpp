@@ -0,0 +1,239 @@
+///////////////////////////////////////////////////////////////////////////////
+//                       Copyright (c) 2011 - 2012 by                        //
+//                                Simon Pratt                                //
+//                           (All rights reserved)                           //
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// FILE:    PersistentShardedList.cpp                                        //
+//                                                                           //
+// MODULE:  Persistent Skip List                                             //
+//                                                                           //
+// NOTES:   None.                                                            //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+#ifndef PERSISTENTSHARDEDLIST_CPP
+#define PERSISTENTSHARDEDLIST_CPP
+
+#include "PersistentShardedList.hpp"
+
+using namespace persistent_skip_list;
+
+///////////////////////////////////////////////////////////////////////////////
+// PersistentShardedList Implementation                                      //
+///////////////////////////////////////////////////////////////////////////////
+
+template < class T, class Alloc, class LevelGen >
+PersistentShardedList<T,Alloc,LevelGen>::PersistentShardedList(
+  const vector< T >& b, int nodeSize, const LevelGen& levels)
+  : bounds(b), shards(), present(0)
+{
+  for(size_t i = 1; i < bounds.size(); ++i)
+    assert(bounds[i-1] < bounds[i]);
+  for(size_t i = 0; i <= bounds.size(); ++i) {
+    Shard* shard = new Shard();
+    shard->list = new PersistentSkipList<T,Alloc,LevelGen>(nodeSize,levels);
+    shard->busy = false;
+    shard->stopping = false;
+    shard->error = NULL;
+    shards.push_back(shard);
+  }
+  // every shard is built before any worker runs
+  for(size_t i = 0; i < shards.size(); ++i)
+    shards[i]->worker = std::thread(&work,shards[i]);
+}
+
+template < class T, class Alloc, class LevelGen >
+PersistentShardedList<T,Alloc,LevelGen>::~PersistentShardedList(void) {
+  for(size_t i = 0; i < shards.size(); ++i) {
+    Shard* shard = shards[i];
+    {
+      std::lock_guard<std::mutex> guard(shard->lock);
+      shard->stopping = true;
+    }
+    shard->queued.notify_one();
+  }
+  for(size_t i = 0; i < shards.size(); ++i) {
+    shards[i]->worker.join();
+    delete shards[i]->list;
+    delete shards[i];
+  }
+}
+
+template < class T, class Alloc, class LevelGen >
+int PersistentShardedList<T,Alloc,LevelGen>::getPresent(void) const {
+  // pairs with incTime, so every shard has the versions before it
+  return atomicLoad(&present);
+}
+
+template < class T, class Alloc, class LevelGen >
+int PersistentShardedList<T,Alloc,LevelGen>::getShardCount(void) const {
+  return (int)shards.size();
+}
+
+template < class T, class Alloc, class LevelGen >
+int PersistentShardedList<T,Alloc,LevelGen>::getShardIndex(
+  const T& data) const {
+  // shard i holds the data from bounds[i-1] to before bounds[i]
+  return (int)(upper_bound(bounds.begin(),bounds.end(),data) -
+	       bounds.begin());
+}
+
+template < class T, class Alloc, class LevelGen >
+void PersistentShardedList<T,Alloc,LevelGen>::enqueue(Shard* shard,
+						      const Change& change) {
+  bool idle;
+  {
+    std::lock_guard<std::mutex> guard(shard->lock);
+    // a worker only waits on an empty queue
+    idle = shard->queue.empty();
+    shard->queue.push_back(change);
+  }
+  if(idle)
+    shard->queued.notify_one();
+}
+
+template < class T, class Alloc, class LevelGen >
+int PersistentShardedList<T,Alloc,LevelGen>::insert(const T& data) {
+  Change change = { INSERT, data };
+  enqueue(shards[getShardIndex(data)],change);
+  return 0;
+}
+
+template < class T, class Alloc, class LevelGen >
+int PersistentShardedList<T,Alloc,LevelGen>::remove(const T& data) {
+  Change change = { REMOVE, data };
+  enqueue(shards[getShardIndex(data)],change);
+  return 0;
+}
+
+template < class T, class Alloc, class LevelGen >
+const char* PersistentShardedList<T,Alloc,LevelGen>::drain(void) {
+  const char* error = NULL;
+  for(size_t i = 0; i < shards.size(); ++i) {
+    Shard* shard = shards[i];
+    std::unique_lock<std::mutex> guard(shard->lock);
+    while(! shard->queue.empty() || shard->busy)
+      shard->drained.wait(guard);
+    if(error == NULL)
+      error = shard->error;
+    shard->error = NULL;
+  }
+  return error;
+}
+
+template < class T, class Alloc, class LevelGen >
+void PersistentShardedList<T,Alloc,LevelGen>::flush(void) {
+  const char* error = drain();
+  if(error != NULL)
+    throw error;
+}
+
+template < class T, class Alloc, class LevelGen >
+void PersistentShardedList<T,Alloc,LevelGen>::incTime(void) {
+  // every worker ends the version after the changes queued before
+  Change change = { INC_TIME, T() };
+  for(size_t i = 0; i < shards.size(); ++i)
+    enqueue(shards[i],change);
+  const char* error = drain();
+  // every shard has ended the version, so it can be published
+  atomicStore(&present, present+1);
+  if(error != NULL)
+    throw error;
+}
+
+template < class T, class Alloc, class LevelGen >
+void PersistentShardedList<T,Alloc,LevelGen>::work(Shard* shard) {
+  vector< Change > changes;
+  std::unique_lock<std::mutex> guard(shard->lock);
+  while(true) {
+    while(shard->queue.empty() && ! shard->stopping)
+      shard->queued.wait(guard);
+    if(shard->queue.empty())
+      return;
+    // take the whole queue, so changes are queued while these are made
+    changes.swap(shard->queue);
+    shard->busy = true;
+    guard.unlock();
+    for(size_t i = 0; i < changes.size(); ++i)
+      makeChange(shard,changes[i]);
+    changes.clear();
+    guard.lock();
+    shard->busy = false;
+    if(shard->queue.empty())
+      shard->drained.notify_all();
+  }
+}
+
+template < class T, class Alloc, class LevelGen >
+void PersistentShardedList<T,Alloc,LevelGen>::makeChange(
+  Shard* shard, const Change& change) {
+  PersistentSkipList<T,Alloc,LevelGen>& list = *shard->list;
+  const char* error = NULL;
+  switch(change.kind) {
+  case INSERT:
+    try {
+      list.insert(change.data);
+    } catch(const char* message) {
+      error = message;
+    }
+    break;
+  case REMOVE: {
+    PSLIterator<T,Alloc,LevelGen> found =
+      list.find(change.data,list.getPresent());
+    if(found == change.data)
+      found.remove();
+    else
+      error = "Tried to remove missing datum";
+    break;
+  }
+  case INC_TIME:
+    list.incTime();
+    break;
+  }
+  if(error != NULL) {
+    std::lock_guard<std::mutex> guard(shard->lock);
+    if(shard->error == NULL)
+      shard->error = error;
+  }
+}
+
+template < class T, class Alloc, class LevelGen >
+bool PersistentShardedList<T,Alloc,LevelGen>::contains(const T& data,
+						       int t) {
+  return shards[getShardIndex(data)]->list->find(data,t) == data;
+}
+
+template < class T, class Alloc, class LevelGen >
+PSLIterator<T,Alloc,LevelGen>
+PersistentShardedList<T,Alloc,LevelGen>::find(const T& toFind, int t) {
+  for(int i = getShardIndex(toFind); i > 0; --i) {
+    PersistentSkipList<T,Alloc,LevelGen>& list = *shards[i]->list;
+    // the first datum of an empty shard is its tail, after every datum
+    if(list.begin(t) <= toFind)
+      return list.find(toFind,t);
+  }
+  return shards[0]->list->find(toFind,t);
+}
+
+template < class T, class Alloc, class LevelGen >
+template < class OutputIterator >
+OutputIterator
+PersistentShardedList<T,Alloc,LevelGen>::range(const T& lo, const T& hi,
+					       int t, OutputIterator out) {
+  int last = getShardIndex(hi);
+  for(int i = getShardIndex(lo); i <= last; ++i)
+    out = shards[i]->list->range(lo,hi,t,out);
+  return out;
+}
+
+template < class T, class Alloc, class LevelGen >
+int PersistentShardedList<T,Alloc,LevelGen>::countRange(const T& lo,
+							const T& hi, int t) {
+  int count = 0;
+  int last = getShardIndex(hi);
+  for(int i = getShardIndex(lo); i <= last; ++i)
+    count += shards[i]->list->countRange(lo,hi,t);
+  return count;
+}
+
+#endif
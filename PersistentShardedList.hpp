@@ -0,0 +1,339 @@
+//-*- mode: c++ -*-////////////////////////////////////////////////////////////
+//                       Copyright (c) 2011 - 2012 by                        //
+//                                Simon Pratt                                //
+//                           (All rights reserved)                           //
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// FILE:    PersistentShardedList.hpp                                        //
+//                                                                           //
+// MODULE:  Persistent Skip List                                             //
+//                                                                           //
+// PURPOSE: Implements a persistent set whose data are partitioned by range  //
+//          across several persistent skip lists, each changed by a worker   //
+//          thread of its own, so that data are inserted on many cores at    //
+//          once.                                                            //
+//                                                                           //
+// NOTES:   Shard i holds the data from bounds[i-1] up to but not including  //
+//          bounds[i].  insert and remove queue a change for the worker of   //
+//          the datum's shard and return at once.  incTime queues the end    //
+//          of the version on every shard, waits for every queue to drain,   //
+//          and only then publishes the version, so every shard holds all    //
+//          of the changes of any version before getPresent().               //
+//                                                                           //
+//          One thread may change the list while any number of reader        //
+//          threads search times before getPresent(), as with                //
+//          PersistentSkipList.  The changing thread may also search the     //
+//          present after flush().                                           //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+//                             Public Methods:                               //
+//                                                                           //
+// insert(const T&)               - queues an insert at present              //
+// remove(const T&)               - queues a remove at present               //
+// flush()                        - waits for every queued change            //
+// incTime()                      - ends the present version on every shard  //
+// contains(const T&,int)         - finds a datum at a time                  //
+// find(const T&,int)             - finds the last datum at or before one    //
+// range(const T&,const T&,int,o) - copies the data in a range at a time     //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+#ifndef PERSISTENTSHARDEDLIST_HPP
+#define PERSISTENTSHARDEDLIST_HPP
+
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cassert>
+#include <cstddef>
+
+#include "PersistentSkipList.hpp"
+
+namespace persistent_skip_list {
+
+  /////////////////////////////////////////////////////////////////////////////
+  // PersistentShardedList interface                                         //
+  /////////////////////////////////////////////////////////////////////////////
+  template < class T, class Alloc = HeapAllocator,
+	     class LevelGen = GeometricLevels >
+  class PersistentShardedList {
+  public:
+    ///////////////////////////////////////////////////////////////////////////
+    //                                                                       //
+    // FUNCTION NAME: PersistentShardedList                                  //
+    //                                                                       //
+    // PURPOSE:       Constructor, which starts a worker for each shard.     //
+    //                                                                       //
+    // SECURITY:      public                                                 //
+    //                                                                       //
+    // PARAMETERS                                                            //
+    //   Type/Name:   const vector<T>&/bounds                                //
+    //   Description: The sorted least datum of every shard but the first,   //
+    //                so there is one more shard than bounds.                //
+    //                                                                       //
+    //   Type/Name:   int/nodeSize                                           //
+    //   Description: The node size of every shard.                          //
+    //                                                                       //
+    //   Type/Name:   const LevelGen&/levels                                 //
+    //   Description: The level generator each shard copies.                 //
+    //                                                                       //
+    // RETURN:        Void.                                                  //
+    //                                                                       //
+    // NOTES:         Bounds should split the data evenly, since a shard     //
+    //                holding most of the data leaves the other workers      //
+    //                idle.                                                  //
+    //                                                                       //
+    ///////////////////////////////////////////////////////////////////////////
+    PersistentShardedList(const vector< T >& bounds, int nodeSize=3,
+			  const LevelGen& levels=LevelGen());
+
+    ///////////////////////////////////////////////////////////////////////////
+    //                                                                       //
+    // FUNCTION NAME: ~PersistentShardedList                                 //
+    //                                                                       //
+    // PURPOSE:       Destructor.                                            //
+    //                                                                       //
+    // SECURITY:      public                                                 //
+    //                                                                       //
+    // PARAMETERS                                                            //
+    //   Type/Name:   Void.                                                  //
+    //   Description: None.                                                  //
+    //                                                                       //
+    // RETURN:        Void.                                                  //
+    //                                                                       //
+    // NOTES:         Lets each worker finish its queue, then joins it.      //
+    //                                                                       //
+    ///////////////////////////////////////////////////////////////////////////
+    ~PersistentShardedList(void);
+
+    int getPresent(void) const;
+    int getShardCount(void) const;
+
+    ///////////////////////////////////////////////////////////////////////////
+    //                                                                       //
+    // FUNCTION NAME: insert                                                 //
+    //                                                                       //
+    // PURPOSE:       Queues an insert in the present version.               //
+    //                                                                       //
+    // SECURITY:      public                                                 //
+    //                                                                       //
+    // PARAMETERS                                                            //
+    //   Type/Name:   const T&/data                                          //
+    //   Description: The datum to insert.                                   //
+    //                                                                       //
+    // RETURN:                                                               //
+    //   Type/Name:   int                                                    //
+    //   Description: 0 on success.                                          //
+    //                                                                       //
+    // NOTES:         A duplicate is reported by the next flush or incTime.  //
+    //                                                                       //
+    ///////////////////////////////////////////////////////////////////////////
+    int insert(const T& data);
+
+    ///////////////////////////////////////////////////////////////////////////
+    //                                                                       //
+    // FUNCTION NAME: remove                                                 //
+    //                                                                       //
+    // PURPOSE:       Queues a remove in the present version.                //
+    //                                                                       //
+    // SECURITY:      public                                                 //
+    //                                                                       //
+    // PARAMETERS                                                            //
+    //   Type/Name:   const T&/data                                          //
+    //   Description: The datum to remove.                                   //
+    //                                                                       //
+    // RETURN:                                                               //
+    //   Type/Name:   int                                                    //
+    //   Description: 0 on success.                                          //
+    //                                                                       //
+    // NOTES:         A missing datum is reported by the next flush or       //
+    //                incTime.                                               //
+    //                                                                       //
+    ///////////////////////////////////////////////////////////////////////////
+    int remove(const T& data);
+
+    ///////////////////////////////////////////////////////////////////////////
+    //                                                                       //
+    // FUNCTION NAME: flush                                                  //
+    //                                                                       //
+    // PURPOSE:       Waits until every queued change has been made.         //
+    //                                                                       //
+    // SECURITY:      public                                                 //
+    //                                                                       //
+    // PARAMETERS                                                            //
+    //   Type/Name:   Void.                                                  //
+    //   Description: None.                                                  //
+    //                                                                       //
+    // RETURN:        Void.                                                  //
+    //                                                                       //
+    // NOTES:         Throws the first error of a change since the last      //
+    //                flush, once every change has been made.  The changes   //
+    //                which didn't fail are kept.                            //
+    //                                                                       //
+    ///////////////////////////////////////////////////////////////////////////
+    void flush(void);
+
+    ///////////////////////////////////////////////////////////////////////////
+    //                                                                       //
+    // FUNCTION NAME: incTime                                                //
+    //                                                                       //
+    // PURPOSE:       Ends the present version on every shard, then          //
+    //                publishes it.                                          //
+    //                                                                       //
+    // SECURITY:      public                                                 //
+    //                                                                       //
+    // PARAMETERS                                                            //
+    //   Type/Name:   Void.                                                  //
+    //   Description: None.                                                  //
+    //                                                                       //
+    // RETURN:        Void.                                                  //
+    //                                                                       //
+    // NOTES:         Flushes, so throws as flush does, but only after the   //
+    //                version is published.                                  //
+    //                                                                       //
+    ///////////////////////////////////////////////////////////////////////////
+    void incTime(void);
+
+    ///////////////////////////////////////////////////////////////////////////
+    //                                                                       //
+    // FUNCTION NAME: contains                                               //
+    //                                                                       //
+    // PURPOSE:       Checks whether a datum is in the list at a time.       //
+    //                                                                       //
+    // SECURITY:      public                                                 //
+    //                                                                       //
+    // PARAMETERS                                                            //
+    //   Type/Name:   const T&/data                                          //
+    //   Description: The datum to find.                                     //
+    //                                                                       //
+    //   Type/Name:   int/t                                                  //
+    //   Description: The time at which to search.                           //
+    //                                                                       //
+    // RETURN:                                                               //
+    //   Type/Name:   bool                                                   //
+    //   Description: True if the datum is in the list at time t.            //
+    //                                                                       //
+    // NOTES:         Searches the datum's shard alone.                      //
+    //                                                                       //
+    ///////////////////////////////////////////////////////////////////////////
+    bool contains(const T& data, int t);
+
+    ///////////////////////////////////////////////////////////////////////////
+    //                                                                       //
+    // FUNCTION NAME: find                                                   //
+    //                                                                       //
+    // PURPOSE:       Finds the last datum at or before one at a time.       //
+    //                                                                       //
+    // SECURITY:      public                                                 //
+    //                                                                       //
+    // PARAMETERS                                                            //
+    //   Type/Name:   const T&/toFind                                        //
+    //   Description: The datum to find.                                     //
+    //                                                                       //
+    //   Type/Name:   int/t                                                  //
+    //   Description: The time at which to search.                           //
+    //                                                                       //
+    // RETURN:                                                               //
+    //   Type/Name:   PSLIterator<T,Alloc,LevelGen>                          //
+    //   Description: An iterator over the shard holding the datum found,    //
+    //                or the head of the first shard if there is none.       //
+    //                                                                       //
+    // NOTES:         If the datum's shard holds nothing at or before it,    //
+    //                the last datum of an earlier shard is found.  The      //
+    //                iterator doesn't cross into the next shard.            //
+    //                                                                       //
+    ///////////////////////////////////////////////////////////////////////////
+    PSLIterator<T,Alloc,LevelGen> find(const T& toFind, int t);
+
+    ///////////////////////////////////////////////////////////////////////////
+    //                                                                       //
+    // FUNCTION NAME: range                                                  //
+    //                                                                       //
+    // PURPOSE:       Writes the data from lo to hi inclusive at time t to   //
+    //                an output iterator, in order.                          //
+    //                                                                       //
+    // SECURITY:      public                                                 //
+    //                                                                       //
+    // PARAMETERS                                                            //
+    //   Type/Name:   const T&/lo                                            //
+    //   Description: The least datum to write.                              //
+    //                                                                       //
+    //   Type/Name:   const T&/hi                                            //
+    //   Description: The greatest datum to write.                           //
+    //                                                                       //
+    //   Type/Name:   int/t                                                  //
+    //   Description: The time at which to query.                            //
+    //                                                                       //
+    //   Type/Name:   OutputIterator/out                                     //
+    //   Description: Where to write the data.                               //
+    //                                                                       //
+    // RETURN:                                                               //
+    //   Type/Name:   OutputIterator                                         //
+    //   Description: The output iterator past the last datum written.       //
+    //                                                                       //
+    // NOTES:         The shards are disjoint ranges, so the shards the      //
+    //                range overlaps are merged by querying them in order.   //
+    //                                                                       //
+    ///////////////////////////////////////////////////////////////////////////
+    template <class OutputIterator>
+    OutputIterator range(const T& lo, const T& hi, int t, OutputIterator out);
+
+    int countRange(const T& lo, const T& hi, int t);
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Kindly ignore my private parts                                        //
+    ///////////////////////////////////////////////////////////////////////////
+  private:
+    enum ChangeKind { INSERT, REMOVE, INC_TIME };
+
+    // a change queued for a worker
+    struct Change {
+      ChangeKind kind;
+      T data;
+    };
+
+    // A skip list and the worker which alone changes it.  The queue,
+    // busy, error and stopping are guarded by the lock.
+    struct Shard {
+      PersistentSkipList<T,Alloc,LevelGen>* list;
+      std::thread worker;
+      std::mutex lock;
+      // signalled when changes are queued or the worker should stop
+      std::condition_variable queued;
+      // signalled when the worker has made every queued change
+      std::condition_variable drained;
+      vector< Change > queue;
+      // true while the worker makes changes taken from the queue
+      bool busy;
+      bool stopping;
+      // the first error since the last flush, or NULL
+      const char* error;
+    };
+
+    // the least datum of every shard but the first
+    vector< T > bounds;
+    vector< Shard* > shards;
+    // the last version published on every shard
+    int present;
+
+    // the index of the shard which holds a datum
+    int getShardIndex(const T& data) const;
+    void enqueue(Shard* shard, const Change& change);
+    // waits for every queue to drain, returning the first error
+    const char* drain(void);
+    // the loop of a worker, until it is stopped with an empty queue
+    static void work(Shard* shard);
+    static void makeChange(Shard* shard, const Change& change);
+
+    // the list owns its shards, so can't be copied
+    PersistentShardedList(const PersistentShardedList<T,Alloc,LevelGen>&);
+    PersistentShardedList<T,Alloc,LevelGen>& operator=(
+      const PersistentShardedList<T,Alloc,LevelGen>&);
+  };
+}
+
+#include "PersistentShardedList.cpp"
+
+#endif
@@ -22,50 +22,153 @@ using namespace persistent_skip_list;
 // PersistentSkipList Implementation                                         //
 ///////////////////////////////////////////////////////////////////////////////
 
-template <class T>
-PersistentSkipList<T>::PersistentSkipList(int nodeSize)
-  : node_size(nodeSize), present(0), head(), tail(), data_set()
+#ifdef PSL_SEARCH_PATH
+template <class T, class Alloc, class LevelGen, bool Ranked>
+thread_local vector< const T* >
+PersistentSkipList<T,Alloc,LevelGen,Ranked>::lastSearchPath;
+#endif
+
+template <class T, class Alloc, class LevelGen, bool Ranked>
+PersistentSkipList<T,Alloc,LevelGen,Ranked>::PersistentSkipList(
+  int nodeSize, const LevelGen& l)
+  : node_size(nodeSize), allocator(), levels(l), present(0),
+    roots(new VersionRoot[4]), root_count(1), root_capacity(4),
+    retired_roots(), nodes(), journal(NULL), changes(new Change[4]),
+    change_count(0), change_capacity(4), retired_changes(), insert_fingers(),
+    insert_ranks()
 {
-  SmartPointer<ListNode<T> > negInf(new ListNode<T>(1,false));
-  SmartPointer<ListNode<T> > posInf(new ListNode<T>(1,true));
-  head.insert( pair<int,SmartPointer<ListNode<T> > >(0,negInf) );
-  tail.insert( pair<int,SmartPointer<ListNode<T> > >(0,posInf) );
+  ListNode<T,Alloc,Ranked>* negInf = createNode(1,false);
+  ListNode<T,Alloc,Ranked>* posInf = createNode(1,true);
+  roots[0].time = 0;
+  roots[0].head = negInf;
+  roots[0].tail = posInf;
   // set next on negInf to posInf
-  TSA* newNext = new TSA(0,1);
-  newNext->setElement(0,posInf);
+  TSA* newNext = negInf->createNext(0);
+  negInf->setLink(newNext,0,posInf);
+  if constexpr(Ranked)
+    negInf->setWidth(newNext,0,1);
   negInf->addNext(newNext);
 }
 
-template <class T>
-PersistentSkipList<T>::~PersistentSkipList() {
+template <class T, class Alloc, class LevelGen, bool Ranked>
+PersistentSkipList<T,Alloc,LevelGen,Ranked>::~PersistentSkipList() {
+  delete[] roots;
+  while(! retired_roots.empty()) {
+    delete[] retired_roots.back();
+    retired_roots.pop_back();
+  }
+  delete[] changes;
+  while(! retired_changes.empty()) {
+    delete[] retired_changes.back();
+    retired_changes.pop_back();
+  }
+  while(! nodes.empty()) {
+    destroyNode(nodes.back());
+    nodes.pop_back();
+  }
+}
+
+template <class T, class Alloc, class LevelGen, bool Ranked>
+size_t PersistentSkipList<T,Alloc,LevelGen,Ranked>::getNodeBytes(int height) {
+  return sizeof(ListNode<T,Alloc,Ranked>) +
+    ListNode<T,Alloc,Ranked>::getStorageSize(height,node_size);
+}
+
+template <class T, class Alloc, class LevelGen, bool Ranked>
+ListNode<T,Alloc,Ranked>*
+PersistentSkipList<T,Alloc,LevelGen,Ranked>::createNode(const T& data) {
+  // the height sizes the block, so is picked first
+  return createNode(data,levels.pickHeight());
+}
+
+template <class T, class Alloc, class LevelGen, bool Ranked>
+ListNode<T,Alloc,Ranked>*
+PersistentSkipList<T,Alloc,LevelGen,Ranked>::createNode(const T& data,
+							int height) {
+  return emplaceNode(height,data);
+}
+
+template <class T, class Alloc, class LevelGen, bool Ranked>
+template <class... Args>
+ListNode<T,Alloc,Ranked>*
+PersistentSkipList<T,Alloc,LevelGen,Ranked>::emplaceNode(int height,
+							 Args&&... args) {
+  void* block = allocator.allocate(getNodeBytes(height));
+  ListNode<T,Alloc,Ranked>* node =
+    new (block) ListNode<T,Alloc,Ranked>(std::in_place,height,node_size,
+					 &allocator,
+					 (ListNode<T,Alloc,Ranked>*)block + 1,
+					 std::forward<Args>(args)...);
+  nodes.push_back(node);
+  return node;
+}
+
+template <class T, class Alloc, class LevelGen, bool Ranked>
+ListNode<T,Alloc,Ranked>*
+PersistentSkipList<T,Alloc,LevelGen,Ranked>::createNode(int height,
+							bool positive) {
+  void* block = allocator.allocate(getNodeBytes(height));
+  ListNode<T,Alloc,Ranked>* node =
+    new (block) ListNode<T,Alloc,Ranked>(height,positive,node_size,&allocator,
+					 (ListNode<T,Alloc,Ranked>*)block + 1);
+  nodes.push_back(node);
+  return node;
 }
 
-template <class T>
-int PersistentSkipList<T>::getPresent() const {
+template <class T, class Alloc, class LevelGen, bool Ranked>
+ListNode<T,Alloc,Ranked>*
+PersistentSkipList<T,Alloc,LevelGen,Ranked>::copyNode(
+  const ListNode<T,Alloc,Ranked>& original) {
+  void* block = allocator.allocate(getNodeBytes(original.getHeight()));
+  ListNode<T,Alloc,Ranked>* node =
+    new (block) ListNode<T,Alloc,Ranked>(original,
+					 (ListNode<T,Alloc,Ranked>*)block + 1);
+  nodes.push_back(node);
+  return node;
+}
+
+template <class T, class Alloc, class LevelGen, bool Ranked>
+void
+PersistentSkipList<T,Alloc,LevelGen,Ranked>::destroyNode(
+  ListNode<T,Alloc,Ranked>* node) {
+  assert(node != NULL);
+  size_t bytes = getNodeBytes(node->getHeight());
+  node->~ListNode<T,Alloc,Ranked>();
+  allocator.deallocate(node, bytes);
+}
+
+template <class T, class Alloc, class LevelGen, bool Ranked>
+int PersistentSkipList<T,Alloc,LevelGen,Ranked>::getPresent() const {
   assert(this != NULL);
-  return present;
+  // pairs with incTime, so every change made before is visible
+  return atomicLoad(&present);
 }
 
-template <class T>
-PersistentSkipList<T>& PersistentSkipList<T>::operator++() {
+template <class T, class Alloc, class LevelGen, bool Ranked>
+PersistentSkipList<T,Alloc,LevelGen,Ranked>&
+PersistentSkipList<T,Alloc,LevelGen,Ranked>::operator++() {
   incTime();
   return this;
 }
 
-template <class T>
-void PersistentSkipList<T>::incTime() {
+template <class T, class Alloc, class LevelGen, bool Ranked>
+void PersistentSkipList<T,Alloc,LevelGen,Ranked>::incTime() {
   assert(this != NULL);
-  ++present;
+  // publish the changes made at present to readers
+  atomicStore(&present, present+1);
+  if constexpr(JOURNALED)
+    if(journal != NULL)
+      journal->logIncTime();
 }
 
-template <class T>
-void PersistentSkipList<T>::drawPresent() {
+template <class T, class Alloc, class LevelGen, bool Ranked>
+void PersistentSkipList<T,Alloc,LevelGen,Ranked>::drawPresent() {
   assert(this != NULL);
   draw(getPresent());
 }
 
-template <class T>
-void PersistentSkipList<T>::draw(int t) {
+template <class T, class Alloc, class LevelGen, bool Ranked>
+void PersistentSkipList<T,Alloc,LevelGen,Ranked>::draw(int t) {
   assert(this != NULL);
   assert(t >= 0);
   cout << "Drawing skip list at time " << t << "..." << endl;
@@ -74,7 +177,7 @@ void PersistentSkipList<T>::draw(int t) {
     return;
   }
   for(int i = 0; i < getHeight(t); ++i) {
-    PSLIterator<T> next = begin(t,i);
+    PSLIterator<T,Alloc,LevelGen,Ranked> next = begin(t,i);
     
     cout << "Height: " << i+1 << endl;
     
@@ -86,72 +189,127 @@ void PersistentSkipList<T>::draw(int t) {
   }
 }
 
-template <class T>
-int PersistentSkipList<T>::addHead(SmartPointer<ListNode<T> > new_head) {
+template <class T, class Alloc, class LevelGen, bool Ranked>
+int
+PersistentSkipList<T,Alloc,LevelGen,Ranked>::addHead(
+  ListNode<T,Alloc,Ranked>* new_head) {
   assert(this != NULL);
   assert(new_head != NULL);
-  // delete old head if exists
-  if(head.count(present) > 0)
-    head.erase(present); // shouldn't leak using smart pointer
-  // save the new head
-  head.insert( pair< int, SmartPointer<ListNode<T> > >(present,new_head) );
+  // save the new head, the old one is still owned by the list
+  getPresentRoot().head = new_head;
   // success
   return 0;
 }
 
-template <class T>
-SmartPointer<ListNode<T> >& PersistentSkipList<T>::getHead(int t) {
-  // reverse linear search from starting time
-  while(head.count(t) == 0)
-    --t;
-  return head[t];
+template <class T, class Alloc, class LevelGen, bool Ranked>
+ListNode<T,Alloc,Ranked>*
+PersistentSkipList<T,Alloc,LevelGen,Ranked>::getHead(int t) {
+  return getRoot(t).head;
 }
 
-template <class T>
-int PersistentSkipList<T>::addTail(SmartPointer<ListNode<T> > new_tail) {
+template <class T, class Alloc, class LevelGen, bool Ranked>
+int
+PersistentSkipList<T,Alloc,LevelGen,Ranked>::addTail(
+  ListNode<T,Alloc,Ranked>* new_tail) {
   assert(this != NULL);
   assert(new_tail != NULL);
-  // delete old head if exists
-  if(tail.count(present) > 0)
-    tail.erase(present); // shouldn't leak using smart pointer
-  // save the new head
-  tail.insert( pair< int, SmartPointer<ListNode<T> > >(present,new_tail) );
+  // save the new tail, the old one is still owned by the list
+  getPresentRoot().tail = new_tail;
   // success
   return 0;
 }
 
-template <class T>
-SmartPointer<ListNode<T> >& PersistentSkipList<T>::getTail(int t) {
-  // reverse linear search from starting time
-  while(tail.count(t) == 0)
-    --t;
-  return tail[t];
+template <class T, class Alloc, class LevelGen, bool Ranked>
+ListNode<T,Alloc,Ranked>*
+PersistentSkipList<T,Alloc,LevelGen,Ranked>::getTail(int t) {
+  return getRoot(t).tail;
+}
+
+template <class T, class Alloc, class LevelGen, bool Ranked>
+typename PersistentSkipList<T,Alloc,LevelGen,Ranked>::VersionRoot&
+PersistentSkipList<T,Alloc,LevelGen,Ranked>::getRoot(int t) {
+  assert(t >= 0);
+  // load the count first, since a replaced array holds as many roots
+  int count = atomicLoad(&root_count);
+  VersionRoot* published = atomicLoad(&roots);
+  // the present is the most common query, so check it first
+  if(published[count-1].time <= t)
+    return published[count-1];
+  // binary search for the last root at or before time t
+  int begin = 0, end = count -1;
+  while(begin < end) {
+    int index = (begin+end+1)/2;
+    if(published[index].time > t)
+      // repeat binary search on left (earlier) half
+      end = index -1;
+    else
+      // repeat binary search on right (later) half
+      begin = index;
+  }
+  return published[begin];
+}
+
+template <class T, class Alloc, class LevelGen, bool Ranked>
+typename PersistentSkipList<T,Alloc,LevelGen,Ranked>::VersionRoot&
+PersistentSkipList<T,Alloc,LevelGen,Ranked>::getPresentRoot(void) {
+  if(roots[root_count-1].time == present)
+    return roots[root_count-1];
+  // readers may be searching a full array, so replace it with a copy
+  // twice the size and keep it until the list is destroyed
+  if(root_count == root_capacity) {
+    VersionRoot* grown = new VersionRoot[2*root_capacity];
+    for(int i = 0; i < root_count; ++i)
+      grown[i] = roots[i];
+    retired_roots.push_back(roots);
+    atomicStore(&roots, grown);
+    root_capacity *= 2;
+  }
+  // start a new root from the last one, then publish it
+  roots[root_count] = roots[root_count-1];
+  roots[root_count].time = present;
+  atomicStore(&root_count, root_count+1);
+  return roots[root_count-1];
 }
 
-template <class T>
-void PersistentSkipList<T>::buildHeadAndTail(int new_height) {
+template <class T, class Alloc, class LevelGen, bool Ranked>
+void PersistentSkipList<T,Alloc,LevelGen,Ranked>::buildHeadAndTail(
+  int new_height, vector< ListNode<T,Alloc,Ranked>* >* fingers) {
   assert(new_height > getHeight(getPresent()));
   int present = getPresent();
-  SmartPointer<ListNode<T> > old_head = getHead(present);
-  SmartPointer<ListNode<T> > old_tail = getTail(present);
+  ListNode<T,Alloc,Ranked>* old_head = getHead(present);
+  ListNode<T,Alloc,Ranked>* old_tail = getTail(present);
   int old_height = old_head->getHeight();
   assert(new_height > old_height);
   assert(old_height == old_tail->getHeight());
-  SmartPointer<ListNode<T> > new_head(new ListNode<T>(new_height,false));
-  SmartPointer<ListNode<T> > new_tail(new ListNode<T>(new_height,true));
+  ListNode<T,Alloc,Ranked>* new_head = createNode(new_height,false);
+  ListNode<T,Alloc,Ranked>* new_tail = createNode(new_height,true);
   assert(new_head->getHeight() == new_tail->getHeight());
-  TSA* new_next = new TSA(present,new_height);
+  TSA* new_next = new_head->createNext(present);
+  // the width from the head to the tail, along the old top level
+  int span = 0;
+  if constexpr(Ranked)
+    for(ListNode<T,Alloc,Ranked>* node = old_head; node != old_tail; ) {
+      TSA* node_next = node->getNext(present);
+      span += node->getWidth(node_next,old_height-1);
+      node = node->getLink(node_next,old_height-1);
+    }
   // make the tail the new next above the old height
   while(--new_height >= old_height) {
-    new_next->setElement(new_height,new_tail);
+    new_head->setLink(new_next,new_height,new_tail);
+    if constexpr(Ranked)
+      new_head->setWidth(new_next,new_height,span);
   }
+  TSA* old_head_next = old_head->getNext(present);
   while(new_height >= 0) {
-    SmartPointer<ListNode<T> > next_node =
-      old_head->getNext(present)->getElement(new_height);
+    ListNode<T,Alloc,Ranked>* next_node =
+      old_head->getLink(old_head_next,new_height);
     if(next_node == old_tail)
-      new_next->setElement(new_height,new_tail);
+      new_head->setLink(new_next,new_height,new_tail);
     else
-      new_next->setElement(new_height,next_node);
+      new_head->setLink(new_next,new_height,next_node);
+    if constexpr(Ranked)
+      new_head->setWidth(new_next,new_height,
+			 old_head->getWidth(old_head_next,new_height));
     --new_height;
   }
   new_head->addNext(new_next);
@@ -163,45 +321,416 @@ void PersistentSkipList<T>::buildHeadAndTail(int new_height) {
     while(end > 0 &&
 	  old_tail->getIncoming(end-1) == old_tail->getIncoming(old_height))
       --end;
-    ListNode<T>* toChange = old_tail->getIncoming(old_height);
+    ListNode<T,Alloc,Ranked>* toChange = old_tail->getIncoming(old_height);
     if(old_head == toChange) {
       old_height = end-1;
       continue;
     }
-    new_next = new TSA(present,
-		       toChange->getHeight(),
-		       *(toChange->getNext(present)));
+    // only the levels pointing to the old tail change
+    new_next = toChange->createNext(present,*(toChange->getNext(present)),end);
     while(old_height >= end) {
-      new_next->setElement(old_height,new_tail);
+      toChange->setLink(new_next,old_height,new_tail);
       new_tail->setIncoming(old_height,toChange);
       --old_height;
     }
-    toChange->addNext(new_next);
+    addNext(toChange,new_next,fingers);
   }
   addTail(new_tail);
+  if(fingers != NULL)
+    replace(fingers->begin(),fingers->end(),old_head,new_head);
+  old_head->retire();
+  old_tail->retire();
 }
 
-template < class T >
-PSLIterator<T> PersistentSkipList<T>::begin(int t, int h) {
-  return ++(PSLIterator<T>(getHead(t),*this,t,h));
+template <class T, class Alloc, class LevelGen, bool Ranked>
+ListNode<T,Alloc,Ranked>*
+PersistentSkipList<T,Alloc,LevelGen,Ranked>::addNext(
+  ListNode<T,Alloc,Ranked>* node, TSA* next,
+  vector< ListNode<T,Alloc,Ranked>* >* fingers) {
+  assert(node != NULL);
+  assert(next != NULL);
+  if(! node->isFull(next->getTime())) {
+    node->addNext(next);
+    return node;
+  }
+  // the change log is full, so the next pointers go to a fresh copy of
+  // the node which replaces it from the present onwards
+  ListNode<T,Alloc,Ranked>* copy = copyNode(*node);
+  if(node->getLowest(next) > 0) {
+    // the levels below are read from the node's change log, which the
+    // copy doesn't share
+    TSA* full = node->createNext(next->getTime(),*next);
+    node->destroyNext(next);
+    next = full;
+  }
+  // the copy's first change goes in its own block
+  TSA* copy_next = copy->createNext(next->getTime(),*next);
+  node->destroyNext(next);
+  copy->addNext(copy_next);
+  node->retire();
+  if(fingers != NULL)
+    replace(fingers->begin(),fingers->end(),node,copy);
+  if(node->isNegativeInfinity()) {
+    addHead(copy);
+    return copy;
+  }
+  // redirect the predecessors to the copy, which may in turn copy them
+  int start = node->getHeight()-1;
+  while(start >= 0) {
+    // determine how many levels are the same incoming node
+    ListNode<T,Alloc,Ranked>* incoming = node->getIncoming(start);
+    int end = start;
+    while(end >= 0 && node->getIncoming(end) == incoming)
+      --end;
+    TSA* inc_next = getPresentNext(incoming,end+1,fingers);
+    while(start > end) {
+      assert((incoming->getLink(inc_next,start) == node));
+      incoming->setLink(inc_next,start,copy);
+      copy->setIncoming(start,incoming);
+      --start;
+    }
+  }
+  return copy;
+}
+
+template <class T, class Alloc, class LevelGen, bool Ranked>
+typename PersistentSkipList<T,Alloc,LevelGen,Ranked>::TSA*
+PersistentSkipList<T,Alloc,LevelGen,Ranked>::getPresentNext(
+  ListNode<T,Alloc,Ranked>*& node, int lowest,
+  vector< ListNode<T,Alloc,Ranked>* >* fingers) {
+  int present = getPresent();
+  TSA* next = node->getNext(present);
+  assert(next != NULL);
+  // next pointers from the present aren't visible to readers, so
+  // they can be changed in place if they hold the levels
+  if(next->getTime() == present &&
+     node->getLowest(next) <= lowest)
+    return next;
+  next = node->createNext(present,*next,lowest);
+  node = addNext(node,next,fingers);
+  // a copied node holds a copy of them
+  return node->getNext(present);
+}
+
+template <class T, class Alloc, class LevelGen, bool Ranked>
+int PersistentSkipList<T,Alloc,LevelGen,Ranked>::getFingerLowest(
+  const vector< ListNode<T,Alloc,Ranked>* >& fingers, int level) {
+  int lowest = level;
+  while(lowest > 0 && fingers[lowest-1] == fingers[level])
+    --lowest;
+  return lowest;
+}
+
+template <class T, class Alloc, class LevelGen, bool Ranked>
+bool PersistentSkipList<T,Alloc,LevelGen,Ranked>::placeFingers(
+  const T& data, vector< ListNode<T,Alloc,Ranked>* >& fingers,
+  vector< int >& ranks) {
+  int present = getPresent();
+  int top = (int)fingers.size()-1;
+  assert(ranks.size() == fingers.size());
+  for(int level = top; level >= 0; --level) {
+    // continue from the finger above if it is further along
+    if(level < top && *(fingers[level+1]) > *(fingers[level])) {
+      fingers[level] = fingers[level+1];
+      ranks[level] = ranks[level+1];
+    }
+    TSA* finger_next = fingers[level]->getNext(present);
+    ListNode<T,Alloc,Ranked>* next_ln =
+      fingers[level]->getLink(finger_next,level);
+    while(*next_ln < data) {
+      if constexpr(Ranked)
+	ranks[level] += fingers[level]->getWidth(finger_next,level);
+      fingers[level] = next_ln;
+      finger_next = next_ln->getNext(present);
+      next_ln = next_ln->getLink(finger_next,level);
+    }
+  }
+  // an equal datum is the finger or right after it at the bottom
+  return !(*(fingers[0]) == data) &&
+    !(*(fingers[0]->getLink(fingers[0]->getNext(present),0)) == data);
+}
+
+template <class T, class Alloc, class LevelGen, bool Ranked>
+void PersistentSkipList<T,Alloc,LevelGen,Ranked>::linkNode(
+  ListNode<T,Alloc,Ranked>* node, vector< ListNode<T,Alloc,Ranked>* >& fingers,
+  vector< int >& ranks) {
+  int present = getPresent();
+  int height = node->getHeight();
+  int top = (int)fingers.size()-1;
+  assert(height <= top+1);
+  assert(ranks.size() == fingers.size());
+  if constexpr(Ranked) {
+    // the node goes under the fingers' links above its height, which
+    // span one more
+    for(int level = top; level >= height; --level) {
+      TSA* finger_next = getPresentNext(fingers[level],
+					getFingerLowest(fingers,level),
+					&fingers);
+      fingers[level]->setWidth(finger_next,level,
+			       fingers[level]->getWidth(finger_next,level)+1);
+    }
+    // so do the links above the fingers
+    adjustWidths(fingers[top],top+1,1,&fingers);
+  }
+  // the node is one after the finger at the bottom level
+  int rank = ranks[0]+1;
+  TSA* node_next = node->createNext(present);
+  for(int level = height-1; level >= 0; --level) {
+    // insert the node between the finger and its successor
+    TSA* finger_next = getPresentNext(fingers[level],
+				      getFingerLowest(fingers,level),&fingers);
+    node->setLink(node_next,level,fingers[level]->getLink(finger_next,level));
+    if constexpr(Ranked) {
+      int width = rank - ranks[level];
+      node->setWidth(node_next,level,
+		     fingers[level]->getWidth(finger_next,level)+1-width);
+      fingers[level]->setWidth(finger_next,level,width);
+    }
+    fingers[level]->setLink(finger_next,level,node);
+    node->setIncoming(level,fingers[level]);
+  }
+  node->addNext(node_next);
+  // the node precedes whatever comes next
+  for(int level = 0; level < height; ++level) {
+    fingers[level] = node;
+    ranks[level] = rank;
+  }
 }
 
-template < class T >
-PSLIterator<T> PersistentSkipList<T>::end(int t) {
-  return PSLIterator<T>(getTail(t),*this,t);
+template <class T, class Alloc, class LevelGen, bool Ranked>
+void PersistentSkipList<T,Alloc,LevelGen,Ranked>::adjustWidths(
+  ListNode<T,Alloc,Ranked>* node, int level, int delta,
+  vector< ListNode<T,Alloc,Ranked>* >* fingers) {
+  static_assert(Ranked, "Only a Ranked list keeps widths");
+  int top = getHeight(getPresent())-1;
+  while(level <= top) {
+    // the link at this level over the node's position belongs to the
+    // nearest node at least this tall before it
+    while(node->getHeight() <= level)
+      node = node->getIncoming(node->getHeight()-1);
+    TSA* next = getPresentNext(node,level,fingers);
+    for(; level < node->getHeight(); ++level)
+      node->setWidth(next,level,node->getWidth(next,level)+delta);
+  }
 }
 
-template < class T >
-PSLIterator<T> PersistentSkipList<T>::find(const T& toFind, int t) {
-#ifndef NDEBUG
+template <class T, class Alloc, class LevelGen, bool Ranked>
+void
+PersistentSkipList<T,Alloc,LevelGen,Ranked>::removeNode(
+  ListNode<T,Alloc,Ranked>* node) {
+  unlinkNode(node);
+  logChange(node,false);
+  if constexpr(JOURNALED)
+    if(journal != NULL)
+      journal->logRemove(node->getData());
+}
+
+template <class T, class Alloc, class LevelGen, bool Ranked>
+void
+PersistentSkipList<T,Alloc,LevelGen,Ranked>::unlinkNode(
+  ListNode<T,Alloc,Ranked>* node) {
+  assert(! node->isNegativeInfinity());
+  assert(! node->isPositiveInfinity());
+  int present = getPresent();
+  // the links over the node span one less
+  if constexpr(Ranked)
+    adjustWidths(node,node->getHeight(),-1,NULL);
+  TSA* node_next = node->getNext(present);
+  // start at the uppermost level
+  int start = node->getHeight()-1;
+  while(start >= 0) {
+    // determine how many levels are the same incoming node
+    ListNode<T,Alloc,Ranked>* incoming = node->getIncoming(start);
+    int end = start;
+    while(end >= 0 && node->getIncoming(end) == incoming)
+      --end;
+    // point the incoming node past this one
+    TSA* inc_next = incoming->createNext(present,
+					 *(incoming->getNext(present)),end+1);
+    while(start > end) {
+      incoming->setLink(inc_next,start,node->getLink(node_next,start));
+      if constexpr(Ranked)
+	incoming->setWidth(inc_next,start,
+			   incoming->getWidth(inc_next,start) +
+			   node->getWidth(node_next,start) - 1);
+      --start;
+    }
+    addNext(incoming,inc_next);
+  }
+  node->retire();
+}
+
+template <class T, class Alloc, class LevelGen, bool Ranked>
+void PersistentSkipList<T,Alloc,LevelGen,Ranked>::logChange(
+  const ListNode<T,Alloc,Ranked>* node, bool inserted) {
+  // readers may be reading a full array, so replace it as getPresentRoot
+  // replaces the roots
+  if(change_count == change_capacity) {
+    Change* grown = new Change[2*change_capacity];
+    for(int i = 0; i < change_count; ++i)
+      grown[i] = changes[i];
+    retired_changes.push_back(changes);
+    atomicStore(&changes, grown);
+    change_capacity *= 2;
+  }
+  changes[change_count].time = getPresent();
+  changes[change_count].inserted = inserted;
+  changes[change_count].node = node;
+  atomicStore(&change_count, change_count+1);
+}
+
+template <class T, class Alloc, class LevelGen, bool Ranked>
+bool PersistentSkipList<T,Alloc,LevelGen,Ranked>::changeLess(const Change* a,
+							     const Change* b) {
+  return a->node->getData() < b->node->getData();
+}
+
+template <class T, class Alloc, class LevelGen, bool Ranked>
+bool PersistentSkipList<T,Alloc,LevelGen,Ranked>::dataLess(const T* a,
+							   const T* b) {
+  return *a < *b;
+}
+
+template < class T, class Alloc, class LevelGen, bool Ranked >
+PSLIterator<T,Alloc,LevelGen,Ranked>
+PersistentSkipList<T,Alloc,LevelGen,Ranked>::begin(int t, int h) {
+  return ++(PSLIterator<T,Alloc,LevelGen,Ranked>(getHead(t),*this,t,h));
+}
+
+template < class T, class Alloc, class LevelGen, bool Ranked >
+PSLIterator<T,Alloc,LevelGen,Ranked>
+PersistentSkipList<T,Alloc,LevelGen,Ranked>::end(int t) {
+  return PSLIterator<T,Alloc,LevelGen,Ranked>(getTail(t),*this,t);
+}
+
+template < class T, class Alloc, class LevelGen, bool Ranked >
+PSLIterator<T,Alloc,LevelGen,Ranked>
+PersistentSkipList<T,Alloc,LevelGen,Ranked>::find(const T& toFind, int t) {
+#ifdef PSL_SEARCH_PATH
+  lastSearchPath.clear();
+#endif
+  return searchFrom(PSLIterator<T,Alloc,LevelGen,Ranked>(getHead(t),*this,t,
+						   getHeight(t)-1),
+		    toFind);
+}
+
+template < class T, class Alloc, class LevelGen, bool Ranked >
+PSLIterator<T,Alloc,LevelGen,Ranked>
+PersistentSkipList<T,Alloc,LevelGen,Ranked>::find(
+  const T& toFind, int t, const PSLIterator<T,Alloc,LevelGen,Ranked>& hint) {
+  ListNode<T,Alloc,Ranked>* node;
+  int level;
+  if(! fingerSearch(toFind,t,hint,node,level))
+    return find(toFind,t);
+#ifdef PSL_SEARCH_PATH
   lastSearchPath.clear();
 #endif
-  PSLIterator<T> iter = PSLIterator<T>(getHead(t),*this,t,getHeight(t)-1);
-  PSLIterator<T> next = iter.getNext();
-  const PSLIterator<T> end = this->end(t);
+  return searchFrom(PSLIterator<T,Alloc,LevelGen,Ranked>(node,*this,t,level),
+		    toFind);
+}
+
+template < class T, class Alloc, class LevelGen, bool Ranked >
+template <class OutputIterator>
+OutputIterator PersistentSkipList<T,Alloc,LevelGen,Ranked>::findAcrossVersions(
+  const T& toFind, const vector< int >& times, OutputIterator out) {
+  int count = (int)times.size();
+  if(count == 0)
+    return out;
+  vector< TSA* > nexts(count);
+  vector< ListNode<T,Alloc,Ranked>* > found(count);
+  vector< SearchRun > runs;
+  // find the root of every time in order, loading the count first as
+  // getRoot does
+  int roots_published = atomicLoad(&root_count);
+  const VersionRoot* published = atomicLoad(&roots);
+  int root = 0;
+  for(int i = 0; i < count; ++i) {
+    assert(times[i] >= 0);
+    assert(i == 0 || times[i-1] <= times[i]);
+    // binary search the roots after the last one found
+    int end = roots_published-1;
+    while(root < end) {
+      int index = (root+end+1)/2;
+      if(published[index].time > times[i])
+	end = index-1;
+      else
+	root = index;
+    }
+    ListNode<T,Alloc,Ranked>* head = published[root].head;
+    if(! runs.empty() && runs.back().node == head) {
+      runs.back().last = i;
+    } else {
+      SearchRun run = { head, head->getHeight()-1, i, i, false };
+      runs.push_back(run);
+    }
+  }
+  while(! runs.empty()) {
+    SearchRun run = runs.back();
+    runs.pop_back();
+    ListNode<T,Alloc,Ranked>* node = run.node;
+    if(run.first == run.last) {
+      // a single time shares nothing, so finish it as find would
+      int t = times[run.first];
+      TSA* next = run.resolved ? nexts[run.first] : node->getNext(t);
+      for(int level = run.level; level >= 0; --level) {
+	while(*(node->getLink(next,level)) <= toFind) {
+	  node = node->getLink(next,level);
+	  next = node->getNext(t);
+	}
+      }
+      found[run.first] = node;
+      continue;
+    }
+    if(! run.resolved)
+      node->getNexts(&times[run.first],run.last-run.first+1,
+		     &nexts[run.first]);
+    // split the run where the next node at this level differs
+    int first = run.first;
+    while(first <= run.last) {
+      ListNode<T,Alloc,Ranked>* link = node->getLink(nexts[first],run.level);
+      int last = first;
+      // times sharing next pointers share the link without reading it
+      while(last < run.last &&
+	    (nexts[last+1] == nexts[last] ||
+	     node->getLink(nexts[last+1],run.level) == link))
+	++last;
+      if(*link <= toFind) {
+	// can go next
+	SearchRun right = { link, run.level, first, last, false };
+	runs.push_back(right);
+      } else if(run.level > 0) {
+	// can go down, with the same next pointers, and so can the
+	// times just before which went down from this node too
+	if(! runs.empty() && runs.back().node == node &&
+	   runs.back().level == run.level-1 && runs.back().last == first-1) {
+	  runs.back().last = last;
+	} else {
+	  SearchRun down = { node, run.level-1, first, last, true };
+	  runs.push_back(down);
+	}
+      } else {
+	for(int i = first; i <= last; ++i)
+	  found[i] = node;
+      }
+      first = last+1;
+    }
+  }
+  for(int i = 0; i < count; ++i) {
+    *out = PSLIterator<T,Alloc,LevelGen,Ranked>(found[i],*this,times[i]);
+    ++out;
+  }
+  return out;
+}
+
+template < class T, class Alloc, class LevelGen, bool Ranked >
+PSLIterator<T,Alloc,LevelGen,Ranked>
+PersistentSkipList<T,Alloc,LevelGen,Ranked>::searchFrom(
+  PSLIterator<T,Alloc,LevelGen,Ranked> iter, const T& toFind) {
+  PSLIterator<T,Alloc,LevelGen,Ranked> next = iter.getNext();
+  const PSLIterator<T,Alloc,LevelGen,Ranked> end = this->end(iter._time);
   while( iter.getSearchHeight() > 0 || next != end ) {
-#ifndef NDEBUG
-    lastSearchPath.push_back(*iter);
+#ifdef PSL_SEARCH_PATH
+    lastSearchPath.push_back(&*iter);
 #endif 
     // loop invariant: we have already determined the value of iter
     //                 precedes the data for which we are searching.
@@ -217,18 +746,196 @@ PSLIterator<T> PersistentSkipList<T>::find(const T& toFind, int t) {
   return iter;
 }
 
-template < class T >
-int PersistentSkipList<T>::getHeight(int t) {
+template < class T, class Alloc, class LevelGen, bool Ranked >
+bool PersistentSkipList<T,Alloc,LevelGen,Ranked>::fingerSearch(
+  const T& toFind, int t, const PSLIterator<T,Alloc,LevelGen,Ranked>& hint,
+  ListNode<T,Alloc,Ranked>*& node, int& level) {
+  int present = getPresent();
+  node = hint._node;
+  level = 0;
+  // a hint from another time may not be in this version, and one at
+  // present may have been copied or removed since
+  if(&hint._psl != this || hint._time != t ||
+     (t == present && node->isRetired()))
+    return false;
+  if(*node > toFind) {
+    // only the present keeps the predecessors of each node
+    if(t != present)
+      return false;
+    // go back, moving up whenever possible, until at or before the datum
+    while(*node > toFind) {
+      node = node->getIncoming(level);
+      if(*node > toFind && level+1 < node->getHeight())
+	++level;
+    }
+    return true;
+  }
+  // go forward, moving up whenever possible, until the next node is
+  // after the datum
+  ListNode<T,Alloc,Ranked>* next = node->getLink(node->getNext(t),level);
+  while(*next <= toFind) {
+    if(level+1 < node->getHeight())
+      ++level;
+    else
+      node = next;
+    next = node->getLink(node->getNext(t),level);
+  }
+  return true;
+}
+
+template < class T, class Alloc, class LevelGen, bool Ranked >
+ListNode<T,Alloc,Ranked>*
+PersistentSkipList<T,Alloc,LevelGen,Ranked>::findBefore(const T& toFind,
+							int t) {
+  ListNode<T,Alloc,Ranked>* node = getHead(t);
+  TSA* next = node->getNext(t);
+  for(int level = node->getHeight()-1; level >= 0; --level) {
+    // every level of a node shares one array at time t
+    while(*(node->getLink(next,level)) < toFind) {
+      node = node->getLink(next,level);
+      next = node->getNext(t);
+    }
+  }
+  return node;
+}
+
+template < class T, class Alloc, class LevelGen, bool Ranked >
+PSLIterator<T,Alloc,LevelGen,Ranked>
+PersistentSkipList<T,Alloc,LevelGen,Ranked>::lowerBound(const T& toFind,
+							int t) {
+  ListNode<T,Alloc,Ranked>* node = findBefore(toFind,t);
+  node = node->getLink(node->getNext(t),0);
+  return PSLIterator<T,Alloc,LevelGen,Ranked>(node,*this,t);
+}
+
+template < class T, class Alloc, class LevelGen, bool Ranked >
+template <class OutputIterator>
+OutputIterator
+PersistentSkipList<T,Alloc,LevelGen,Ranked>::range(const T& lo, const T& hi,
+						   int t, OutputIterator out) {
+  ListNode<T,Alloc,Ranked>* node = findBefore(lo,t);
+  node = node->getLink(node->getNext(t),0);
+  // the tail is after any datum, so ends the walk
+  while(*node <= hi) {
+    *out = node->getData();
+    ++out;
+    node = node->getLink(node->getNext(t),0);
+  }
+  return out;
+}
+
+template < class T, class Alloc, class LevelGen, bool Ranked >
+int
+PersistentSkipList<T,Alloc,LevelGen,Ranked>::countRange(const T& lo,
+							const T& hi, int t) {
+  int count = 0;
+  ListNode<T,Alloc,Ranked>* node = findBefore(lo,t);
+  node = node->getLink(node->getNext(t),0);
+  while(*node <= hi) {
+    ++count;
+    node = node->getLink(node->getNext(t),0);
+  }
+  return count;
+}
+
+template < class T, class Alloc, class LevelGen, bool Ranked >
+template <class InsertFunction, class RemoveFunction>
+int PersistentSkipList<T,Alloc,LevelGen,Ranked>::diff(
+  int t1, int t2, InsertFunction onInsert, RemoveFunction onRemove) {
+  assert(t1 <= t2);
+  // load the count first, since a replaced array holds as many changes
+  int count = atomicLoad(&change_count);
+  const Change* published = atomicLoad(&changes);
+  // binary search for the first change after t1
+  int begin = 0;
+  int end = count;
+  while(begin < end) {
+    int middle = begin + (end-begin)/2;
+    if(published[middle].time <= t1)
+      begin = middle+1;
+    else
+      end = middle;
+  }
+  // order the changes by datum, keeping those to each datum in time
+  // order
+  vector< const Change* > changed;
+  for(int i = begin; i < count && published[i].time <= t2; ++i)
+    changed.push_back(&published[i]);
+  stable_sort(changed.begin(),changed.end(),changeLess);
+  int reported = 0;
+  size_t first = 0;
+  while(first < changed.size()) {
+    size_t last = first;
+    while(last+1 < changed.size() && ! changeLess(changed[first],
+						   changed[last+1]))
+      ++last;
+    // a datum first inserted was missing at t1, and one last inserted
+    // is there at t2
+    const T& data = changed[first]->node->getData();
+    if(changed[first]->inserted && changed[last]->inserted) {
+      onInsert(data);
+      ++reported;
+    } else if(! changed[first]->inserted && ! changed[last]->inserted) {
+      onRemove(data);
+      ++reported;
+    }
+    first = last+1;
+  }
+  return reported;
+}
+
+template < class T, class Alloc, class LevelGen, bool Ranked >
+int PersistentSkipList<T,Alloc,LevelGen,Ranked>::rank(const T& datum, int t) {
+  static_assert(Ranked, "rank needs a Ranked list");
+  int rank = 0;
+  ListNode<T,Alloc,Ranked>* node = getHead(t);
+  TSA* next = node->getNext(t);
+  for(int level = node->getHeight()-1; level >= 0; --level) {
+    while(*(node->getLink(next,level)) < datum) {
+      rank += node->getWidth(next,level);
+      node = node->getLink(next,level);
+      next = node->getNext(t);
+    }
+  }
+  return rank;
+}
+
+template < class T, class Alloc, class LevelGen, bool Ranked >
+PSLIterator<T,Alloc,LevelGen,Ranked>
+PersistentSkipList<T,Alloc,LevelGen,Ranked>::select(int k, int t) {
+  static_assert(Ranked, "select needs a Ranked list");
+  if(k < 0)
+    return end(t);
+  // the element is at position k+1, counting the head as 0
+  int position = 0;
+  ListNode<T,Alloc,Ranked>* node = getHead(t);
+  TSA* next = node->getNext(t);
+  for(int level = node->getHeight()-1; level >= 0; --level) {
+    while(position + node->getWidth(next,level) <= k+1) {
+      position += node->getWidth(next,level);
+      node = node->getLink(next,level);
+      // the tail has no next pointers, and is past the last element
+      if(position == k+1 || node->isPositiveInfinity())
+	return PSLIterator<T,Alloc,LevelGen,Ranked>(node,*this,t);
+      next = node->getNext(t);
+    }
+  }
+  // past the last element
+  return end(t);
+}
+
+template < class T, class Alloc, class LevelGen, bool Ranked >
+int PersistentSkipList<T,Alloc,LevelGen,Ranked>::getHeight(int t) {
   return (getHead(t))->getHeight();
 }
 
-template < class T >
-bool PersistentSkipList<T>::empty(void) {
+template < class T, class Alloc, class LevelGen, bool Ranked >
+bool PersistentSkipList<T,Alloc,LevelGen,Ranked>::empty(void) {
   return empty(getPresent());
 }
 
-template < class T >
-bool PersistentSkipList<T>::empty(int t) {
+template < class T, class Alloc, class LevelGen, bool Ranked >
+bool PersistentSkipList<T,Alloc,LevelGen,Ranked>::empty(int t) {
   return begin(t) == end(t);
 }
 
@@ -236,62 +943,529 @@ bool PersistentSkipList<T>::empty(int t) {
 // INSERT METHOD                                                           //
 /////////////////////////////////////////////////////////////////////////////
 
-template <class T>
-const PersistentSkipList<T>& PersistentSkipList<T>::operator+=(const T& data) {
+template <class T, class Alloc, class LevelGen, bool Ranked>
+const PersistentSkipList<T,Alloc,LevelGen,Ranked>&
+PersistentSkipList<T,Alloc,LevelGen,Ranked>::operator+=(const T& data) {
   if(insert(data) != 0) // error
     throw "Unable to insert data!";
   return this;
 }
 
-template <class T>
-int PersistentSkipList<T>::insert(const T& data) {
+template <class T, class Alloc, class LevelGen, bool Ranked>
+bool PersistentSkipList<T,Alloc,LevelGen,Ranked>::placeInsertFingers(
+  const T& data) {
+  int present = getPresent();
+  int height = getHeight(present);
+  // search from the head at every level, which lands next to the datum
+  // if it exists already
+  insert_fingers.assign(height,getHead(present));
+  insert_ranks.assign(height,0);
+  return placeFingers(data,insert_fingers,insert_ranks);
+}
+
+template <class T, class Alloc, class LevelGen, bool Ranked>
+int
+PersistentSkipList<T,Alloc,LevelGen,Ranked>::linkInserted(
+  ListNode<T,Alloc,Ranked>* new_ln) {
+  int present = getPresent();
+  int height = getHeight(present);
+  // Taller than old head
+  if(new_ln->getHeight() > height) {
+    buildHeadAndTail(new_ln->getHeight(),&insert_fingers);
+    insert_fingers.resize(new_ln->getHeight(),getHead(present));
+    insert_ranks.resize(new_ln->getHeight(),0);
+  }
+  linkNode(new_ln,insert_fingers,insert_ranks);
+  logChange(new_ln,true);
+  if constexpr(JOURNALED)
+    if(journal != NULL)
+      journal->logInsert(new_ln->getData());
+  // success
+  return 0;
+}
+
+template <class T, class Alloc, class LevelGen, bool Ranked>
+int PersistentSkipList<T,Alloc,LevelGen,Ranked>::insert(const T& data) {
   assert(this != NULL);
-  // check if data exists already
-  if(data_set.count(data)>0)
+  if(! placeInsertFingers(data))
     throw "Tried to insert non-unique datum";
-  int present = getPresent();
   // otherwise, create node
-  SmartPointer<ListNode<T> > new_ln(new ListNode<T>(data));
+  return linkInserted(createNode(data));
+}
+
+template <class T, class Alloc, class LevelGen, bool Ranked>
+int PersistentSkipList<T,Alloc,LevelGen,Ranked>::insert(T&& data) {
+  assert(this != NULL);
+  if(! placeInsertFingers(data))
+    throw "Tried to insert non-unique datum";
+  return linkInserted(emplaceNode(levels.pickHeight(),
+				  std::move(data)));
+}
+
+template <class T, class Alloc, class LevelGen, bool Ranked>
+template <class... Args>
+int PersistentSkipList<T,Alloc,LevelGen,Ranked>::emplace(Args&&... args) {
+  assert(this != NULL);
+  // the datum to search for only exists once built in its node
+  ListNode<T,Alloc,Ranked>* new_ln =
+    emplaceNode(levels.pickHeight(),std::forward<Args>(args)...);
+  if(! placeInsertFingers(new_ln->getData())) {
+    nodes.pop_back();
+    destroyNode(new_ln);
+    throw "Tried to insert non-unique datum";
+  }
+  return linkInserted(new_ln);
+}
+
+template <class T, class Alloc, class LevelGen, bool Ranked>
+PSLIterator<T,Alloc,LevelGen,Ranked>
+PersistentSkipList<T,Alloc,LevelGen,Ranked>::insert(
+  const T& data, const PSLIterator<T,Alloc,LevelGen,Ranked>& hint) {
+  assert(this != NULL);
+  int present = getPresent();
+  ListNode<T,Alloc,Ranked>* start;
+  int level;
+  if(! fingerSearch(data,present,hint,start,level)) {
+    start = getHead(present);
+    level = getHeight(present)-1;
+  }
+  // search down from the start, counting ranks from it
+  insert_fingers.assign(level+1,start);
+  insert_ranks.assign(level+1,0);
+  if(! placeFingers(data,insert_fingers,insert_ranks))
+    throw "Tried to insert non-unique datum";
+  ListNode<T,Alloc,Ranked>* new_ln = createNode(data);
   int height = new_ln->getHeight();
-  // add node to list
-  int start = height-1;
   // Taller than old head
-  if(height > getHeight(getPresent()))
+  if(height > getHeight(present))
+    buildHeadAndTail(height,&insert_fingers);
+  // above the start the fingers are the nearest taller nodes before
+  // it, which only need to reach the height of the new node
+  ListNode<T,Alloc,Ranked>* above = insert_fingers[level];
+  int above_rank = insert_ranks[level];
+  for(int l = level+1; l < height; ++l) {
+    while(above->getHeight() <= l) {
+      ListNode<T,Alloc,Ranked>* incoming =
+	above->getIncoming(above->getHeight()-1);
+      if constexpr(Ranked)
+	above_rank -= incoming->getWidth(incoming->getNext(present),
+					 above->getHeight()-1);
+      above = incoming;
+    }
+    insert_fingers.push_back(above);
+    insert_ranks.push_back(above_rank);
+  }
+  linkNode(new_ln,insert_fingers,insert_ranks);
+  logChange(new_ln,true);
+  if constexpr(JOURNALED)
+    if(journal != NULL)
+      journal->logInsert(data);
+  return PSLIterator<T,Alloc,LevelGen,Ranked>(new_ln,*this,present);
+}
+
+template <class T, class Alloc, class LevelGen, bool Ranked>
+template <class InputIterator>
+int PersistentSkipList<T,Alloc,LevelGen,Ranked>::insertBatch(
+  InputIterator first, InputIterator last) {
+  assert(this != NULL);
+  typedef typename iterator_traits<InputIterator>::iterator_category
+    category;
+  // sort pointers to the data, copying them only if the range can be
+  // read just once
+  vector< T > copied;
+  vector< const T* > batch;
+  if constexpr(is_base_of<forward_iterator_tag,category>::value) {
+    for(; first != last; ++first)
+      batch.push_back(&*first);
+  } else {
+    copied.assign(first,last);
+    for(size_t i = 0; i < copied.size(); ++i)
+      batch.push_back(&copied[i]);
+  }
+  sort(batch.begin(),batch.end(),dataLess);
+  for(size_t i = 1; i < batch.size(); ++i)
+    if(!(*batch[i-1] < *batch[i]))
+      throw "Tried to insert non-unique datum";
+  int present = getPresent();
+  // pick every height first, so the head and tail grow at most once
+  vector< int > heights(batch.size());
+  int height = getHeight(present);
+  for(size_t i = 0; i < batch.size(); ++i) {
+    heights[i] = levels.pickHeight();
+    if(heights[i] > height)
+      height = heights[i];
+  }
+  if(height > getHeight(present))
     buildHeadAndTail(height);
-  // Add new node to list
-  SmartPointer<ListNode<T> > old_ln = getHead(present);
-  TSA* new_node_next = new TSA(present,height);
-  while(start >= 0) {
-    SmartPointer<ListNode<T> > next_ln =
-      old_ln->getNext(present)->getElement(start);
-    // find the elements between which we should insert the new node
-    while(*new_ln > *next_ln) {
-      old_ln = next_ln;
-      next_ln = old_ln->getNext(present)->getElement(start);
+  // the fingers only move forward, since the batch is sorted, so each
+  // datum is checked against the list where it is linked
+  insert_fingers.assign(height,getHead(present));
+  insert_ranks.assign(height,0);
+  vector< ListNode<T,Alloc,Ranked>* > new_nodes;
+  for(size_t i = 0; i < batch.size(); ++i) {
+    if(! placeFingers(*batch[i],insert_fingers,insert_ranks)) {
+      // take out the nodes linked so far, which no version has seen
+      while(! new_nodes.empty()) {
+	unlinkNode(new_nodes.back());
+	new_nodes.pop_back();
+      }
+      throw "Tried to insert non-unique datum";
     }
-    TSA* old_ln_next = new TSA(present,
-			       old_ln->getHeight(),
-			       *(old_ln->getNext(present)));
-    while(*new_ln < *next_ln) {
-      new_node_next->setElement(start,next_ln);
-      // point the old node to the new node
-      old_ln_next->setElement(start,new_ln);
-      // move to the next height
-      --start;
-      if(start < 0)
-	break;
-      next_ln = old_ln_next->getElement(start);
+    new_nodes.push_back(createNode(*batch[i],heights[i]));
+    linkNode(new_nodes.back(),insert_fingers,insert_ranks);
+  }
+  for(size_t i = 0; i < new_nodes.size(); ++i) {
+    logChange(new_nodes[i],true);
+    if constexpr(JOURNALED)
+      if(journal != NULL)
+	journal->logInsert(new_nodes[i]->getData());
+  }
+  // success
+  return 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// SNAPSHOT METHOD                                                         //
+/////////////////////////////////////////////////////////////////////////////
+
+template <class T, class Alloc, class LevelGen, bool Ranked>
+int PersistentSkipList<T,Alloc,LevelGen,Ranked>::writeSnapshot(
+  const char* path) {
+  assert(this != NULL);
+  static_assert(std::is_trivially_copyable<T>::value,
+		"A snapshot needs trivially copyable data");
+  // lay the nodes out one after another, after the header and roots
+  map< ListNode<T,Alloc,Ranked>*, uint64_t > offsets;
+  uint64_t offset = sizeof(SnapshotHeader) + root_count * sizeof(SnapshotRoot);
+  for(size_t i = 0; i < nodes.size(); ++i) {
+    offsets[nodes[i]] = offset;
+    offset += PSLSnapshot<T>::nodeSize(nodes[i]->getHeight(),
+				       nodes[i]->numberOfNextChangeIndices());
+  }
+  ofstream out(path,ios::out | ios::binary | ios::trunc);
+  if(! out)
+    throw "Unable to open snapshot";
+  SnapshotHeader header;
+  memset(&header,0,sizeof(header));
+  strncpy(header.magic,PSLSnapshot<T>::magic(),sizeof(header.magic));
+  header.format = PSLSnapshot<T>::FORMAT;
+  header.data_size = sizeof(T);
+  header.present = present;
+  header.root_count = root_count;
+  header.roots = sizeof(SnapshotHeader);
+  header.node_count = nodes.size();
+  out.write((const char*)&header,sizeof(header));
+  for(int i = 0; i < root_count; ++i) {
+    SnapshotRoot root;
+    memset(&root,0,sizeof(root));
+    root.time = roots[i].time;
+    root.head = offsets[roots[i].head];
+    root.tail = offsets[roots[i].tail];
+    out.write((const char*)&root,sizeof(root));
+  }
+  // each node is written to a buffer of its record size, zero filling
+  // the padding
+  vector< char > record;
+  for(size_t i = 0; i < nodes.size(); ++i) {
+    ListNode<T,Alloc,Ranked>* node = nodes[i];
+    int height = node->getHeight();
+    int next_count = node->numberOfNextChangeIndices();
+    record.assign(PSLSnapshot<T>::nodeSize(height,next_count),0);
+    SnapshotNode* node_record = (SnapshotNode*)&record[0];
+    node_record->height = height;
+    node_record->next_count = next_count;
+    if(node->isPositiveInfinity())
+      node_record->flags = PSLSnapshot<T>::POSITIVE_INFINITY;
+    if(node->isNegativeInfinity())
+      node_record->flags = PSLSnapshot<T>::NEGATIVE_INFINITY;
+    memcpy(node_record + 1,&node->getData(),sizeof(T));
+    char* log = &record[0] + PSLSnapshot<T>::nodeSize(height,0);
+    for(int j = 0; j < next_count; ++j) {
+      TSA* next = node->getNextAtIndex(j);
+      SnapshotNext* next_record =
+	(SnapshotNext*)(log + j * PSLSnapshot<T>::nextSize(height));
+      next_record->time = next->getTime();
+      uint64_t* links = (uint64_t*)(next_record + 1);
+      int32_t* widths = (int32_t*)(links + height);
+      for(int level = 0; level < height; ++level) {
+	links[level] = offsets[node->getLink(next,level)];
+	if constexpr(Ranked)
+	  widths[level] = node->getWidth(next,level);
+      }
+    }
+    out.write(&record[0],record.size());
+  }
+  if(! out)
+    throw "Unable to write snapshot";
+  // success
+  return 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// JOURNAL METHODS                                                         //
+/////////////////////////////////////////////////////////////////////////////
+
+template <class T, class Alloc, class LevelGen, bool Ranked>
+void PersistentSkipList<T,Alloc,LevelGen,Ranked>::setJournal(
+  PSLJournal<T>* j) {
+  assert(this != NULL);
+  static_assert(JOURNALED, "A journal needs trivially copyable data");
+  journal = j;
+}
+
+template <class T, class Alloc, class LevelGen, bool Ranked>
+int PersistentSkipList<T,Alloc,LevelGen,Ranked>::replayJournal(
+  const char* path) {
+  assert(this != NULL);
+  static_assert(JOURNALED, "A journal needs trivially copyable data");
+  JournalReader<T> reader(path);
+  // the changes replayed are already in the journal
+  PSLJournal<T>* attached = journal;
+  journal = NULL;
+  // the inserts into the present, which are applied together when it
+  // ends.  Removes of anything else are applied at once, since the
+  // order of changes within a version can't be seen.
+  set< T > inserts;
+  // true if the present was emptied first
+  bool cleared = false;
+  int count = 0;
+  char op;
+  T datum;
+  try {
+    while(reader.next(op,datum)) {
+      ++count;
+      if(op == PSLJournal<T>::INSERT) {
+	inserts.insert(datum);
+      } else if(op == PSLJournal<T>::REMOVE) {
+	if(inserts.erase(datum) > 0)
+	  continue;
+	PSLIterator<T,Alloc,LevelGen,Ranked> found =
+	  lowerBound(datum,getPresent());
+	if(cleared || found == end(getPresent()) || datum < *found)
+	  throw "Journal removes a missing datum";
+	found.remove();
+      } else if(op == PSLJournal<T>::CLEAR) {
+	inserts.clear();
+	cleared = true;
+      } else {
+	replayVersion(inserts,cleared);
+	incTime();
+      }
+    }
+    replayVersion(inserts,cleared);
+  } catch(...) {
+    journal = attached;
+    throw;
+  }
+  journal = attached;
+  return count;
+}
+
+template <class T, class Alloc, class LevelGen, bool Ranked>
+void PersistentSkipList<T,Alloc,LevelGen,Ranked>::replayVersion(
+  set< T >& inserts, bool& cleared) {
+  int present = getPresent();
+  // an empty present is built faster and better balanced by a bulk
+  // load, which also empties a cleared present
+  if(cleared ? !(inserts.empty() && empty(present)) :
+     !inserts.empty() && empty(present))
+    bulkLoad(inserts.begin(),inserts.end());
+  else if(! inserts.empty())
+    insertBatch(inserts.begin(),inserts.end());
+  inserts.clear();
+  cleared = false;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// GARBAGE COLLECTION METHOD                                               //
+/////////////////////////////////////////////////////////////////////////////
+
+template <class T, class Alloc, class LevelGen, bool Ranked>
+size_t PersistentSkipList<T,Alloc,LevelGen,Ranked>::dropVersionsBefore(int t) {
+  assert(this != NULL);
+  assert(t >= 0);
+  assert(t <= getPresent());
+  size_t freed = 0;
+  // keep the root in effect at t, and every later one
+  int first = &getRoot(t) - roots;
+  for(int i = first; i < root_count; ++i)
+    roots[i-first] = roots[i];
+  root_count -= first;
+  // with no readers, the replaced roots arrays can go too
+  while(! retired_roots.empty()) {
+    delete[] retired_roots.back();
+    retired_roots.pop_back();
+  }
+  for(size_t i = 0; i < nodes.size(); ++i)
+    freed += nodes[i]->dropNextBefore(t);
+  // mark every node reachable from the roots through the next pointers
+  // left, which includes every node of the versions kept
+  set< ListNode<T,Alloc,Ranked>* > reached;
+  vector< ListNode<T,Alloc,Ranked>* > unvisited;
+  for(int i = 0; i < root_count; ++i) {
+    unvisited.push_back(roots[i].head);
+    unvisited.push_back(roots[i].tail);
+  }
+  while(! unvisited.empty()) {
+    ListNode<T,Alloc,Ranked>* node = unvisited.back();
+    unvisited.pop_back();
+    if(! reached.insert(node).second)
+      continue;
+    for(int i = 0; i < node->numberOfNextChangeIndices(); ++i) {
+      TSA* next = node->getNextAtIndex(i);
+      for(int level = 0; level < node->getHeight(); ++level)
+	unvisited.push_back(node->getLink(next,level));
+    }
+  }
+  // diff reads only the changes after its earlier time, which is at
+  // least t, and the data of their nodes.  A node removed in the
+  // version it was inserted or copied is in no version, so is kept
+  // for its changes, though its links are never followed again.
+  int kept_changes = 0;
+  for(int i = 0; i < change_count; ++i) {
+    if(changes[i].time <= t)
+      continue;
+    changes[kept_changes++] = changes[i];
+    reached.insert(const_cast< ListNode<T,Alloc,Ranked>* >(changes[i].node));
+  }
+  change_count = kept_changes;
+  while(! retired_changes.empty()) {
+    delete[] retired_changes.back();
+    retired_changes.pop_back();
+  }
+  // sweep the rest
+  size_t kept = 0;
+  for(size_t i = 0; i < nodes.size(); ++i) {
+    if(reached.count(nodes[i]) > 0) {
+      nodes[kept++] = nodes[i];
+    } else {
+      freed += nodes[i]->getBytes();
+      destroyNode(nodes[i]);
+    }
+  }
+  nodes.resize(kept);
+  return freed;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// BULK LOAD METHOD                                                        //
+/////////////////////////////////////////////////////////////////////////////
+
+template <class T, class Alloc, class LevelGen, bool Ranked>
+template <class InputIterator>
+int PersistentSkipList<T,Alloc,LevelGen,Ranked>::bulkLoad(InputIterator first,
+							  InputIterator last) {
+  assert(this != NULL);
+  int present = getPresent();
+  // the last node reaching each level, whose next pointer at that
+  // level is not yet known, along with its next pointers
+  vector< ListNode<T,Alloc,Ranked>* > last_nodes;
+  vector< TSA* > last_next;
+  vector< int > last_ranks;
+  // the first node reaching each level, to which the head points
+  vector< ListNode<T,Alloc,Ranked>* > first_nodes;
+  int count = 0;
+  // the nodes from here on are new, so are destroyed if anything throws
+  size_t first_new = nodes.size();
+  ListNode<T,Alloc,Ranked>* new_head;
+  ListNode<T,Alloc,Ranked>* new_tail;
+  TSA* head_next;
+  int height;
+  try {
+    for(; first != last; ++first) {
+      if(count > 0 && !(*(last_nodes[0]) < *first))
+	throw "Tried to bulk load unsorted or non-unique data";
+      ++count;
+      // one more than the number of trailing zeros in the position
+      // balances the heights perfectly
+      int node_height = 1;
+      while((count & (1 << (node_height-1))) == 0)
+	++node_height;
+      ListNode<T,Alloc,Ranked>* node = createNode(*first,node_height);
+      TSA* node_next = node->createNext(present);
+      for(int level = 0; level < node_height; ++level) {
+	if(level == (int)last_nodes.size()) {
+	  // the tallest node so far
+	  first_nodes.push_back(node);
+	  last_nodes.push_back(node);
+	  last_next.push_back(node_next);
+	  last_ranks.push_back(count);
+	  continue;
+	}
+	last_nodes[level]->setLink(last_next[level],level,node);
+	if constexpr(Ranked)
+	  last_nodes[level]->setWidth(last_next[level],level,
+				      count-last_ranks[level]);
+	// the top level of a node is the last to be set
+	if(level == last_nodes[level]->getHeight()-1)
+	  last_nodes[level]->addNext(last_next[level]);
+	last_nodes[level] = node;
+	last_next[level] = node_next;
+	last_ranks[level] = count;
+      }
+    }
+    // point the head to the first nodes, and the last nodes to the tail
+    height = last_nodes.empty() ? 1 : (int)last_nodes.size();
+    new_head = createNode(height,false);
+    new_tail = createNode(height,true);
+    head_next = new_head->createNext(present);
+  } catch(...) {
+    // nothing new is linked from the present yet, and the unfinished
+    // next pointers were never added to their nodes
+    for(int level = 0; level < (int)last_nodes.size(); ++level)
+      if(level == 0 || last_nodes[level] != last_nodes[level-1])
+	last_nodes[level]->destroyNext(last_next[level]);
+    while(nodes.size() > first_new) {
+      destroyNode(nodes.back());
+      nodes.pop_back();
+    }
+    throw;
+  }
+  for(int level = 0; level < height; ++level) {
+    if(level < (int)first_nodes.size()) {
+      new_head->setLink(head_next,level,first_nodes[level]);
+      // the first node reaching a level is at the position 2^level
+      if constexpr(Ranked)
+	new_head->setWidth(head_next,level,1 << level);
+    } else {
+      new_head->setLink(head_next,level,new_tail);
+      if constexpr(Ranked)
+	new_head->setWidth(head_next,level,count+1);
     }
-    old_ln->addNext(old_ln_next);
-    // move to next search height
-    if(start < 0)
-      break;
-    // get node at new height
-    old_ln = next_ln;
-  }
-  new_ln->addNext(new_node_next);
-  // prevent duplicates by registering this datum
-  data_set.insert(data);
+  }
+  for(int level = 0; level < (int)last_nodes.size(); ++level) {
+    last_nodes[level]->setLink(last_next[level],level,new_tail);
+    if constexpr(Ranked)
+      last_nodes[level]->setWidth(last_next[level],level,
+				  count+1-last_ranks[level]);
+    if(level == last_nodes[level]->getHeight()-1)
+      last_nodes[level]->addNext(last_next[level]);
+  }
+  new_head->addNext(head_next);
+  // every node of the replaced version leaves the present
+  ListNode<T,Alloc,Ranked>* old = getHead(present);
+  old->retire();
+  old = old->getLink(old->getNext(present),0);
+  while(! old->isPositiveInfinity()) {
+    old->retire();
+    logChange(old,false);
+    old = old->getLink(old->getNext(present),0);
+  }
+  old->retire();
+  addHead(new_head);
+  addTail(new_tail);
+  // the range may only be read once, so is recorded from the list
+  if constexpr(JOURNALED)
+    if(journal != NULL)
+      journal->logClear();
+  ListNode<T,Alloc,Ranked>* node = new_head->getLink(head_next,0);
+  while(! node->isPositiveInfinity()) {
+    logChange(node,true);
+    if constexpr(JOURNALED)
+      if(journal != NULL)
+	journal->logInsert(node->getData());
+    node = node->getLink(node->getNext(present),0);
+  }
   // success
   return 0;
 }
@@ -10,7 +10,21 @@
 //                                                                           //
 // PURPOSE: Implements a persistent skip list data structure.                //
 //                                                                           //
-// NOTES:   None.                                                            //
+// NOTES:   The Alloc template parameter is the allocator policy from which  //
+//          nodes and next pointers are allocated, see Allocator.hpp.  The   //
+//          LevelGen template parameter is the level generator policy which  //
+//          picks the height of each inserted node, see LevelGenerator.hpp.  //
+//          A Ranked list keeps the width of every link, for rank and        //
+//          select, at the cost of changing the links over each insert or    //
+//          remove.  Other lists can't call rank or select.                  //
+//                                                                           //
+//          One writer thread may insert, remove and increment the time      //
+//          while any number of reader threads search, iterate and draw the  //
+//          list at times before getPresent().  Versions before the present  //
+//          are never changed, so readers take no locks and never see a      //
+//          partial change.  Readers must not use the present.  The          //
+//          debugging search path is kept per thread, so readers don't       //
+//          share it.                                                        //
 //                                                                           //
 ///////////////////////////////////////////////////////////////////////////////
 //                                                                           //
@@ -26,27 +40,42 @@
 #define PERSISTENTSKIPLIST_HPP
 
 // Standard libraries
-#include <set>
+#include <vector>
 #include <map>
+#include <set>
+#include <fstream>
+#include <algorithm>
+#include <cstring>
 #include <iostream>
 #include <cassert>
 #include <cstddef>
+#include <utility>
+#include <type_traits>
 
 // My libraries
 #include "TimeStampedArray.hpp"
-#include "lib/SmartPointer/SmartPointer.hpp"
+#include "Allocator.hpp"
+#include "Atomic.hpp"
+#include "LevelGenerator.hpp"
 #include "ListNode.hpp"
 #include "PSLIterator.hpp"
+#include "PSLSnapshot.hpp"
+#include "PSLJournal.hpp"
 
 using namespace std;
 using namespace timestamped_array;
-using namespace smart_ptr;
+
+// record the path of the last search in debug builds
+#if !defined(NDEBUG) && !defined(PSL_NO_SEARCH_PATH)
+#define PSL_SEARCH_PATH
+#endif
 
 namespace persistent_skip_list {
 
-  template < class T >
+  template < class T, class Alloc = HeapAllocator,
+	     class LevelGen = GeometricLevels, bool Ranked = false >
   class PersistentSkipList {
-    friend class PSLIterator<T>;
+    friend class PSLIterator<T,Alloc,LevelGen,Ranked>;
   public:
     ///////////////////////////////////////////////////////////////////////////
     //                                                                       //
@@ -57,13 +86,18 @@ namespace persistent_skip_list {
     // SECURITY:      public                                                 //
     //                                                                       //
     // PARAMETERS                                                            //
-    //   Type/Name:   Void.                                                  //
-    //   Description: None.                                                  //
+    //   Type/Name:   int/nodeSize                                           //
+    //   Description: The number of next pointer changes a node stores       //
+    //                before it is copied.                                   //
+    //                                                                       //
+    //   Type/Name:   const LevelGen&/levels                                 //
+    //   Description: The level generator to copy, such as one seeded for a  //
+    //                reproducible run.                                      //
     //                                                                       //
     // NOTES:         None.                                                  //
     //                                                                       //
     ///////////////////////////////////////////////////////////////////////////
-    PersistentSkipList(int nodeSize=3);
+    PersistentSkipList(int nodeSize=3, const LevelGen& levels=LevelGen());
 
     ///////////////////////////////////////////////////////////////////////////
     //                                                                       //
@@ -100,7 +134,8 @@ namespace persistent_skip_list {
     //   Type/Name:   int                                                    //
     //   Description: The latest time index of the skip list.                //
     //                                                                       //
-    // NOTES:         None.                                                  //
+    // NOTES:         Safe to call from reader threads.  Every version       //
+    //                before the returned time is complete.                  //
     //                                                                       //
     ///////////////////////////////////////////////////////////////////////////
     int getPresent(void) const;
@@ -121,11 +156,11 @@ namespace persistent_skip_list {
     //   Type/Name:   Void.                                                  //
     //   Description: None.                                                  //
     //                                                                       //
-    // NOTES:         None.                                                  //
+    // NOTES:         Publishes the version at the old present to readers.   //
     //                                                                       //
     ///////////////////////////////////////////////////////////////////////////
     void incTime(void);
-    PersistentSkipList<T>& operator++();
+    PersistentSkipList<T,Alloc,LevelGen,Ranked>& operator++();
 
     ///////////////////////////////////////////////////////////////////////////
     //                                                                       //
@@ -189,7 +224,7 @@ namespace persistent_skip_list {
     // NOTES:         None.                                                  //
     //                                                                       //
     ///////////////////////////////////////////////////////////////////////////
-    PSLIterator<T> begin(int t, int h = 0);
+    PSLIterator<T,Alloc,LevelGen,Ranked> begin(int t, int h = 0);
 
     ///////////////////////////////////////////////////////////////////////////
     //                                                                       //
@@ -213,9 +248,259 @@ namespace persistent_skip_list {
     // NOTES:         None.                                                  //
     //                                                                       //
     ///////////////////////////////////////////////////////////////////////////
-    PSLIterator<T> end(int t);
+    PSLIterator<T,Alloc,LevelGen,Ranked> end(int t);
+
+    PSLIterator<T,Alloc,LevelGen,Ranked> find(const T& toFind, int t);
+
+    ///////////////////////////////////////////////////////////////////////////
+    //                                                                       //
+    // FUNCTION NAME: find                                                   //
+    //                                                                       //
+    // PURPOSE:       Finds the last element at or before a datum at time    //
+    //                t, searching outward from a hint.                      //
+    //                                                                       //
+    // SECURITY:      public                                                 //
+    //                                                                       //
+    // PARAMETERS                                                            //
+    //   Type/Name:   const T&/toFind                                        //
+    //   Description: The datum to find.                                     //
+    //                                                                       //
+    //   Type/Name:   int/t                                                  //
+    //   Description: The time at which to find it.                          //
+    //                                                                       //
+    //   Type/Name:   const PSLIterator<T>&/hint                             //
+    //   Description: An iterator from this list at time t near the datum.   //
+    //                                                                       //
+    // RETURN:                                                               //
+    //   Type/Name:   PSLIterator<T>                                         //
+    //   Description: The same iterator as find without a hint.              //
+    //                                                                       //
+    // NOTES:         Takes time logarithmic in the distance from the hint   //
+    //                rather than in the size of the list.  Searching back   //
+    //                from the hint is only possible at present; before it,  //
+    //                and for a hint from another time or since copied or    //
+    //                removed, this searches from the head.                  //
+    //                                                                       //
+    ///////////////////////////////////////////////////////////////////////////
+    PSLIterator<T,Alloc,LevelGen,Ranked> find(
+      const T& toFind, int t,
+      const PSLIterator<T,Alloc,LevelGen,Ranked>& hint);
+
+    ///////////////////////////////////////////////////////////////////////////
+    //                                                                       //
+    // FUNCTION NAME: findAcrossVersions                                     //
+    //                                                                       //
+    // PURPOSE:       Searches for a datum at many times in one descent,     //
+    //                writing what find would return at each time.           //
+    //                                                                       //
+    // SECURITY:      public                                                 //
+    //                                                                       //
+    // PARAMETERS                                                            //
+    //   Type/Name:   const T&/toFind                                        //
+    //   Description: The datum to find.                                     //
+    //                                                                       //
+    //   Type/Name:   const vector<int>&/times                               //
+    //   Description: The times at which to search, sorted.                  //
+    //                                                                       //
+    //   Type/Name:   OutputIterator/out                                     //
+    //   Description: Where to write a PSLIterator for each time, in order.  //
+    //                                                                       //
+    // RETURN:                                                               //
+    //   Type/Name:   OutputIterator                                         //
+    //   Description: The output iterator past the last iterator written.    //
+    //                                                                       //
+    // NOTES:         Times which reach the same node at the same level are  //
+    //                searched together, resolving the node's change log     //
+    //                for all of them in one scan, and split only where      //
+    //                their versions differ.  The roots are found in one     //
+    //                scan too, and a time left alone finishes as find       //
+    //                does.  So this takes the time of one find per time at  //
+    //                worst, when every version has changed the path, and    //
+    //                about half of it when the versions share most of it.   //
+    //                                                                       //
+    ///////////////////////////////////////////////////////////////////////////
+    template <class OutputIterator>
+    OutputIterator findAcrossVersions(const T& toFind,
+				      const vector< int >& times,
+				      OutputIterator out);
+
+    ///////////////////////////////////////////////////////////////////////////
+    //                                                                       //
+    // FUNCTION NAME: lowerBound                                             //
+    //                                                                       //
+    // PURPOSE:       Finds the first element at or after a datum at         //
+    //                time t.                                                //
+    //                                                                       //
+    // SECURITY:      public                                                 //
+    //                                                                       //
+    // PARAMETERS                                                            //
+    //   Type/Name:   const T&/toFind                                        //
+    //   Description: The datum to find.                                     //
+    //                                                                       //
+    //   Type/Name:   int/t                                                  //
+    //   Description: The time at which to find it.                          //
+    //                                                                       //
+    // RETURN:                                                               //
+    //   Type/Name:   PSLIterator<T>                                         //
+    //   Description: An iterator pointing to the element, or end(t) if      //
+    //                every element is before the datum.                     //
+    //                                                                       //
+    // NOTES:         None.                                                  //
+    //                                                                       //
+    ///////////////////////////////////////////////////////////////////////////
+    PSLIterator<T,Alloc,LevelGen,Ranked> lowerBound(const T& toFind, int t);
+
+    ///////////////////////////////////////////////////////////////////////////
+    //                                                                       //
+    // FUNCTION NAME: range                                                  //
+    //                                                                       //
+    // PURPOSE:       Writes the elements from lo to hi inclusive at time t  //
+    //                to an output iterator, in order.                       //
+    //                                                                       //
+    // SECURITY:      public                                                 //
+    //                                                                       //
+    // PARAMETERS                                                            //
+    //   Type/Name:   const T&/lo                                            //
+    //   Description: The least datum to write.                              //
+    //                                                                       //
+    //   Type/Name:   const T&/hi                                            //
+    //   Description: The greatest datum to write.                           //
+    //                                                                       //
+    //   Type/Name:   int/t                                                  //
+    //   Description: The time at which to query.                            //
+    //                                                                       //
+    //   Type/Name:   OutputIterator/out                                     //
+    //   Description: Where to write the elements.                           //
+    //                                                                       //
+    // RETURN:                                                               //
+    //   Type/Name:   OutputIterator                                         //
+    //   Description: The output iterator past the last element written.     //
+    //                                                                       //
+    // NOTES:         Searches once for lo, then follows the bottom level    //
+    //                until past hi, without building iterators.  A          //
+    //                callback can be passed as an output iterator whose     //
+    //                assignment calls it.                                   //
+    //                                                                       //
+    ///////////////////////////////////////////////////////////////////////////
+    template <class OutputIterator>
+    OutputIterator range(const T& lo, const T& hi, int t, OutputIterator out);
 
-    PSLIterator<T> find(const T& toFind, int t);
+    ///////////////////////////////////////////////////////////////////////////
+    //                                                                       //
+    // FUNCTION NAME: countRange                                             //
+    //                                                                       //
+    // PURPOSE:       Counts the elements from lo to hi inclusive at         //
+    //                time t.                                                //
+    //                                                                       //
+    // SECURITY:      public                                                 //
+    //                                                                       //
+    // PARAMETERS                                                            //
+    //   Type/Name:   const T&/lo                                            //
+    //   Description: The least datum to count.                              //
+    //                                                                       //
+    //   Type/Name:   const T&/hi                                            //
+    //   Description: The greatest datum to count.                           //
+    //                                                                       //
+    //   Type/Name:   int/t                                                  //
+    //   Description: The time at which to query.                            //
+    //                                                                       //
+    // RETURN:                                                               //
+    //   Type/Name:   int                                                    //
+    //   Description: The number of elements in the range.                   //
+    //                                                                       //
+    // NOTES:         Walks the range as range does, without copying data.   //
+    //                                                                       //
+    ///////////////////////////////////////////////////////////////////////////
+    int countRange(const T& lo, const T& hi, int t);
+
+    ///////////////////////////////////////////////////////////////////////////
+    //                                                                       //
+    // FUNCTION NAME: diff                                                   //
+    //                                                                       //
+    // PURPOSE:       Reports the data inserted and removed between two      //
+    //                versions.                                              //
+    //                                                                       //
+    // SECURITY:      public                                                 //
+    //                                                                       //
+    // PARAMETERS                                                            //
+    //   Type/Name:   int/t1                                                 //
+    //   Description: The earlier time.                                      //
+    //                                                                       //
+    //   Type/Name:   int/t2                                                 //
+    //   Description: The later time.                                        //
+    //                                                                       //
+    //   Type/Name:   InsertFunction/onInsert                                //
+    //   Description: Called with each datum at t2 but not at t1.            //
+    //                                                                       //
+    //   Type/Name:   RemoveFunction/onRemove                                //
+    //   Description: Called with each datum at t1 but not at t2.            //
+    //                                                                       //
+    // RETURN:                                                               //
+    //   Type/Name:   int                                                    //
+    //   Description: The number of data reported.                           //
+    //                                                                       //
+    // NOTES:         Reads only the changes made after t1 up to t2, so      //
+    //                takes time in the number of changes rather than the    //
+    //                size of the list.  Data are reported in order, and a   //
+    //                datum inserted and removed again in between isn't      //
+    //                reported.  t1 must not be before the versions dropped. //
+    //                                                                       //
+    ///////////////////////////////////////////////////////////////////////////
+    template <class InsertFunction, class RemoveFunction>
+    int diff(int t1, int t2, InsertFunction onInsert, RemoveFunction onRemove);
+
+    ///////////////////////////////////////////////////////////////////////////
+    //                                                                       //
+    // FUNCTION NAME: rank                                                   //
+    //                                                                       //
+    // PURPOSE:       Counts the elements before a datum at time t.          //
+    //                                                                       //
+    // SECURITY:      public                                                 //
+    //                                                                       //
+    // PARAMETERS                                                            //
+    //   Type/Name:   const T&/datum                                         //
+    //   Description: The datum to rank.                                     //
+    //                                                                       //
+    //   Type/Name:   int/t                                                  //
+    //   Description: The time at which to rank it.                          //
+    //                                                                       //
+    // RETURN:                                                               //
+    //   Type/Name:   int                                                    //
+    //   Description: The number of elements less than the datum.            //
+    //                                                                       //
+    // NOTES:         Takes logarithmic time, adding up the widths of the    //
+    //                links followed by the search.  Only compiles for a     //
+    //                Ranked list.                                           //
+    //                                                                       //
+    ///////////////////////////////////////////////////////////////////////////
+    int rank(const T& datum, int t);
+
+    ///////////////////////////////////////////////////////////////////////////
+    //                                                                       //
+    // FUNCTION NAME: select                                                 //
+    //                                                                       //
+    // PURPOSE:       Finds the element with k elements before it at         //
+    //                time t.                                                //
+    //                                                                       //
+    // SECURITY:      public                                                 //
+    //                                                                       //
+    // PARAMETERS                                                            //
+    //   Type/Name:   int/k                                                  //
+    //   Description: The rank of the element, counting from 0.              //
+    //                                                                       //
+    //   Type/Name:   int/t                                                  //
+    //   Description: The time at which to find it.                          //
+    //                                                                       //
+    // RETURN:                                                               //
+    //   Type/Name:   PSLIterator<T>                                         //
+    //   Description: An iterator pointing to the element, or end(t) if      //
+    //                there are no more than k elements.                     //
+    //                                                                       //
+    // NOTES:         Takes logarithmic time.  Only compiles for a Ranked    //
+    //                list.                                                  //
+    //                                                                       //
+    ///////////////////////////////////////////////////////////////////////////
+    PSLIterator<T,Alloc,LevelGen,Ranked> select(int k, int t);
 
     int getHeight(int t);
     
@@ -240,14 +525,261 @@ namespace persistent_skip_list {
     //                                                                       //
     ///////////////////////////////////////////////////////////////////////////
     int insert(const T& data);
-    const PersistentSkipList<T>& operator+=(const T& data);
+    const PersistentSkipList<T,Alloc,LevelGen,Ranked>& operator+=(
+      const T& data);
+
+    ///////////////////////////////////////////////////////////////////////////
+    //                                                                       //
+    // FUNCTION NAME: insert                                                 //
+    //                                                                       //
+    // PURPOSE:       Inserts data into the present version, moving it into  //
+    //                the new node.                                          //
+    //                                                                       //
+    // SECURITY:      public                                                 //
+    //                                                                       //
+    // PARAMETERS                                                            //
+    //   Type/Name:   T&&/data                                               //
+    //   Description: The data to be inserted, which is left moved from      //
+    //                unless it is a duplicate.                              //
+    //                                                                       //
+    // RETURN:                                                               //
+    //   Type/Name:   int                                                    //
+    //   Description: 0 for success.                                         //
+    //                                                                       //
+    // NOTES:         None.                                                  //
+    //                                                                       //
+    ///////////////////////////////////////////////////////////////////////////
+    int insert(T&& data);
+
+    ///////////////////////////////////////////////////////////////////////////
+    //                                                                       //
+    // FUNCTION NAME: emplace                                                //
+    //                                                                       //
+    // PURPOSE:       Inserts data constructed in place in the new node      //
+    //                into the present version.                              //
+    //                                                                       //
+    // SECURITY:      public                                                 //
+    //                                                                       //
+    // PARAMETERS                                                            //
+    //   Type/Name:   Args&&.../args                                         //
+    //   Description: The arguments of a constructor of T.                   //
+    //                                                                       //
+    // RETURN:                                                               //
+    //   Type/Name:   int                                                    //
+    //   Description: 0 for success.                                         //
+    //                                                                       //
+    // NOTES:         The node is built before the search, so a duplicate    //
+    //                is constructed and destroyed before the throw.         //
+    //                                                                       //
+    ///////////////////////////////////////////////////////////////////////////
+    template <class... Args>
+    int emplace(Args&&... args);
+
+    ///////////////////////////////////////////////////////////////////////////
+    //                                                                       //
+    // FUNCTION NAME: insert                                                 //
+    //                                                                       //
+    // PURPOSE:       Inserts a data node into the present version of        //
+    //                the structure, searching outward from a hint.          //
+    //                                                                       //
+    // SECURITY:      public                                                 //
+    //                                                                       //
+    // PARAMETERS                                                            //
+    //   Type/Name:   const T&/data                                          //
+    //   Description: The data to be inserted                                //
+    //                                                                       //
+    //   Type/Name:   const PSLIterator<T>&/hint                             //
+    //   Description: An iterator from this list at present near the data.   //
+    //                                                                       //
+    // RETURN:                                                               //
+    //   Type/Name:   PSLIterator<T>                                         //
+    //   Description: An iterator pointing to the inserted element, which    //
+    //                makes a good hint for the next insert.                 //
+    //                                                                       //
+    // NOTES:         Searches as find does with a hint, so inserting        //
+    //                near the last insert takes expected constant time      //
+    //                besides checking for duplicates.                       //
+    //                                                                       //
+    ///////////////////////////////////////////////////////////////////////////
+    PSLIterator<T,Alloc,LevelGen,Ranked> insert(
+      const T& data, const PSLIterator<T,Alloc,LevelGen,Ranked>& hint);
+
+    ///////////////////////////////////////////////////////////////////////////
+    //                                                                       //
+    // FUNCTION NAME: bulkLoad                                               //
+    //                                                                       //
+    // PURPOSE:       Replaces the present version of the structure with     //
+    //                the data in a sorted range, in one pass.               //
+    //                                                                       //
+    // SECURITY:      public                                                 //
+    //                                                                       //
+    // PARAMETERS                                                            //
+    //   Type/Name:   InputIterator/first                                    //
+    //   Description: The first datum of the range.                          //
+    //                                                                       //
+    //   Type/Name:   InputIterator/last                                     //
+    //   Description: One past the last datum of the range.                  //
+    //                                                                       //
+    // RETURN:                                                               //
+    //   Type/Name:   int                                                    //
+    //   Description: 0 for success.                                         //
+    //                                                                       //
+    // NOTES:         Runs in linear time.  Throws if the range is not       //
+    //                strictly increasing, leaving the present unchanged     //
+    //                and freeing every node built before.                   //
+    //                Heights are perfectly balanced rather than random,     //
+    //                and each node gets a single array of next pointers.    //
+    //                Past versions are unchanged.                           //
+    //                                                                       //
+    ///////////////////////////////////////////////////////////////////////////
+    template <class InputIterator>
+    int bulkLoad(InputIterator first, InputIterator last);
+
+    ///////////////////////////////////////////////////////////////////////////
+    //                                                                       //
+    // FUNCTION NAME: insertBatch                                            //
+    //                                                                       //
+    // PURPOSE:       Inserts a range of data into the present version of    //
+    //                the structure in one pass.                             //
+    //                                                                       //
+    // SECURITY:      public                                                 //
+    //                                                                       //
+    // PARAMETERS                                                            //
+    //   Type/Name:   InputIterator/first                                    //
+    //   Description: The first datum of the range.                          //
+    //                                                                       //
+    //   Type/Name:   InputIterator/last                                     //
+    //   Description: One past the last datum of the range.                  //
+    //                                                                       //
+    // RETURN:                                                               //
+    //   Type/Name:   int                                                    //
+    //   Description: 0 for success.                                         //
+    //                                                                       //
+    // NOTES:         The range needn't be sorted.  Each level is searched   //
+    //                from where the previous datum was linked instead of    //
+    //                from the head.  Throws if a datum is already present   //
+    //                or repeated, leaving the data at present unchanged.    //
+    //                Data from a forward range are sorted by pointer, so    //
+    //                only a single pass range is copied.                    //
+    //                                                                       //
+    ///////////////////////////////////////////////////////////////////////////
+    template <class InputIterator>
+    int insertBatch(InputIterator first, InputIterator last);
+
+    ///////////////////////////////////////////////////////////////////////////
+    //                                                                       //
+    // FUNCTION NAME: writeSnapshot                                          //
+    //                                                                       //
+    // PURPOSE:       Writes every version of the structure to a file        //
+    //                which PSLSnapshot can search in place.                 //
+    //                                                                       //
+    // SECURITY:      public                                                 //
+    //                                                                       //
+    // PARAMETERS                                                            //
+    //   Type/Name:   const char*/path                                       //
+    //   Description: The file to write.                                     //
+    //                                                                       //
+    // RETURN:                                                               //
+    //   Type/Name:   int                                                    //
+    //   Description: 0 for success.                                         //
+    //                                                                       //
+    // NOTES:         Includes the present, so should be called by the       //
+    //                writer.  T must be trivially copyable, since its       //
+    //                bytes are written as they are.  Throws if the file     //
+    //                can't be written.  See PSLSnapshot.hpp for the format. //
+    //                                                                       //
+    ///////////////////////////////////////////////////////////////////////////
+    int writeSnapshot(const char* path);
+
+    ///////////////////////////////////////////////////////////////////////////
+    //                                                                       //
+    // FUNCTION NAME: setJournal                                             //
+    //                                                                       //
+    // PURPOSE:       Records every later change to the structure in a       //
+    //                journal.                                               //
+    //                                                                       //
+    // SECURITY:      public                                                 //
+    //                                                                       //
+    // PARAMETERS                                                            //
+    //   Type/Name:   PSLJournal<T>*/journal                                 //
+    //   Description: The journal to append to, or NULL to stop.  It must    //
+    //                outlive the list, or be replaced first.                //
+    //                                                                       //
+    // RETURN:                                                               //
+    //   Type/Name:   Void.                                                  //
+    //   Description: None.                                                  //
+    //                                                                       //
+    // NOTES:         Each insert, remove, bulk load and increment of the    //
+    //                time is recorded once it has succeeded.  Only compiles //
+    //                for trivially copyable T.                              //
+    //                                                                       //
+    ///////////////////////////////////////////////////////////////////////////
+    void setJournal(PSLJournal<T>* journal);
+
+    ///////////////////////////////////////////////////////////////////////////
+    //                                                                       //
+    // FUNCTION NAME: replayJournal                                          //
+    //                                                                       //
+    // PURPOSE:       Repeats the changes recorded in a journal, starting    //
+    //                at the present.                                        //
+    //                                                                       //
+    // SECURITY:      public                                                 //
+    //                                                                       //
+    // PARAMETERS                                                            //
+    //   Type/Name:   const char*/path                                       //
+    //   Description: The journal to replay.                                 //
+    //                                                                       //
+    // RETURN:                                                               //
+    //   Type/Name:   int                                                    //
+    //   Description: The number of records replayed.                        //
+    //                                                                       //
+    // NOTES:         Replayed into a new list, rebuilds every version       //
+    //                recorded.  The changes to each version are gathered    //
+    //                and applied with one bulk load or batch insert, rather //
+    //                than one insert at a time, and are not recorded again. //
+    //                A missing journal replays nothing.  Throws if the      //
+    //                journal doesn't fit the list.  Only compiles for       //
+    //                trivially copyable T.                                  //
+    //                                                                       //
+    ///////////////////////////////////////////////////////////////////////////
+    int replayJournal(const char* path);
+
+    ///////////////////////////////////////////////////////////////////////////
+    //                                                                       //
+    // FUNCTION NAME: dropVersionsBefore                                     //
+    //                                                                       //
+    // PURPOSE:       Frees the history which only versions before time t    //
+    //                can reach.                                             //
+    //                                                                       //
+    // SECURITY:      public                                                 //
+    //                                                                       //
+    // PARAMETERS                                                            //
+    //   Type/Name:   int/t                                                  //
+    //   Description: The earliest time still searched, at most the          //
+    //                present.                                               //
+    //                                                                       //
+    // RETURN:                                                               //
+    //   Type/Name:   size_t                                                 //
+    //   Description: The bytes of nodes and next pointers returned to the   //
+    //                allocator.                                             //
+    //                                                                       //
+    // NOTES:         Drops the roots and next pointers replaced at or       //
+    //                before t, then frees every node the remaining ones     //
+    //                can't reach, taking O(n log n) time for n nodes.       //
+    //                Versions before t, and iterators into them, must not   //
+    //                be used again.  Not safe with concurrent readers.      //
+    //                                                                       //
+    ///////////////////////////////////////////////////////////////////////////
+    size_t dropVersionsBefore(int t);
 
     bool empty(void);
     bool empty(int t);
 
-    // useful for debugging
-#ifndef NDEBUG
-    vector< T > lastSearchPath;
+    // useful for debugging.  The data of each node visited by the last
+    // find this thread made in any list of this type, valid while its
+    // node is
+#ifdef PSL_SEARCH_PATH
+    static thread_local vector< const T* > lastSearchPath;
 #endif
 
     ///////////////////////////////////////////////////////////////////////////
@@ -255,22 +787,184 @@ namespace persistent_skip_list {
     ///////////////////////////////////////////////////////////////////////////
   private:
     const int node_size;
-    typedef TimeStampedArray< SmartPointer< ListNode<T> > > TSA;
+    typedef typename ListNode<T,Alloc,Ranked>::TSA TSA;
+    // declared before the nodes, so destroyed after every node
+    Alloc allocator;
+    // picks the heights of inserted nodes
+    LevelGen levels;
     int present;
-    map<int,SmartPointer<ListNode<T> > > head;
-    map<int,SmartPointer<ListNode<T> > > tail;
-    set< T > data_set;
+
+    // The head and tail of the list from a given time onwards
+    struct VersionRoot {
+      int time;
+      ListNode<T,Alloc,Ranked>* head;
+      ListNode<T,Alloc,Ranked>* tail;
+    };
+    // One root per time at which the head or tail changed, sorted by
+    // time, of which root_count are published.  A full array is
+    // replaced rather than grown in place, so it never moves under
+    // readers, and the replaced arrays are retired until destruction.
+    VersionRoot* roots;
+    int root_count;
+    int root_capacity;
+    vector<VersionRoot*> retired_roots;
+    // Every node ever created, which the list owns and destroys, since
+    // past versions may still reach a node removed from the present
+    vector< ListNode<T,Alloc,Ranked>* > nodes;
+    // where changes are recorded, if anywhere.  A journal copies data
+    // as raw bytes, so other lists compile out every use of it.
+    static const bool JOURNALED = std::is_trivially_copyable<T>::value;
+    PSLJournal<T>* journal;
+
+    // A node inserted into or removed from the present at a time
+    struct Change {
+      int time;
+      bool inserted;
+      const ListNode<T,Alloc,Ranked>* node;
+    };
+    // Every change since the versions dropped, sorted by time, of which
+    // change_count are published.  Replaced when full, as roots is.
+    // The nodes changed are kept by the versions on either side.
+    Change* changes;
+    int change_count;
+    int change_capacity;
+    vector<Change*> retired_changes;
+
+    // the list owns its nodes, so can't be copied
+    PersistentSkipList(const PersistentSkipList<T,Alloc,LevelGen,Ranked>&);
+    PersistentSkipList<T,Alloc,LevelGen,Ranked>& operator=(
+      const PersistentSkipList<T,Alloc,LevelGen,Ranked>&);
+
+    // Creates a node from the allocator and takes ownership of it, in
+    // one block with its storage
+    ListNode<T,Alloc,Ranked>* createNode(const T& data);
+    ListNode<T,Alloc,Ranked>* createNode(const T& data, int height);
+    template <class... Args>
+    ListNode<T,Alloc,Ranked>* emplaceNode(int height, Args&&... args);
+    ListNode<T,Alloc,Ranked>* createNode(int height, bool positive);
+    ListNode<T,Alloc,Ranked>* copyNode(
+      const ListNode<T,Alloc,Ranked>& original);
+
+    // Destroys a node and returns it to the allocator
+    void destroyNode(ListNode<T,Alloc,Ranked>* node);
+    // the size of the block of a node of the given height
+    size_t getNodeBytes(int height);
     
-    // Adds a head/tail to the map of heads/tails
-    int addHead(SmartPointer<ListNode<T> > new_head);
-    int addTail(SmartPointer<ListNode<T> > new_tail);
+    // Adds a head/tail to the roots at present
+    int addHead(ListNode<T,Alloc,Ranked>* new_head);
+    int addTail(ListNode<T,Alloc,Ranked>* new_tail);
+
+    // Binary searches the roots for the root in effect at time t
+    VersionRoot& getRoot(int t);
+
+    // Gets the root at present, starting a new one if the last is from
+    // the past
+    VersionRoot& getPresentRoot(void);
+
+    // Gets the head/tail from the roots at time t
+    ListNode<T,Alloc,Ranked>* getHead(int t);
+    ListNode<T,Alloc,Ranked>* getTail(int t);
+
+    // Rebuilds current head and tail with increased height, replacing
+    // the old head and any copied node in fingers
+    void buildHeadAndTail(int height,
+			  vector< ListNode<T,Alloc,Ranked>* >* fingers = NULL);
+
+    // Adds next pointers to a node at present, copying the node and
+    // redirecting its predecessors if its change log is full.  Returns
+    // the node holding the next pointers, replacing any copied node in
+    // fingers with its copy.
+    ListNode<T,Alloc,Ranked>* addNext(
+      ListNode<T,Alloc,Ranked>* node, TSA* next,
+      vector< ListNode<T,Alloc,Ranked>* >* fingers = NULL);
+
+    // Gets the next pointers of a node at present, which may be changed
+    // in place at and above the lowest level, adding them first if the
+    // latest are from the past or don't hold the level.  The node is
+    // updated if it had to be copied.
+    TSA* getPresentNext(ListNode<T,Alloc,Ranked>*& node, int lowest,
+			vector< ListNode<T,Alloc,Ranked>* >* fingers);
+
+    // The lowest level at which the finger at a level is also the
+    // finger, so that it is changed at all of them at once
+    int getFingerLowest(const vector< ListNode<T,Alloc,Ranked>* >& fingers,
+			int level);
+
+    // Moves fingers at or before the predecessors of a datum at each
+    // level onto them, along with their ranks, which may be counted
+    // from any node before them.  Returns false if the datum is
+    // already in the present version.
+    bool placeFingers(const T& data,
+		      vector< ListNode<T,Alloc,Ranked>* >& fingers,
+		      vector< int >& ranks);
+
+    // Links a new node into the present after the fingers placed for
+    // it, reaching at least its height, and moves the fingers below its
+    // height onto it
+    void linkNode(ListNode<T,Alloc,Ranked>* node,
+		  vector< ListNode<T,Alloc,Ranked>* >& fingers,
+		  vector< int >& ranks);
+    // Places the insert fingers for a datum from the head at present.
+    // Returns false if the datum is already in the present version.
+    bool placeInsertFingers(const T& data);
+    // Links a new node after the insert fingers, growing the head if
+    // it is taller
+    int linkInserted(ListNode<T,Alloc,Ranked>* node);
+    // reused by insert to avoid allocating fingers for every datum
+    vector< ListNode<T,Alloc,Ranked>* > insert_fingers;
+    vector< int > insert_ranks;
+
+    // Adds delta to the widths of the links at and above a level which
+    // pass over a node at present, climbing from the node through the
+    // incoming nodes
+    void adjustWidths(ListNode<T,Alloc,Ranked>* node, int level, int delta,
+		      vector< ListNode<T,Alloc,Ranked>* >* fingers);
+
+    // Removes a node from the present version of the list
+    void removeNode(ListNode<T,Alloc,Ranked>* node);
+
+    // Removes a node from the present without recording the change
+    void unlinkNode(ListNode<T,Alloc,Ranked>* node);
+
+    // Orders pointers to data by the data
+    static bool dataLess(const T* a, const T* b);
+
+    // Records a change to the present for diff, then publishes it
+    void logChange(const ListNode<T,Alloc,Ranked>* node, bool inserted);
+    // orders changes by the data of their nodes
+    static bool changeLess(const Change* a, const Change* b);
+
+    // Searches down from an iterator, which must be at or before the
+    // datum with its next node after it, for the last element at or
+    // before the datum
+    PSLIterator<T,Alloc,LevelGen,Ranked> searchFrom(
+      PSLIterator<T,Alloc,LevelGen,Ranked> iter, const T& toFind);
+
+    // Consecutive times of findAcrossVersions which have reached the
+    // same node at the same level.  If resolved, the node's next
+    // pointers at those times are already known.
+    struct SearchRun {
+      ListNode<T,Alloc,Ranked>* node;
+      int level;
+      int first;
+      int last;
+      bool resolved;
+    };
+
+    // Searches down from the head at time t for the last node before a
+    // datum, following next pointers directly
+    ListNode<T,Alloc,Ranked>* findBefore(const T& toFind, int t);
 
-    // Gets the head/tail from the map of heads/tails at time t
-    SmartPointer<ListNode<T> >& getHead(int t);
-    SmartPointer<ListNode<T> >& getTail(int t);
+    // Applies the changes to the present gathered by replayJournal,
+    // then clears them
+    void replayVersion(set< T >& inserts, bool& cleared);
 
-    // Rebuilds current head and tail with increased height
-    void buildHeadAndTail(int height);
+    // Searches outward from a hint for a node at or before a datum at
+    // time t whose next node at the given level is after it.  Returns
+    // false if the hint can't be used.
+    bool fingerSearch(const T& toFind, int t,
+		      const PSLIterator<T,Alloc,LevelGen,Ranked>& hint,
+		      ListNode<T,Alloc,Ranked>*& node, int& level);
   };
 }
 
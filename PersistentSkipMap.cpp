@@ -0,0 +1,200 @@
+///////////////////////////////////////////////////////////////////////////////
+//                       Copyright (c) 2011 - 2012 by                        //
+//                                Simon Pratt                                //
+//                           (All rights reserved)                           //
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// FILE:    PersistentSkipMap.cpp                                            //
+//                                                                           //
+// MODULE:  Persistent Skip List                                             //
+//                                                                           //
+// NOTES:   None.                                                            //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+#ifndef PERSISTENTSKIPMAP_CPP
+#define PERSISTENTSKIPMAP_CPP
+
+#include "PersistentSkipMap.hpp"
+
+using namespace persistent_skip_list;
+
+///////////////////////////////////////////////////////////////////////////////
+// PersistentSkipMap Implementation                                          //
+///////////////////////////////////////////////////////////////////////////////
+
+template < class K, class V, class Compare, class Alloc >
+PersistentSkipMap<K,V,Compare,Alloc>::Entry::Entry()
+  : key(), log(NULL)
+{}
+
+template < class K, class V, class Compare, class Alloc >
+PersistentSkipMap<K,V,Compare,Alloc>::Entry::Entry(const K& k, Log* l)
+  : key(k), log(l)
+{}
+
+template < class K, class V, class Compare, class Alloc >
+bool PersistentSkipMap<K,V,Compare,Alloc>::Entry::operator<(
+  const Entry& other) const {
+  return Compare()(key,other.key);
+}
+
+template < class K, class V, class Compare, class Alloc >
+bool PersistentSkipMap<K,V,Compare,Alloc>::Entry::operator>(
+  const Entry& other) const {
+  return Compare()(other.key,key);
+}
+
+template < class K, class V, class Compare, class Alloc >
+PersistentSkipMap<K,V,Compare,Alloc>::PersistentSkipMap(int nodeSize)
+  : allocator(), index(nodeSize), logs()
+{}
+
+template < class K, class V, class Compare, class Alloc >
+PersistentSkipMap<K,V,Compare,Alloc>::~PersistentSkipMap(void) {
+  for(size_t i = 0; i < logs.size(); ++i) {
+    Slot* slot = logs[i]->latest;
+    while(slot != NULL) {
+      Slot* previous = slot->previous;
+      destroySlot(slot);
+      slot = previous;
+    }
+    destroyLog(logs[i]);
+  }
+}
+
+template < class K, class V, class Compare, class Alloc >
+int PersistentSkipMap<K,V,Compare,Alloc>::getPresent(void) const {
+  return index.getPresent();
+}
+
+template < class K, class V, class Compare, class Alloc >
+void PersistentSkipMap<K,V,Compare,Alloc>::incTime(void) {
+  index.incTime();
+}
+
+template < class K, class V, class Compare, class Alloc >
+typename PersistentSkipMap<K,V,Compare,Alloc>::Log*
+PersistentSkipMap<K,V,Compare,Alloc>::findLog(const K& key, int t) {
+  const Entry& entry = *index.find(Entry(key,NULL),t);
+  // the head has no log, and any other entry found is at or before key
+  if(entry.log == NULL || Compare()(entry.key,key))
+    return NULL;
+  return entry.log;
+}
+
+template < class K, class V, class Compare, class Alloc >
+const V& PersistentSkipMap<K,V,Compare,Alloc>::getVersion(const Log* log,
+							  int t) const {
+  // the first slot starts when the key was inserted, at or before t
+  const Slot* slot = atomicLoad(&log->latest);
+  while(slot->times[0] > t)
+    slot = slot->previous;
+  // reverse linear search from the latest version, as in ListNode
+  int version = atomicLoad(&slot->count)-1;
+  while(slot->times[version] > t)
+    --version;
+  assert(version >= 0);
+  return slot->values[version];
+}
+
+template < class K, class V, class Compare, class Alloc >
+typename PersistentSkipMap<K,V,Compare,Alloc>::Log*
+PersistentSkipMap<K,V,Compare,Alloc>::createLog(void) {
+  Log* log = new (allocator.allocate(sizeof(Log))) Log();
+  log->latest = NULL;
+  logs.push_back(log);
+  return log;
+}
+
+template < class K, class V, class Compare, class Alloc >
+void PersistentSkipMap<K,V,Compare,Alloc>::destroyLog(Log* log) {
+  log->~Log();
+  allocator.deallocate(log,sizeof(Log));
+}
+
+template < class K, class V, class Compare, class Alloc >
+typename PersistentSkipMap<K,V,Compare,Alloc>::Slot*
+PersistentSkipMap<K,V,Compare,Alloc>::createSlot(Slot* previous) {
+  void* block = allocator.allocate(sizeof(Slot));
+  Slot* slot;
+  try {
+    slot = new (block) Slot();
+  } catch(...) {
+    allocator.deallocate(block,sizeof(Slot));
+    throw;
+  }
+  slot->count = 0;
+  slot->previous = previous;
+  return slot;
+}
+
+template < class K, class V, class Compare, class Alloc >
+void PersistentSkipMap<K,V,Compare,Alloc>::destroySlot(Slot* slot) {
+  slot->~Slot();
+  allocator.deallocate(slot,sizeof(Slot));
+}
+
+template < class K, class V, class Compare, class Alloc >
+void PersistentSkipMap<K,V,Compare,Alloc>::addVersion(Log* log,
+						      const V& value) {
+  int present = getPresent();
+  Slot* slot = log->latest;
+  // versions from the present aren't visible to readers
+  if(slot != NULL && slot->times[slot->count-1] == present) {
+    slot->values[slot->count-1] = value;
+    return;
+  }
+  if(slot == NULL || slot->count == SLOT_SIZE) {
+    // the slot is full, so a fresh one follows it, published once
+    // its first version is written
+    Slot* fresh = createSlot(slot);
+    fresh->times[0] = present;
+    fresh->values[0] = value;
+    fresh->count = 1;
+    atomicStore(&log->latest,fresh);
+    return;
+  }
+  slot->times[slot->count] = present;
+  slot->values[slot->count] = value;
+  // publish the version once it is written
+  atomicStore(&slot->count,slot->count+1);
+}
+
+template < class K, class V, class Compare, class Alloc >
+int PersistentSkipMap<K,V,Compare,Alloc>::put(const K& key, const V& value) {
+  Log* log = findLog(key,getPresent());
+  if(log != NULL) {
+    addVersion(log,value);
+    return 0;
+  }
+  // a new key, or one removed before, starts a new log
+  log = createLog();
+  addVersion(log,value);
+  index.insert(Entry(key,log));
+  return 0;
+}
+
+template < class K, class V, class Compare, class Alloc >
+int PersistentSkipMap<K,V,Compare,Alloc>::remove(const K& key) {
+  int present = getPresent();
+  PSLIterator<Entry,Alloc> entry = index.find(Entry(key,NULL),present);
+  if((*entry).log == NULL || Compare()((*entry).key,key))
+    throw "Tried to remove missing key";
+  entry.remove();
+  return 0;
+}
+
+template < class K, class V, class Compare, class Alloc >
+bool PersistentSkipMap<K,V,Compare,Alloc>::contains(const K& key, int t) {
+  return findLog(key,t) != NULL;
+}
+
+template < class K, class V, class Compare, class Alloc >
+const V& PersistentSkipMap<K,V,Compare,Alloc>::get(const K& key, int t) {
+  const Log* log = findLog(key,t);
+  if(log == NULL)
+    throw "Tried to get missing key";
+  return getVersion(log,t);
+}
+
+#endif
@@ -0,0 +1,258 @@
+//-*- mode: c++ -*-////////////////////////////////////////////////////////////
+//                       Copyright (c) 2011 - 2012 by                        //
+//                                Simon Pratt                                //
+//                           (All rights reserved)                           //
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// FILE:    PersistentSkipMap.hpp                                            //
+//                                                                           //
+// MODULE:  Persistent Skip List                                             //
+//                                                                           //
+// PURPOSE: Implements a persistent map from keys to values, whose keys are  //
+//          indexed by a persistent skip list, and whose values each have a  //
+//          log of timestamped versions of their own, so that changing the   //
+//          value of a key leaves the links of the skip list untouched.      //
+//                                                                           //
+// NOTES:   Keys are ordered by a Compare, which must be default             //
+//          constructible, since every entry compares with its own.  Values  //
+//          must be default constructible and assignable.                    //
+//                                                                           //
+//          A key's values are kept in a chain of slots, each a fixed log    //
+//          of versions, the latest slot first.  The first put of a value    //
+//          in a version appends it, later puts in the same version          //
+//          overwrite it.  Removing a key removes its node from the present, //
+//          and putting it again starts a new log.  Logs and slots are       //
+//          allocated from the Alloc allocator policy, as the index's nodes  //
+//          are.                                                             //
+//                                                                           //
+//          As with PersistentSkipList, one writer may change the present    //
+//          while readers search times before getPresent().                  //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+//                             Public Methods:                               //
+//                                                                           //
+// put(const K&,const V&)         - sets the value of a key at present       //
+// remove(const K&)               - removes a key at present                 //
+// contains(const K&,int)         - finds a key at a time                    //
+// get(const K&,int)              - gets the value of a key at a time        //
+// incTime()                      - ends the present version                 //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+#ifndef PERSISTENTSKIPMAP_HPP
+#define PERSISTENTSKIPMAP_HPP
+
+#include <vector>
+#include <functional>
+#include <cassert>
+#include <cstddef>
+
+#include "PersistentSkipList.hpp"
+
+namespace persistent_skip_list {
+
+  /////////////////////////////////////////////////////////////////////////////
+  // PersistentSkipMap interface                                             //
+  /////////////////////////////////////////////////////////////////////////////
+  template < class K, class V, class Compare = std::less<K>,
+	     class Alloc = HeapAllocator >
+  class PersistentSkipMap {
+  public:
+    ///////////////////////////////////////////////////////////////////////////
+    //                                                                       //
+    // FUNCTION NAME: PersistentSkipMap                                      //
+    //                                                                       //
+    // PURPOSE:       Empty constructor                                      //
+    //                                                                       //
+    // SECURITY:      public                                                 //
+    //                                                                       //
+    // PARAMETERS                                                            //
+    //   Type/Name:   int/nodeSize                                           //
+    //   Description: The node size of the index of keys.                    //
+    //                                                                       //
+    // RETURN:        Void.                                                  //
+    //                                                                       //
+    // NOTES:         None.                                                  //
+    //                                                                       //
+    ///////////////////////////////////////////////////////////////////////////
+    PersistentSkipMap(int nodeSize=3);
+
+    ///////////////////////////////////////////////////////////////////////////
+    //                                                                       //
+    // FUNCTION NAME: ~PersistentSkipMap                                     //
+    //                                                                       //
+    // PURPOSE:       Destructor.                                            //
+    //                                                                       //
+    // SECURITY:      public                                                 //
+    //                                                                       //
+    // PARAMETERS                                                            //
+    //   Type/Name:   Void.                                                  //
+    //   Description: None.                                                  //
+    //                                                                       //
+    // RETURN:        Void.                                                  //
+    //                                                                       //
+    // NOTES:         Frees every version of every value.                    //
+    //                                                                       //
+    ///////////////////////////////////////////////////////////////////////////
+    ~PersistentSkipMap(void);
+
+    int getPresent(void) const;
+    void incTime(void);
+
+    ///////////////////////////////////////////////////////////////////////////
+    //                                                                       //
+    // FUNCTION NAME: put                                                    //
+    //                                                                       //
+    // PURPOSE:       Sets the value of a key in the present version.        //
+    //                                                                       //
+    // SECURITY:      public                                                 //
+    //                                                                       //
+    // PARAMETERS                                                            //
+    //   Type/Name:   const K&/key                                           //
+    //   Description: The key, which is inserted if it is missing.           //
+    //                                                                       //
+    //   Type/Name:   const V&/value                                         //
+    //   Description: The new value of the key.                              //
+    //                                                                       //
+    // RETURN:                                                               //
+    //   Type/Name:   int                                                    //
+    //   Description: 0 on success.                                          //
+    //                                                                       //
+    // NOTES:         A key already present only gets a new version of its   //
+    //                value, without changing the skip list.                 //
+    //                                                                       //
+    ///////////////////////////////////////////////////////////////////////////
+    int put(const K& key, const V& value);
+
+    ///////////////////////////////////////////////////////////////////////////
+    //                                                                       //
+    // FUNCTION NAME: remove                                                 //
+    //                                                                       //
+    // PURPOSE:       Removes a key and its value from the present version.  //
+    //                                                                       //
+    // SECURITY:      public                                                 //
+    //                                                                       //
+    // PARAMETERS                                                            //
+    //   Type/Name:   const K&/key                                           //
+    //   Description: The key to remove.                                     //
+    //                                                                       //
+    // RETURN:                                                               //
+    //   Type/Name:   int                                                    //
+    //   Description: 0 on success.                                          //
+    //                                                                       //
+    // NOTES:         Throws if the key is not present.                      //
+    //                                                                       //
+    ///////////////////////////////////////////////////////////////////////////
+    int remove(const K& key);
+
+    ///////////////////////////////////////////////////////////////////////////
+    //                                                                       //
+    // FUNCTION NAME: contains                                               //
+    //                                                                       //
+    // PURPOSE:       Checks whether a key is in the map at a time.          //
+    //                                                                       //
+    // SECURITY:      public                                                 //
+    //                                                                       //
+    // PARAMETERS                                                            //
+    //   Type/Name:   const K&/key                                           //
+    //   Description: The key to find.                                       //
+    //                                                                       //
+    //   Type/Name:   int/t                                                  //
+    //   Description: The time at which to search.                           //
+    //                                                                       //
+    // RETURN:                                                               //
+    //   Type/Name:   bool                                                   //
+    //   Description: True if the key is in the map at time t.               //
+    //                                                                       //
+    // NOTES:         None.                                                  //
+    //                                                                       //
+    ///////////////////////////////////////////////////////////////////////////
+    bool contains(const K& key, int t);
+
+    ///////////////////////////////////////////////////////////////////////////
+    //                                                                       //
+    // FUNCTION NAME: get                                                    //
+    //                                                                       //
+    // PURPOSE:       Gets the value of a key as of a time.                  //
+    //                                                                       //
+    // SECURITY:      public                                                 //
+    //                                                                       //
+    // PARAMETERS                                                            //
+    //   Type/Name:   const K&/key                                           //
+    //   Description: The key to find.                                       //
+    //                                                                       //
+    //   Type/Name:   int/t                                                  //
+    //   Description: The time at which to search.                           //
+    //                                                                       //
+    // RETURN:                                                               //
+    //   Type/Name:   const V&                                               //
+    //   Description: The value last put for the key at or before time t.    //
+    //                                                                       //
+    // NOTES:         Throws if the key is not in the map at time t.  The    //
+    //                reference is valid while the map is.                   //
+    //                                                                       //
+    ///////////////////////////////////////////////////////////////////////////
+    const V& get(const K& key, int t);
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Kindly ignore my private parts                                        //
+    ///////////////////////////////////////////////////////////////////////////
+  private:
+    static const int SLOT_SIZE = 4;
+
+    // Versions of a value, a fixed log of SLOT_SIZE entries so it never
+    // moves under readers, of which count are published.  A full slot
+    // is followed by a fresh one, which points back to it.
+    struct Slot {
+      int count;
+      int times[SLOT_SIZE];
+      V values[SLOT_SIZE];
+      Slot* previous;
+    };
+
+    // Every version of the value of a key since it was last inserted.
+    // latest is published after the slot it points to is written.
+    struct Log {
+      Slot* latest;
+    };
+
+    // An entry of the index, ordered by its key alone.  Copies of a
+    // node share the log.
+    class Entry {
+    public:
+      Entry();
+      Entry(const K& key, Log* log);
+      bool operator<(const Entry& other) const;
+      bool operator>(const Entry& other) const;
+      K key;
+      Log* log;
+    };
+
+    // where logs and slots are allocated
+    Alloc allocator;
+    PersistentSkipList<Entry,Alloc> index;
+    // every log ever created, for freeing their slots
+    vector< Log* > logs;
+
+    // the log of a key at time t, or NULL if it isn't in the map then
+    Log* findLog(const K& key, int t);
+    // the version of a log in effect at time t
+    const V& getVersion(const Log* log, int t) const;
+    // logs and slots come from the allocator, and go back to it
+    Log* createLog(void);
+    void destroyLog(Log* log);
+    Slot* createSlot(Slot* previous);
+    void destroySlot(Slot* slot);
+    // publishes a value at present, replacing one from the present
+    void addVersion(Log* log, const V& value);
+
+    // the map owns its logs, so can't be copied
+    PersistentSkipMap(const PersistentSkipMap<K,V,Compare,Alloc>&);
+    PersistentSkipMap<K,V,Compare,Alloc>& operator=(
+      const PersistentSkipMap<K,V,Compare,Alloc>&);
+  };
+}
+
+#include "PersistentSkipMap.cpp"
+
+#endif
@@ -0,0 +1,439 @@
+///////////////////////////////////////////////////////////////////////////////
+//                       Copyright (c) 2011 - 2012 by                        //
+//                                Simon Pratt                                //
+//                           (All rights reserved)                           //
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// FILE:    PersistentUnrolledList.cpp                                       //
+//                                                                           //
+// MODULE:  Persistent Skip List                                             //
+//                                                                           //
+// NOTES:   None.                                                            //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+#ifndef PERSISTENTUNROLLEDLIST_CPP
+#define PERSISTENTUNROLLEDLIST_CPP
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE4_2__)
+#include <nmmintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "PersistentUnrolledList.hpp"
+
+using namespace persistent_skip_list;
+
+///////////////////////////////////////////////////////////////////////////////
+// LaneCompare Implementation                                                //
+///////////////////////////////////////////////////////////////////////////////
+
+#if defined(__SSE2__)
+namespace persistent_skip_list {
+  // the SIMD compares of signed keys of a given width: wide for AVX2
+  // registers, narrow for SSE ones, the latter only if NARROW
+  template < size_t Bytes >
+  struct LaneCompare;
+
+  template <>
+  struct LaneCompare<1> {
+#if defined(__AVX2__)
+    static __m256i wide(int x) { return _mm256_set1_epi8((char)x); }
+    static __m256i wideLess(__m256i a, __m256i b) {
+      return _mm256_cmpgt_epi8(b,a);
+    }
+#endif
+    static const bool NARROW = true;
+    static __m128i narrow(int x) { return _mm_set1_epi8((char)x); }
+    static __m128i narrowLess(__m128i a, __m128i b) {
+      return _mm_cmplt_epi8(a,b);
+    }
+  };
+
+  template <>
+  struct LaneCompare<2> {
+#if defined(__AVX2__)
+    static __m256i wide(int x) { return _mm256_set1_epi16((short)x); }
+    static __m256i wideLess(__m256i a, __m256i b) {
+      return _mm256_cmpgt_epi16(b,a);
+    }
+#endif
+    static const bool NARROW = true;
+    static __m128i narrow(int x) { return _mm_set1_epi16((short)x); }
+    static __m128i narrowLess(__m128i a, __m128i b) {
+      return _mm_cmplt_epi16(a,b);
+    }
+  };
+
+  template <>
+  struct LaneCompare<4> {
+#if defined(__AVX2__)
+    static __m256i wide(int x) { return _mm256_set1_epi32(x); }
+    static __m256i wideLess(__m256i a, __m256i b) {
+      return _mm256_cmpgt_epi32(b,a);
+    }
+#endif
+    static const bool NARROW = true;
+    static __m128i narrow(int x) { return _mm_set1_epi32(x); }
+    static __m128i narrowLess(__m128i a, __m128i b) {
+      return _mm_cmplt_epi32(a,b);
+    }
+  };
+
+  template <>
+  struct LaneCompare<8> {
+#if defined(__AVX2__)
+    static __m256i wide(long long x) { return _mm256_set1_epi64x(x); }
+    static __m256i wideLess(__m256i a, __m256i b) {
+      return _mm256_cmpgt_epi64(b,a);
+    }
+#endif
+    // SSE2 has no 64 bit compare
+#if defined(__SSE4_2__)
+    static const bool NARROW = true;
+    static __m128i narrow(long long x) { return _mm_set1_epi64x(x); }
+    static __m128i narrowLess(__m128i a, __m128i b) {
+      return _mm_cmpgt_epi64(b,a);
+    }
+#else
+    static const bool NARROW = false;
+#endif
+  };
+}
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+// BlockSearch Implementation                                                //
+///////////////////////////////////////////////////////////////////////////////
+
+template < class T >
+int BlockSearch<T>::countLess(const T* keys, int count, const T& datum) {
+#if defined(__SSE2__)
+  return countLess(keys,count,datum,
+		   integral_constant<bool,is_integral<T>::value &&
+				     !is_same<T,bool>::value>());
+#else
+  return countLess(keys,count,datum,false_type());
+#endif
+}
+
+template < class T >
+int BlockSearch<T>::countLess(const T* keys, int count, const T& datum,
+			      false_type) {
+  return (int)(lower_bound(keys,keys+count,datum) - keys);
+}
+
+template < class T >
+int BlockSearch<T>::countLess(const T* keys, int count, const T& datum,
+			      true_type) {
+  int less = 0, i = 0;
+#if defined(__SSE2__)
+  typedef LaneCompare<sizeof(T)> Lanes;
+  typedef typename make_signed<T>::type S;
+  // unsigned keys compare as signed ones once their top bits are flipped
+  const S flip = is_signed<T>::value ? (S)0 : numeric_limits<S>::min();
+  const S probe = (S)((S)datum ^ flip);
+  // the keys are sorted, so once a group isn't all less the rest aren't
+#if defined(__AVX2__)
+  const int wideLanes = 32 / sizeof(T);
+  __m256i wideFlip = Lanes::wide(flip), wideProbe = Lanes::wide(probe);
+  for(; i + wideLanes <= count; i += wideLanes) {
+    __m256i group = _mm256_xor_si256(
+      _mm256_loadu_si256((const __m256i*)(keys + i)),wideFlip);
+    unsigned mask = _mm256_movemask_epi8(Lanes::wideLess(group,wideProbe));
+    // each lane sets one mask bit per byte
+    less += __builtin_popcount(mask) / sizeof(T);
+    if(mask != 0xffffffffu)
+      return less;
+  }
+#endif
+  if constexpr(Lanes::NARROW) {
+    const int narrowLanes = 16 / sizeof(T);
+    __m128i narrowFlip = Lanes::narrow(flip);
+    __m128i narrowProbe = Lanes::narrow(probe);
+    for(; i + narrowLanes <= count; i += narrowLanes) {
+      __m128i group = _mm_xor_si128(
+	_mm_loadu_si128((const __m128i*)(keys + i)),narrowFlip);
+      unsigned mask = _mm_movemask_epi8(Lanes::narrowLess(group,narrowProbe));
+      less += __builtin_popcount(mask) / sizeof(T);
+      if(mask != 0xffffu)
+	return less;
+    }
+  }
+#endif
+  for(; i < count && keys[i] < datum; ++i)
+    ++less;
+  return less;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// PersistentUnrolledList Implementation                                     //
+///////////////////////////////////////////////////////////////////////////////
+
+template < class T, class Alloc >
+PersistentUnrolledList<T,Alloc>::Ref::Ref()
+  : low(), slot(NULL)
+{}
+
+template < class T, class Alloc >
+PersistentUnrolledList<T,Alloc>::Ref::Ref(const T& l, Slot* s)
+  : low(l), slot(s)
+{}
+
+template < class T, class Alloc >
+bool PersistentUnrolledList<T,Alloc>::Ref::operator<(const Ref& other) const {
+  return low < other.low;
+}
+
+template < class T, class Alloc >
+bool PersistentUnrolledList<T,Alloc>::Ref::operator>(const Ref& other) const {
+  return other.low < low;
+}
+
+template < class T, class Alloc >
+bool PersistentUnrolledList<T,Alloc>::Ref::operator<=(const Ref& other) const {
+  return !(other.low < low);
+}
+
+template < class T, class Alloc >
+bool PersistentUnrolledList<T,Alloc>::Ref::operator>=(const Ref& other) const {
+  return !(low < other.low);
+}
+
+template < class T, class Alloc >
+bool PersistentUnrolledList<T,Alloc>::Ref::operator==(const Ref& other) const {
+  return !(low < other.low) && !(other.low < low);
+}
+
+template < class T, class Alloc >
+bool PersistentUnrolledList<T,Alloc>::Ref::operator!=(const Ref& other) const {
+  return !operator==(other);
+}
+
+template < class T, class Alloc >
+PersistentUnrolledList<T,Alloc>::PersistentUnrolledList(int bs, int nodeSize)
+  : blockSize(bs), allocator(), index(nodeSize), slots()
+{
+  assert(bs > 1);
+}
+
+template < class T, class Alloc >
+PersistentUnrolledList<T,Alloc>::~PersistentUnrolledList(void) {
+  for(size_t i = 0; i < slots.size(); ++i) {
+    for(int j = 0; j < slots[i]->count; ++j)
+      destroyKeys(slots[i]->keys[j]);
+    destroySlot(slots[i]);
+  }
+}
+
+template < class T, class Alloc >
+int PersistentUnrolledList<T,Alloc>::getPresent(void) const {
+  return index.getPresent();
+}
+
+template < class T, class Alloc >
+void PersistentUnrolledList<T,Alloc>::incTime(void) {
+  index.incTime();
+}
+
+template < class T, class Alloc >
+PSLIterator<typename PersistentUnrolledList<T,Alloc>::Ref,Alloc>
+PersistentUnrolledList<T,Alloc>::findRef(const T& datum, int t) {
+  PSLIterator<Ref,Alloc> ref = index.find(Ref(datum,NULL),t);
+  // the head has no slot, and data before every entry go in the first
+  if((*ref).slot == NULL)
+    return index.begin(t);
+  return ref;
+}
+
+template < class T, class Alloc >
+int PersistentUnrolledList<T,Alloc>::getVersion(const Slot* slot,
+						int t) const {
+  // reverse linear search from the latest version, as in ListNode
+  int version = atomicLoad(&slot->count)-1;
+  while(version >= 0 && slot->times[version] > t)
+    --version;
+  return version;
+}
+
+template < class T, class Alloc >
+typename PersistentUnrolledList<T,Alloc>::Slot*
+PersistentUnrolledList<T,Alloc>::createSlot(void) {
+  Slot* slot = new (allocator.allocate(sizeof(Slot))) Slot();
+  slot->count = 0;
+  slots.push_back(slot);
+  return slot;
+}
+
+template < class T, class Alloc >
+void PersistentUnrolledList<T,Alloc>::destroySlot(Slot* slot) {
+  slot->~Slot();
+  allocator.deallocate(slot,sizeof(Slot));
+}
+
+template < class T, class Alloc >
+T* PersistentUnrolledList<T,Alloc>::createKeys(void) {
+  // one more than a block holds, so a block may overflow before a split
+  T* keys = (T*)allocator.allocate((blockSize+1) * sizeof(T));
+  try {
+    uninitialized_default_construct_n(keys,blockSize+1);
+  } catch(...) {
+    allocator.deallocate(keys,(blockSize+1) * sizeof(T));
+    throw;
+  }
+  return keys;
+}
+
+template < class T, class Alloc >
+void PersistentUnrolledList<T,Alloc>::destroyKeys(T* keys) {
+  destroy_n(keys,blockSize+1);
+  allocator.deallocate(keys,(blockSize+1) * sizeof(T));
+}
+
+template < class T, class Alloc >
+void PersistentUnrolledList<T,Alloc>::addVersion(Slot* slot, T* keys,
+						 int size) {
+  assert(slot->count < SLOT_SIZE);
+  slot->times[slot->count] = getPresent();
+  slot->sizes[slot->count] = size;
+  slot->keys[slot->count] = keys;
+  // publish the version once it is written
+  atomicStore(&slot->count,slot->count+1);
+}
+
+template < class T, class Alloc >
+typename PersistentUnrolledList<T,Alloc>::Slot*
+PersistentUnrolledList<T,Alloc>::getPresentSlot(const Ref& ref) {
+  int present = getPresent();
+  Slot* slot = ref.slot;
+  int latest = slot->count-1;
+  // versions from the present aren't visible to readers
+  if(slot->times[latest] == present)
+    return slot;
+  T* keys = createKeys();
+  copy(slot->keys[latest],slot->keys[latest]+slot->sizes[latest],keys);
+  if(slot->count == SLOT_SIZE) {
+    // the log is full, so a fresh slot replaces it from the present on
+    slot = createSlot();
+    PSLIterator<Ref,Alloc> old = index.find(ref,present);
+    assert((*old).slot == ref.slot);
+    old.remove();
+    index.insert(Ref(ref.low,slot));
+  }
+  addVersion(slot,keys,ref.slot->sizes[latest]);
+  return slot;
+}
+
+template < class T, class Alloc >
+int PersistentUnrolledList<T,Alloc>::insert(const T& data) {
+  int present = getPresent();
+  if(index.empty(present)) {
+    Slot* slot = createSlot();
+    T* keys = createKeys();
+    keys[0] = data;
+    addVersion(slot,keys,1);
+    index.insert(Ref(data,slot));
+    return 0;
+  }
+  Ref ref = *findRef(data,present);
+  // check for a duplicate before copying the block
+  const Slot* latest = ref.slot;
+  int size = latest->sizes[latest->count-1];
+  const T* found = latest->keys[latest->count-1];
+  int position = BlockSearch<T>::countLess(found,size,data);
+  if(position < size && !(data < found[position]))
+    throw "Tried to insert non-unique datum";
+  Slot* slot = getPresentSlot(ref);
+  if(data < ref.low) {
+    // before every entry, so the first entry's low comes down to it,
+    // keeping the data of a block at or after its low
+    PSLIterator<Ref,Alloc> first = index.find(ref,present);
+    assert((*first).slot == slot);
+    first.remove();
+    index.insert(Ref(data,slot));
+  }
+  T* keys = slot->keys[slot->count-1];
+  copy_backward(keys+position,keys+size,keys+size+1);
+  keys[position] = data;
+  ++size;
+  if(size > blockSize) {
+    // split off the upper half into a block of its own
+    int half = size/2;
+    Slot* upper = createSlot();
+    T* upper_keys = createKeys();
+    copy(keys+half,keys+size,upper_keys);
+    addVersion(upper,upper_keys,size-half);
+    index.insert(Ref(upper_keys[0],upper));
+    size = half;
+  }
+  slot->sizes[slot->count-1] = size;
+  return 0;
+}
+
+template < class T, class Alloc >
+int PersistentUnrolledList<T,Alloc>::remove(const T& data) {
+  int present = getPresent();
+  if(index.empty(present))
+    throw "Tried to remove missing datum";
+  Ref ref = *findRef(data,present);
+  const Slot* latest = ref.slot;
+  int size = latest->sizes[latest->count-1];
+  const T* found = latest->keys[latest->count-1];
+  int position = BlockSearch<T>::countLess(found,size,data);
+  if(position == size || data < found[position])
+    throw "Tried to remove missing datum";
+  Slot* slot = getPresentSlot(ref);
+  T* keys = slot->keys[slot->count-1];
+  copy(keys+position+1,keys+size,keys+position);
+  --size;
+  slot->sizes[slot->count-1] = size;
+  if(size == 0) {
+    // an empty block leaves the index, though its slot may have
+    // been replaced
+    PSLIterator<Ref,Alloc> entry = index.find(Ref(ref.low,slot),present);
+    assert((*entry).slot == slot);
+    entry.remove();
+  }
+  return 0;
+}
+
+template < class T, class Alloc >
+bool PersistentUnrolledList<T,Alloc>::contains(const T& toFind, int t) {
+  const Slot* slot = (*findRef(toFind,t)).slot;
+  // an empty list has no entries
+  if(slot == NULL)
+    return false;
+  int version = getVersion(slot,t);
+  assert(version >= 0);
+  int size = slot->sizes[version];
+  const T* keys = slot->keys[version];
+  int position = BlockSearch<T>::countLess(keys,size,toFind);
+  return position < size && !(toFind < keys[position]);
+}
+
+template < class T, class Alloc >
+template <class OutputIterator>
+OutputIterator PersistentUnrolledList<T,Alloc>::range(const T& lo,
+						      const T& hi,
+						      int t,
+						      OutputIterator out) {
+  PSLIterator<Ref,Alloc> end = index.end(t);
+  for(PSLIterator<Ref,Alloc> ref = findRef(lo,t); ref != end; ++ref) {
+    const Slot* slot = (*ref).slot;
+    int version = getVersion(slot,t);
+    assert(version >= 0);
+    int size = slot->sizes[version];
+    const T* keys = slot->keys[version];
+    for(int i = BlockSearch<T>::countLess(keys,size,lo); i < size; ++i) {
+      if(hi < keys[i])
+	return out;
+      *out = keys[i];
+      ++out;
+    }
+  }
+  return out;
+}
+
+#endif
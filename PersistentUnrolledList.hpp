@@ -0,0 +1,326 @@
+//-*- mode: c++ -*-////////////////////////////////////////////////////////////
+//                       Copyright (c) 2011 - 2012 by                        //
+//                                Simon Pratt                                //
+//                           (All rights reserved)                           //
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// FILE:    PersistentUnrolledList.hpp                                       //
+//                                                                           //
+// MODULE:  Persistent Skip List                                             //
+//                                                                           //
+// PURPOSE: Implements a persistent unrolled skip list, which keeps data in  //
+//          sorted blocks of many keys, indexed by a persistent skip list    //
+//          of the blocks, so that a search follows a few long links and     //
+//          then scans one block instead of following a link per key.        //
+//                                                                           //
+// NOTES:   Each block is versioned as a whole: the first change to a block  //
+//          in a version copies it, and later changes in the same version    //
+//          are made in place.  A block holds at most blockSize keys, and    //
+//          is split in two when it overflows.  Blocks are never merged,     //
+//          but an empty block leaves the index.  Blocks and slots are       //
+//          allocated from the Alloc allocator policy, as the index's nodes  //
+//          are.                                                             //
+//                                                                           //
+//          Blocks of integral keys, signed or unsigned and of any width,    //
+//          are scanned with SSE2 or AVX2 compares when the compiler targets //
+//          them, other types with a binary search.  64 bit keys need SSE4.2 //
+//          or AVX2.                                                         //
+//                                                                           //
+//          As with PersistentSkipList, one writer may change the present    //
+//          while readers search times before getPresent().                  //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// Public Variable:                     Description:                         //
+// ----------------                     ------------                         //
+// BlockSearch                          Counts the keys of a sorted block    //
+//                                      less than a datum.                   //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+//                             Public Methods:                               //
+//                                                                           //
+// insert(const T&)               - inserts a datum at present               //
+// remove(const T&)               - removes a datum at present               //
+// contains(const T&,int)         - finds a datum at a time                  //
+// range(const T&,const T&,int,o) - copies the data in a range at a time     //
+// incTime()                      - ends the present version                 //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+#ifndef PERSISTENTUNROLLEDLIST_HPP
+#define PERSISTENTUNROLLEDLIST_HPP
+
+#include <vector>
+#include <algorithm>
+#include <memory>
+#include <limits>
+#include <type_traits>
+#include <cassert>
+#include <cstddef>
+
+#include "PersistentSkipList.hpp"
+
+namespace persistent_skip_list {
+
+  /////////////////////////////////////////////////////////////////////////////
+  // BlockSearch interface                                                   //
+  /////////////////////////////////////////////////////////////////////////////
+  template < class T >
+  class BlockSearch {
+  public:
+    ///////////////////////////////////////////////////////////////////////////
+    //                                                                       //
+    // FUNCTION NAME: countLess                                              //
+    //                                                                       //
+    // PURPOSE:       Counts the keys of a sorted block which are less than  //
+    //                a datum, which is where the datum is or would go.      //
+    //                                                                       //
+    // SECURITY:      public                                                 //
+    //                                                                       //
+    // PARAMETERS                                                            //
+    //   Type/Name:   const T*/keys                                          //
+    //   Description: The sorted keys.                                       //
+    //                                                                       //
+    //   Type/Name:   int/count                                              //
+    //   Description: The number of keys.                                    //
+    //                                                                       //
+    //   Type/Name:   const T&/datum                                         //
+    //   Description: The datum to compare against.                          //
+    //                                                                       //
+    // RETURN:                                                               //
+    //   Type/Name:   int                                                    //
+    //   Description: The number of keys less than datum.                    //
+    //                                                                       //
+    // NOTES:         Compares several integral keys at once, and searches   //
+    //                other keys in halves.                                  //
+    //                                                                       //
+    ///////////////////////////////////////////////////////////////////////////
+    static int countLess(const T* keys, int count, const T& datum);
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Kindly ignore my private parts                                        //
+    ///////////////////////////////////////////////////////////////////////////
+  private:
+    // a binary search, for keys which can't be compared several at once
+    static int countLess(const T* keys, int count, const T& datum,
+			 false_type);
+    // SIMD compares a group of integral keys at a time
+    static int countLess(const T* keys, int count, const T& datum,
+			 true_type);
+  };
+
+  /////////////////////////////////////////////////////////////////////////////
+  // PersistentUnrolledList interface                                        //
+  /////////////////////////////////////////////////////////////////////////////
+  template < class T, class Alloc = HeapAllocator >
+  class PersistentUnrolledList {
+  public:
+    ///////////////////////////////////////////////////////////////////////////
+    //                                                                       //
+    // FUNCTION NAME: PersistentUnrolledList                                 //
+    //                                                                       //
+    // PURPOSE:       Empty constructor                                      //
+    //                                                                       //
+    // SECURITY:      public                                                 //
+    //                                                                       //
+    // PARAMETERS                                                            //
+    //   Type/Name:   int/blockSize                                          //
+    //   Description: The most keys a block holds.                           //
+    //                                                                       //
+    //   Type/Name:   int/nodeSize                                           //
+    //   Description: The node size of the index of blocks.                  //
+    //                                                                       //
+    // RETURN:        Void.                                                  //
+    //                                                                       //
+    // NOTES:         Blocks of 16 to 64 keys fit a few cache lines.         //
+    //                                                                       //
+    ///////////////////////////////////////////////////////////////////////////
+    PersistentUnrolledList(int blockSize=32, int nodeSize=3);
+
+    ///////////////////////////////////////////////////////////////////////////
+    //                                                                       //
+    // FUNCTION NAME: ~PersistentUnrolledList                                //
+    //                                                                       //
+    // PURPOSE:       Destructor.                                            //
+    //                                                                       //
+    // SECURITY:      public                                                 //
+    //                                                                       //
+    // PARAMETERS                                                            //
+    //   Type/Name:   Void.                                                  //
+    //   Description: None.                                                  //
+    //                                                                       //
+    // RETURN:        Void.                                                  //
+    //                                                                       //
+    // NOTES:         Frees every version of every block.                    //
+    //                                                                       //
+    ///////////////////////////////////////////////////////////////////////////
+    ~PersistentUnrolledList(void);
+
+    int getPresent(void) const;
+    void incTime(void);
+
+    ///////////////////////////////////////////////////////////////////////////
+    //                                                                       //
+    // FUNCTION NAME: insert                                                 //
+    //                                                                       //
+    // PURPOSE:       Inserts a datum into the present version.              //
+    //                                                                       //
+    // SECURITY:      public                                                 //
+    //                                                                       //
+    // PARAMETERS                                                            //
+    //   Type/Name:   const T&/data                                          //
+    //   Description: The datum to insert.                                   //
+    //                                                                       //
+    // RETURN:                                                               //
+    //   Type/Name:   int                                                    //
+    //   Description: 0 on success.                                          //
+    //                                                                       //
+    // NOTES:         Throws if the datum is already present.                //
+    //                                                                       //
+    ///////////////////////////////////////////////////////////////////////////
+    int insert(const T& data);
+
+    ///////////////////////////////////////////////////////////////////////////
+    //                                                                       //
+    // FUNCTION NAME: remove                                                 //
+    //                                                                       //
+    // PURPOSE:       Removes a datum from the present version.              //
+    //                                                                       //
+    // SECURITY:      public                                                 //
+    //                                                                       //
+    // PARAMETERS                                                            //
+    //   Type/Name:   const T&/data                                          //
+    //   Description: The datum to remove.                                   //
+    //                                                                       //
+    // RETURN:                                                               //
+    //   Type/Name:   int                                                    //
+    //   Description: 0 on success.                                          //
+    //                                                                       //
+    // NOTES:         Throws if the datum is not present.                    //
+    //                                                                       //
+    ///////////////////////////////////////////////////////////////////////////
+    int remove(const T& data);
+
+    ///////////////////////////////////////////////////////////////////////////
+    //                                                                       //
+    // FUNCTION NAME: contains                                               //
+    //                                                                       //
+    // PURPOSE:       Checks whether a datum is in the list at a time.       //
+    //                                                                       //
+    // SECURITY:      public                                                 //
+    //                                                                       //
+    // PARAMETERS                                                            //
+    //   Type/Name:   const T&/toFind                                        //
+    //   Description: The datum to find.                                     //
+    //                                                                       //
+    //   Type/Name:   int/t                                                  //
+    //   Description: The time at which to search.                           //
+    //                                                                       //
+    // RETURN:                                                               //
+    //   Type/Name:   bool                                                   //
+    //   Description: True if the datum is in the list at time t.            //
+    //                                                                       //
+    // NOTES:         Searches the index for the block, then the block.      //
+    //                                                                       //
+    ///////////////////////////////////////////////////////////////////////////
+    bool contains(const T& toFind, int t);
+
+    ///////////////////////////////////////////////////////////////////////////
+    //                                                                       //
+    // FUNCTION NAME: range                                                  //
+    //                                                                       //
+    // PURPOSE:       Copies every datum from lo to hi inclusive at a time,  //
+    //                in order.                                              //
+    //                                                                       //
+    // SECURITY:      public                                                 //
+    //                                                                       //
+    // PARAMETERS                                                            //
+    //   Type/Name:   const T&/lo                                            //
+    //   Description: The least datum to copy.                               //
+    //                                                                       //
+    //   Type/Name:   const T&/hi                                            //
+    //   Description: The greatest datum to copy.                            //
+    //                                                                       //
+    //   Type/Name:   int/t                                                  //
+    //   Description: The time at which to search.                           //
+    //                                                                       //
+    //   Type/Name:   OutputIterator/out                                     //
+    //   Description: Where to copy the data.                                //
+    //                                                                       //
+    // RETURN:                                                               //
+    //   Type/Name:   OutputIterator                                         //
+    //   Description: The end of the copied data.                            //
+    //                                                                       //
+    // NOTES:         As PersistentSkipList::range.                          //
+    //                                                                       //
+    ///////////////////////////////////////////////////////////////////////////
+    template <class OutputIterator>
+    OutputIterator range(const T& lo, const T& hi, int t, OutputIterator out);
+
+    ///////////////////////////////////////////////////////////////////////////
+    // Kindly ignore my private parts                                        //
+    ///////////////////////////////////////////////////////////////////////////
+  private:
+    static const int SLOT_SIZE = 4;
+
+    // The versions of a block, a fixed log of SLOT_SIZE entries so it
+    // never moves under readers, of which count are published.  A full
+    // slot is replaced in the index by a fresh one, as a full ListNode
+    // is copied.
+    struct Slot {
+      int count;
+      int times[SLOT_SIZE];
+      int sizes[SLOT_SIZE];
+      T* keys[SLOT_SIZE];
+    };
+
+    // An entry of the index.  Every datum from low up to the low of the
+    // next entry is in the slot's block.  A datum before every entry
+    // goes in the first block, lowering its low.
+    class Ref {
+    public:
+      Ref();
+      Ref(const T& low, Slot* slot);
+      bool operator<(const Ref& other) const;
+      bool operator>(const Ref& other) const;
+      bool operator<=(const Ref& other) const;
+      bool operator>=(const Ref& other) const;
+      bool operator==(const Ref& other) const;
+      bool operator!=(const Ref& other) const;
+      T low;
+      Slot* slot;
+    };
+
+    const int blockSize;
+    // where blocks and slots are allocated
+    Alloc allocator;
+    PersistentSkipList<Ref,Alloc> index;
+    // every slot ever created, for freeing their blocks
+    vector< Slot* > slots;
+
+    // the index entry whose block holds the datum at time t, or the
+    // end if the list is empty
+    PSLIterator<Ref,Alloc> findRef(const T& datum, int t);
+    // the latest version of a slot at or before time t
+    int getVersion(const Slot* slot, int t) const;
+    // a slot with a version at present, which may be changed in place,
+    // replacing the entry's slot in the index if its log is full
+    Slot* getPresentSlot(const Ref& ref);
+    // blocks and slots come from the allocator, and go back to it
+    Slot* createSlot(void);
+    void destroySlot(Slot* slot);
+    T* createKeys(void);
+    void destroyKeys(T* keys);
+    // publishes a version of a block to a slot which isn't full
+    void addVersion(Slot* slot, T* keys, int size);
+
+    // the list owns its blocks, so can't be copied
+    PersistentUnrolledList(const PersistentUnrolledList<T,Alloc>&);
+    PersistentUnrolledList<T,Alloc>& operator=(
+      const PersistentUnrolledList<T,Alloc>&);
+  };
+}
+
+#include "PersistentUnrolledList.cpp"
+
+#endif
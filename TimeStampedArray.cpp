@@ -15,6 +15,7 @@
 #define TIMESTAMPEDARRAY_CPP
 
 #include <ostream>
+#include <new>
 #include "TimeStampedArray.hpp"
 
 using namespace timestamped_array;
@@ -23,6 +24,7 @@ using namespace std;
 template<class T>
 TimeStampedArray<T>::TimeStampedArray(int t, int s)
   : _LOCKED(false),
+    _OWNS_DATA(true),
     time(t),
     size(s),
     data(new T[s]())
@@ -32,6 +34,7 @@ TimeStampedArray<T>::TimeStampedArray(int t, int s)
 template<class T>
 TimeStampedArray<T>::TimeStampedArray(int t, int s, const TimeStampedArray<T>& old_tsa)
   : _LOCKED(false),
+    _OWNS_DATA(true),
     time(t),
     size(s),
     data(new T[s])
@@ -41,9 +44,81 @@ TimeStampedArray<T>::TimeStampedArray(int t, int s, const TimeStampedArray<T>& o
     setElement(i,old_tsa.getElement(i));
 }
 
+template<class T>
+TimeStampedArray<T>::TimeStampedArray(int t, int s, T* storage)
+  : _LOCKED(false),
+    _OWNS_DATA(false),
+    time(t),
+    size(s),
+    data(storage)
+{
+  // construct the elements in place
+  for(int i = 0; i < size; ++i)
+    new (&data[i]) T();
+}
+
+template<class T>
+TimeStampedArray<T>::TimeStampedArray(int t, int s, T* storage,
+				      const TimeStampedArray<T>& old_tsa)
+  : _LOCKED(false),
+    _OWNS_DATA(false),
+    time(t),
+    size(s),
+    data(storage)
+{
+  // copy construct the old data in place
+  int i = 0;
+  for(; i < old_tsa.getSize() && i < size; ++i)
+    new (&data[i]) T(old_tsa.getElement(i));
+  for(; i < size; ++i)
+    new (&data[i]) T();
+}
+
+template<class T>
+TimeStampedArray<T>::TimeStampedArray(TimeStampedArray<T>&& other)
+  : _LOCKED(other._LOCKED),
+    _OWNS_DATA(other._OWNS_DATA),
+    time(other.time),
+    size(other.size),
+    data(other.data)
+{
+  // an empty array in caller storage destroys nothing
+  other._OWNS_DATA = false;
+  other.size = 0;
+  other.data = nullptr;
+}
+
+template<class T>
+TimeStampedArray<T>&
+TimeStampedArray<T>::operator=(TimeStampedArray<T>&& other) {
+  if(this == &other)
+    return *this;
+  destroyData();
+  _LOCKED = other._LOCKED;
+  _OWNS_DATA = other._OWNS_DATA;
+  time = other.time;
+  size = other.size;
+  data = other.data;
+  other._OWNS_DATA = false;
+  other.size = 0;
+  other.data = nullptr;
+  return *this;
+}
+
 template<class T>
 TimeStampedArray<T>::~TimeStampedArray() {
-  delete[] data;
+  destroyData();
+}
+
+template<class T>
+void TimeStampedArray<T>::destroyData() {
+  if(_OWNS_DATA) {
+    delete[] data;
+    return;
+  }
+  // the storage belongs to the caller, only the elements are ours
+  for(int i = 0; i < size; ++i)
+    data[i].~T();
 }
 
 template<class T>
@@ -28,6 +28,8 @@
 //                                              s is the size                //
 // TimeStampedArray(int t, TimeStampedArray&) - t is the timestamp           //
 //                                              the reference is copied      //
+// TimeStampedArray(int t, int s, T* storage) - as above, with elements      //
+//                                              stored in the given storage  //
 //                                                                           //
 //                             Public Methods:                               //
 //                                                                           //
@@ -97,6 +99,57 @@ namespace timestamped_array {
     ///////////////////////////////////////////////////////////////////////////
     TimeStampedArray(int t, int s, const TimeStampedArray<T>& old_tsa);
 
+    ///////////////////////////////////////////////////////////////////////////
+    //                                                                       //
+    // FUNCTION NAME: TimeStampedArray                                       //
+    //                                                                       //
+    // PURPOSE:       Constructors which store the elements in storage       //
+    //                provided by the caller, instead of allocating it.      //
+    //                                                                       //
+    // SECURITY:      public                                                 //
+    //                                                                       //
+    // PARAMETERS                                                            //
+    //   Type/Name:   int/t                                                  //
+    //   Description: The timestamp to associate with the array.             //
+    //                                                                       //
+    //   Type/Name:   int/s                                                  //
+    //   Description: The size of the array.                                 //
+    //                                                                       //
+    //   Type/Name:   T*/storage                                             //
+    //   Description: Uninitialized memory for s elements, which must        //
+    //                outlive the array.                                     //
+    //                                                                       //
+    //   Type/Name:   TimeStampedArray<T>/old_tsa                            //
+    //   Description: An optional existing TSA to copy.                      //
+    //                                                                       //
+    // NOTES:         The destructor destroys the elements, but leaves the   //
+    //                storage to the caller.                                 //
+    //                                                                       //
+    ///////////////////////////////////////////////////////////////////////////
+    TimeStampedArray(int t, int s, T* storage);
+    TimeStampedArray(int t, int s, T* storage,
+		     const TimeStampedArray<T>& old_tsa);
+
+    ///////////////////////////////////////////////////////////////////////////
+    //                                                                       //
+    // FUNCTION NAME: TimeStampedArray                                       //
+    //                                                                       //
+    // PURPOSE:       Move constructor and assignment, which take the        //
+    //                elements of another array without copying them.        //
+    //                                                                       //
+    // SECURITY:      public                                                 //
+    //                                                                       //
+    // PARAMETERS                                                            //
+    //   Type/Name:   TimeStampedArray<T>&&/other                            //
+    //   Description: The array to move from, which is left empty.           //
+    //                                                                       //
+    // NOTES:         An array in caller storage still leaves the storage to //
+    //                the caller.                                            //
+    //                                                                       //
+    ///////////////////////////////////////////////////////////////////////////
+    TimeStampedArray(TimeStampedArray<T>&& other);
+    TimeStampedArray<T>& operator=(TimeStampedArray<T>&& other);
+
     ///////////////////////////////////////////////////////////////////////////
     //                                                                       //
     // FUNCTION NAME: ~TimeStampedArray                                      //
@@ -244,9 +297,18 @@ namespace timestamped_array {
     ///////////////////////////////////////////////////////////////////////////
   private:
     bool _LOCKED;
+    bool _OWNS_DATA;
     int time;
     int size;
     T* data;
+
+    // destroys the elements, and frees them if they are ours
+    void destroyData();
+
+  public:
+    // copying would share the data, use the copying constructors instead
+    TimeStampedArray(const TimeStampedArray<T>&) = delete;
+    TimeStampedArray<T>& operator=(const TimeStampedArray<T>&) = delete;
   };
 }
 
@@ -0,0 +1,537 @@
+///////////////////////////////////////////////////////////////////////////////
+//                       Copyright (c) 2011 - 2012 by                        //
+//                                Simon Pratt                                //
+//                           (All rights reserved)                           //
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// FILE:    bench_persistent_skiplist.cpp                                    //
+//                                                                           //
+// MODULE:  Persistent Skip List                                             //
+//                                                                           //
+// NOTES:   Measures insert, find, scan, range and remove throughput and     //
+//          latency for list sizes, version counts and key distributions     //
+//          given on the command line, finding a key at a hundred versions   //
+//          by separate finds and by findAcrossVersions, and insert and      //
+//          find of the unrolled list for comparison.  Run with -h for       //
+//          usage.                                                           //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <iterator>
+#include <new>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <time.h>
+
+#include "../PersistentSkipList.hpp"
+#include "../PersistentUnrolledList.hpp"
+
+using namespace persistent_skip_list;
+
+///////////////////////////////////////////////////////////////////////////////
+// Memory accounting                                                         //
+///////////////////////////////////////////////////////////////////////////////
+
+// every allocation is prefixed with its size so live bytes can be tracked
+static size_t live_bytes = 0;
+static const size_t HEADER = 16;
+
+#if __cplusplus < 201103L
+#define BENCH_THROW throw(std::bad_alloc)
+#define BENCH_NOTHROW throw()
+#else
+#define BENCH_THROW
+#define BENCH_NOTHROW noexcept
+#endif
+
+// keep the replacements out of line so the compiler pairs malloc and free
+#ifdef __GNUC__
+#define BENCH_NOINLINE __attribute__((noinline))
+#else
+#define BENCH_NOINLINE
+#endif
+
+BENCH_NOINLINE void* operator new(size_t bytes) BENCH_THROW {
+  char* block = (char*)malloc(bytes + HEADER);
+  if(block == NULL)
+    throw std::bad_alloc();
+  *(size_t*)block = bytes;
+  live_bytes += bytes;
+  return block + HEADER;
+}
+
+void* operator new[](size_t bytes) BENCH_THROW {
+  return operator new(bytes);
+}
+
+BENCH_NOINLINE void operator delete(void* p) BENCH_NOTHROW {
+  if(p == NULL)
+    return;
+  char* block = (char*)p - HEADER;
+  live_bytes -= *(size_t*)block;
+  free(block);
+}
+
+void operator delete[](void* p) BENCH_NOTHROW {
+  operator delete(p);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Random numbers and key distributions                                      //
+///////////////////////////////////////////////////////////////////////////////
+
+// xorshift128, so runs are reproducible for a given seed
+class Random {
+public:
+  Random(unsigned int seed) : x(123456789), y(362436069), z(521288629),
+			      w(88675123 ^ seed) {
+    for(int i = 0; i < 16; ++i)
+      next();
+  }
+  unsigned int next() {
+    unsigned int t = x ^ (x << 11);
+    x = y; y = z; z = w;
+    return w = w ^ (w >> 19) ^ (t ^ (t >> 8));
+  }
+  // uniform in [0,n)
+  unsigned int below(unsigned int n) {
+    return (unsigned int)(uniform() * n);
+  }
+  // uniform in [0,1)
+  double uniform() {
+    return next() / 4294967296.0;
+  }
+private:
+  unsigned int x, y, z, w;
+};
+
+// Zipfian ranks in [0,n) after Gray et al., as used by YCSB
+class Zipfian {
+public:
+  Zipfian(unsigned int n, double theta = 0.99)
+    : items(n), theta(theta), zetan(zeta(n,theta)),
+      alpha(1.0 / (1.0 - theta)),
+      eta((1.0 - pow(2.0 / n, 1.0 - theta)) /
+	  (1.0 - zeta(2,theta) / zetan))
+  {
+  }
+  unsigned int next(Random& random) {
+    double u = random.uniform();
+    double uz = u * zetan;
+    if(uz < 1.0)
+      return 0;
+    if(uz < 1.0 + pow(0.5,theta))
+      return 1;
+    unsigned int rank =
+      (unsigned int)(items * pow(eta * u - eta + 1.0, alpha));
+    return rank < items ? rank : items - 1;
+  }
+private:
+  static double zeta(unsigned int n, double theta) {
+    double sum = 0;
+    for(unsigned int i = 1; i <= n; ++i)
+      sum += 1.0 / pow((double)i, theta);
+    return sum;
+  }
+  unsigned int items;
+  double theta, zetan, alpha, eta;
+};
+
+enum Distribution { UNIFORM, SEQUENTIAL, ZIPFIAN };
+
+const char* distributionName(Distribution d) {
+  switch(d) {
+  case UNIFORM:    return "uniform";
+  case SEQUENTIAL: return "sequential";
+  default:         return "zipfian";
+  }
+}
+
+// Picks keys to query from the n inserted keys in the given distribution
+class KeyChooser {
+public:
+  KeyChooser(Distribution d, const vector<int>& keys, Random& random)
+    : dist(d), keys(keys), random(random), zipf(keys.size()), cursor(0)
+  {
+  }
+  int next() {
+    switch(dist) {
+    case UNIFORM:
+      return keys[random.below(keys.size())];
+    case SEQUENTIAL:
+      cursor = (cursor + 1) % keys.size();
+      return keys[cursor];
+    default:
+      // hot ranks map to keys in insertion order, not key order
+      return keys[zipf.next(random)];
+    }
+  }
+private:
+  Distribution dist;
+  const vector<int>& keys;
+  Random& random;
+  Zipfian zipf;
+  size_t cursor;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// Timing and reporting                                                      //
+///////////////////////////////////////////////////////////////////////////////
+
+double now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+void printHeader() {
+  cout << left
+       << setw(8)  << "op"
+       << setw(12) << "dist"
+       << right
+       << setw(10) << "n"
+       << setw(10) << "versions"
+       << setw(10) << "ops"
+       << setw(14) << "ops/sec"
+       << setw(10) << "p50(us)"
+       << setw(10) << "p90(us)"
+       << setw(10) << "p99(us)"
+       << setw(10) << "max(us)"
+       << endl;
+}
+
+// Prints throughput and latency percentiles of one measured operation,
+// where latencies are in seconds and total is the wall time of the run
+void report(const char* op, Distribution d, size_t n, int versions,
+	    vector<double>& latencies, double total) {
+  if(latencies.empty())
+    return;
+  sort(latencies.begin(), latencies.end());
+  size_t count = latencies.size();
+  cout << left
+       << setw(8)  << op
+       << setw(12) << distributionName(d)
+       << right << fixed
+       << setw(10) << n
+       << setw(10) << versions
+       << setw(10) << count
+       << setw(14) << setprecision(0) << count / total
+       << setprecision(3)
+       << setw(10) << latencies[count / 2] * 1e6
+       << setw(10) << latencies[count * 9 / 10] * 1e6
+       << setw(10) << latencies[count * 99 / 100] * 1e6
+       << setw(10) << latencies[count - 1] * 1e6
+       << endl;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Benchmarks                                                                //
+///////////////////////////////////////////////////////////////////////////////
+
+template <class Alloc>
+void benchmark(size_t n, int versions, Distribution d, size_t ops,
+	       unsigned int seed) {
+  Random random(seed);
+  // the keys to insert in insertion order
+  vector<int> keys(n);
+  for(size_t i = 0; i < n; ++i)
+    keys[i] = (int)i;
+  if(d != SEQUENTIAL)
+    for(size_t i = n - 1; i > 0; --i)
+      swap(keys[i], keys[random.below(i + 1)]);
+
+  size_t bytes_before = live_bytes;
+  PersistentSkipList<int,Alloc>* psl = new PersistentSkipList<int,Alloc>();
+  vector<double> latencies;
+  latencies.reserve(max(n, ops));
+
+  // insert, spreading the keys evenly over the versions
+  size_t per_version = (n + versions - 1) / versions;
+  double start = now();
+  for(size_t i = 0; i < n; ++i) {
+    if(i > 0 && i % per_version == 0)
+      psl->incTime();
+    double before = now();
+    psl->insert(keys[i]);
+    latencies.push_back(now() - before);
+  }
+  report("insert", d, n, versions, latencies, now() - start);
+  size_t bytes = live_bytes - bytes_before;
+
+  // bulk load the same keys in sorted order into a fresh list
+  vector<int> sorted_keys(keys);
+  sort(sorted_keys.begin(), sorted_keys.end());
+  PersistentSkipList<int,Alloc>* loaded = new PersistentSkipList<int,Alloc>();
+  latencies.clear();
+  start = now();
+  loaded->bulkLoad(sorted_keys.begin(), sorted_keys.end());
+  latencies.push_back(now() - start);
+  report("load", d, n, 1, latencies, now() - start);
+  cout << "    loaded " << setprecision(0)
+       << n / max(1e-9, latencies[0]) << " elements/sec" << endl;
+  delete loaded;
+
+  // insert the same keys a version's worth at a time into a fresh list
+  PersistentSkipList<int,Alloc>* batched = new PersistentSkipList<int,Alloc>();
+  latencies.clear();
+  start = now();
+  for(size_t i = 0; i < n; i += per_version) {
+    if(i > 0)
+      batched->incTime();
+    double before = now();
+    batched->insertBatch(keys.begin() + i,
+			 keys.begin() + min(n, i + per_version));
+    latencies.push_back(now() - before);
+  }
+  report("batch", d, n, versions, latencies, now() - start);
+  cout << "    batch inserted " << setprecision(0)
+       << n / max(1e-9, now() - start) << " elements/sec" << endl;
+  delete batched;
+  int present = psl->getPresent();
+
+  // find at versions chosen uniformly over the history
+  KeyChooser chooser(d, keys, random);
+  latencies.clear();
+  start = now();
+  for(size_t i = 0; i < ops; ++i) {
+    int key = chooser.next();
+    int t = random.below(present + 1);
+    double before = now();
+    PSLIterator<int,Alloc> found = psl->find(key, t);
+    latencies.push_back(now() - before);
+  }
+  report("find", d, n, versions, latencies, now() - start);
+
+  // one key at a hundred versions spread over the history, first by a
+  // find at each version, then by one search across all of them
+  vector<int> times;
+  for(int i = 0; i < 100; ++i)
+    times.push_back((int)((long)i * present / 100));
+  size_t queries = max((size_t)1, ops / 100);
+  vector<int> query_keys(queries);
+  for(size_t i = 0; i < queries; ++i)
+    query_keys[i] = chooser.next();
+  latencies.clear();
+  start = now();
+  for(size_t i = 0; i < queries; ++i) {
+    double before = now();
+    for(size_t j = 0; j < times.size(); ++j)
+      PSLIterator<int,Alloc> found = psl->find(query_keys[i], times[j]);
+    latencies.push_back(now() - before);
+  }
+  double finds = now() - start;
+  report("mfind", d, n, versions, latencies, finds);
+  vector< PSLIterator<int,Alloc> > across;
+  across.reserve(times.size());
+  latencies.clear();
+  start = now();
+  for(size_t i = 0; i < queries; ++i) {
+    across.clear();
+    double before = now();
+    psl->findAcrossVersions(query_keys[i], times, back_inserter(across));
+    latencies.push_back(now() - before);
+  }
+  report("across", d, n, versions, latencies, now() - start);
+  cout << "    " << setprecision(2) << finds / max(1e-9, now() - start)
+       << " times as fast as a find per version" << endl;
+
+  // full scans of versions chosen uniformly over the history
+  latencies.clear();
+  size_t scanned = 0;
+  size_t scans = max((size_t)1, min((size_t)100, ops * 10 / (n + 1)));
+  start = now();
+  for(size_t i = 0; i < scans; ++i) {
+    int t = random.below(present + 1);
+    double before = now();
+    PSLIterator<int,Alloc> end = psl->end(t);
+    for(PSLIterator<int,Alloc> it = psl->begin(t); it != end; ++it)
+      ++scanned;
+    latencies.push_back(now() - before);
+  }
+  report("scan", d, n, versions, latencies, now() - start);
+  cout << "    scanned " << setprecision(0)
+       << scanned / max(1e-9, (now() - start)) << " elements/sec" << endl;
+
+  // ranges of about a hundred keys at versions chosen uniformly over the
+  // history
+  latencies.clear();
+  scanned = 0;
+  vector<int> in_range;
+  start = now();
+  for(size_t i = 0; i < ops; ++i) {
+    int key = chooser.next();
+    int t = random.below(present + 1);
+    in_range.clear();
+    double before = now();
+    psl->range(key, key + 99, t, back_inserter(in_range));
+    latencies.push_back(now() - before);
+    scanned += in_range.size();
+  }
+  report("range", d, n, versions, latencies, now() - start);
+  cout << "    ranged " << setprecision(0)
+       << scanned / max(1e-9, (now() - start)) << " elements/sec" << endl;
+
+  // remove distinct keys at a new version
+  psl->incTime();
+  present = psl->getPresent();
+  latencies.clear();
+  size_t removes = min(ops, n);
+  vector<int> victims(keys);
+  for(size_t i = 0; i < removes; ++i)
+    swap(victims[i], victims[i + random.below(n - i)]);
+  if(d == SEQUENTIAL)
+    sort(victims.begin(), victims.begin() + removes);
+  start = now();
+  for(size_t i = 0; i < removes; ++i) {
+    double before = now();
+    PSLIterator<int,Alloc> found = psl->find(victims[i], present);
+    found.remove();
+    latencies.push_back(now() - before);
+  }
+  report("remove", d, n, versions, latencies, now() - start);
+
+  cout << "    " << setprecision(1) << (double)bytes / n
+       << " bytes/element after insert, "
+       << (double)(live_bytes - bytes_before) / n
+       << " bytes/element after remove" << endl;
+
+  // the same inserts and finds in an unrolled list
+  bytes_before = live_bytes;
+  PersistentUnrolledList<int,Alloc>* unrolled =
+    new PersistentUnrolledList<int,Alloc>();
+  latencies.clear();
+  start = now();
+  for(size_t i = 0; i < n; ++i) {
+    if(i > 0 && i % per_version == 0)
+      unrolled->incTime();
+    double before = now();
+    unrolled->insert(keys[i]);
+    latencies.push_back(now() - before);
+  }
+  report("uinsert", d, n, versions, latencies, now() - start);
+  bytes = live_bytes - bytes_before;
+  present = unrolled->getPresent();
+  latencies.clear();
+  size_t contained = 0;
+  start = now();
+  for(size_t i = 0; i < ops; ++i) {
+    int key = chooser.next();
+    int t = random.below(present + 1);
+    double before = now();
+    contained += unrolled->contains(key, t);
+    latencies.push_back(now() - before);
+  }
+  report("ufind", d, n, versions, latencies, now() - start);
+  cout << "    " << setprecision(1) << (double)bytes / n
+       << " bytes/element after insert, " << contained << " found" << endl;
+  delete unrolled;
+  delete psl;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Command line                                                              //
+///////////////////////////////////////////////////////////////////////////////
+
+void usage(const char* name) {
+  cout << "Usage: " << name << " [options]" << endl
+       << "  -n SIZES     comma separated list sizes "
+       << "(default 1000,10000,100000)" << endl
+       << "  -v VERSIONS  comma separated version counts "
+       << "(default 1,1000)" << endl
+       << "  -d DISTS     comma separated key distributions, "
+       << "uniform,sequential,zipfian (default all)" << endl
+       << "  -q OPS       finds and removes per run (default 100000)"
+       << endl
+       << "  -s SEED      random seed (default 1)" << endl
+       << "  -a ALLOC     node allocator, heap or arena (default heap)"
+       << endl;
+}
+
+vector<string> split(const string& list) {
+  vector<string> parts;
+  stringstream in(list);
+  string part;
+  while(getline(in, part, ','))
+    parts.push_back(part);
+  return parts;
+}
+
+vector<size_t> parseSizes(const string& list) {
+  vector<string> parts = split(list);
+  vector<size_t> sizes;
+  for(size_t i = 0; i < parts.size(); ++i)
+    sizes.push_back((size_t)atof(parts[i].c_str()));
+  return sizes;
+}
+
+int main(int argc, char** argv) {
+  vector<size_t> sizes = parseSizes("1000,10000,100000");
+  vector<size_t> versions = parseSizes("1,1000");
+  vector<Distribution> dists;
+  dists.push_back(UNIFORM);
+  dists.push_back(SEQUENTIAL);
+  dists.push_back(ZIPFIAN);
+  size_t ops = 100000;
+  unsigned int seed = 1;
+  bool arena = false;
+
+  for(int i = 1; i < argc; ++i) {
+    string arg = argv[i];
+    if(arg == "-h" || i + 1 >= argc) {
+      usage(argv[0]);
+      return arg == "-h" ? 0 : 1;
+    }
+    string value = argv[++i];
+    if(arg == "-n") {
+      sizes = parseSizes(value);
+    } else if(arg == "-v") {
+      versions = parseSizes(value);
+    } else if(arg == "-d") {
+      dists.clear();
+      vector<string> names = split(value);
+      for(size_t j = 0; j < names.size(); ++j) {
+	if(names[j] == "uniform")
+	  dists.push_back(UNIFORM);
+	else if(names[j] == "sequential")
+	  dists.push_back(SEQUENTIAL);
+	else if(names[j] == "zipfian")
+	  dists.push_back(ZIPFIAN);
+	else {
+	  usage(argv[0]);
+	  return 1;
+	}
+      }
+    } else if(arg == "-q") {
+      ops = (size_t)atof(value.c_str());
+    } else if(arg == "-s") {
+      seed = (unsigned int)atoi(value.c_str());
+    } else if(arg == "-a" && (value == "heap" || value == "arena")) {
+      arena = value == "arena";
+    } else {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+
+  printHeader();
+  for(size_t i = 0; i < sizes.size(); ++i)
+    for(size_t j = 0; j < versions.size(); ++j)
+      for(size_t k = 0; k < dists.size(); ++k)
+	if(arena)
+	  benchmark<ArenaAllocator>(sizes[i], (int)versions[j], dists[k],
+				    ops, seed);
+	else
+	  benchmark<HeapAllocator>(sizes[i], (int)versions[j], dists[k],
+				   ops, seed);
+
+  // success
+  return 0;
+}
@@ -0,0 +1,90 @@
+///////////////////////////////////////////////////////////////////////////////
+//                       Copyright (c) 2011 - 2012 by                        //
+//                                Simon Pratt                                //
+//                           (All rights reserved)                           //
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// FILE:    test_allocator.cpp                                               //
+//                                                                           //
+// MODULE:  Persistent Skip List                                             //
+//                                                                           //
+// NOTES:   None.                                                            //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+#include <iostream>
+#include <cassert>
+#include <cstring>
+#include "../PersistentSkipList.hpp"
+
+using namespace std;
+using namespace persistent_skip_list;
+
+int main(int argv, char** argc) {
+  /////////////////////////////////////////////////////////////////////////////
+  // Test HeapAllocator                                                      //
+  /////////////////////////////////////////////////////////////////////////////
+  HeapAllocator heap;
+  char* block = (char*)heap.allocate(100);
+  memset(block, 1, 100);
+  heap.deallocate(block, 100);
+  heap.release();
+  cout << "Heap block allocated and freed." << endl;
+
+  /////////////////////////////////////////////////////////////////////////////
+  // Test ArenaAllocator                                                     //
+  /////////////////////////////////////////////////////////////////////////////
+  ArenaAllocator arena(256);
+  char* a = (char*)arena.allocate(24);
+  char* b = (char*)arena.allocate(24);
+  // blocks are aligned and don't overlap
+  assert((size_t)a % ArenaAllocator::ALIGNMENT == 0);
+  assert((size_t)b % ArenaAllocator::ALIGNMENT == 0);
+  assert(b >= a + 24 || a >= b + 24);
+  memset(a, 1, 24);
+  memset(b, 2, 24);
+  cout << "Arena blocks allocated." << endl;
+
+  // a freed block is reused for the next block of its size class
+  arena.deallocate(a, 24);
+  assert(arena.allocate(20) == a);
+  cout << "Arena block reused." << endl;
+
+  // blocks larger than the chunk still work
+  char* large = (char*)arena.allocate(1000);
+  memset(large, 3, 1000);
+  arena.deallocate(large, 1000);
+  // and the current chunk keeps bump allocating
+  char* c = (char*)arena.allocate(24);
+  assert(c == b + 32);
+  cout << "Large arena block allocated." << endl;
+
+  // everything is freed at once
+  arena.release();
+  cout << "Arena released." << endl;
+
+  /////////////////////////////////////////////////////////////////////////////
+  // Test ArenaAllocator in a skip list                                      //
+  /////////////////////////////////////////////////////////////////////////////
+  PersistentSkipList<int,ArenaAllocator> psl(1);
+  for(int i = 0; i < 100; ++i) {
+    psl.insert(i);
+    if(i % 10 == 0)
+      psl.incTime();
+  }
+  PSLIterator<int,ArenaAllocator> found = psl.find(50, psl.getPresent());
+  assert(*found == 50);
+  found.remove();
+  // find returns the greatest element not after the one searched for
+  assert(*psl.find(50, psl.getPresent()) == 49);
+  assert(*psl.find(50, psl.getPresent() -1) == 50);
+  int count = 0;
+  PSLIterator<int,ArenaAllocator> end = psl.end(psl.getPresent());
+  for(PSLIterator<int,ArenaAllocator> it = psl.begin(psl.getPresent());
+      it != end; ++it)
+    ++count;
+  assert(count == 99);
+  cout << "Arena skip list built and searched." << endl;
+
+  // done
+  return 0;
+}
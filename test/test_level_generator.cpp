@@ -0,0 +1,103 @@
+///////////////////////////////////////////////////////////////////////////////
+//                       Copyright (c) 2011 - 2012 by                        //
+//                                Simon Pratt                                //
+//                           (All rights reserved)                           //
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// FILE:    test_level_generator.cpp                                         //
+//                                                                           //
+// MODULE:  Persistent Skip List                                             //
+//                                                                           //
+// NOTES:   None.                                                            //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+#include <iostream>
+#include <cassert>
+#include "../PersistentSkipList.hpp"
+
+using namespace std;
+using namespace persistent_skip_list;
+
+// a level generator which makes every node the same height
+class FixedLevels {
+public:
+  FixedLevels(int h=2) : height(h) {}
+  int pickHeight(void) { return height; }
+private:
+  int height;
+};
+
+int main(int argv, char** argc) {
+  /////////////////////////////////////////////////////////////////////////////
+  // Test GeometricLevels                                                    //
+  /////////////////////////////////////////////////////////////////////////////
+  cout << "Picking heights from the same seed...";
+  GeometricLevels first(42), second(42), other(43);
+  bool differs = false;
+  for(int i = 0; i < 1000; ++i) {
+    int height = first.pickHeight();
+    assert(height == second.pickHeight());
+    if(height != other.pickHeight())
+      differs = true;
+  }
+  assert(differs);
+  cout << "success." << endl;
+
+  cout << "Picking heights geometrically...";
+  const int PICKS = 100000;
+  for(int bits = 1; bits <= 3; ++bits) {
+    GeometricLevels levels(7,bits);
+    int taller = 0;
+    for(int i = 0; i < PICKS; ++i) {
+      int height = levels.pickHeight();
+      assert(height >= 1 && height <= 32);
+      if(height > 1)
+	++taller;
+    }
+    // a node is taller than one with probability 1/2^bits
+    int expected = PICKS >> bits;
+    assert(taller > expected*9/10 && taller < expected*11/10);
+  }
+  cout << "success." << endl;
+
+  cout << "Capping heights...";
+  GeometricLevels capped(7,1,3);
+  for(int i = 0; i < 1000; ++i)
+    assert(capped.pickHeight() <= 3);
+  // a zero seed is replaced, since it would only ever pick zeros
+  GeometricLevels zero(0), fallback;
+  for(int i = 0; i < 100; ++i)
+    assert(zero.pickHeight() == fallback.pickHeight());
+  cout << "success." << endl;
+
+  /////////////////////////////////////////////////////////////////////////////
+  // Test the level generator of a skip list                                 //
+  /////////////////////////////////////////////////////////////////////////////
+  cout << "Building the same list from the same seed...";
+  PersistentSkipList<int> a(3,GeometricLevels(99)), b(3,GeometricLevels(99));
+  for(int i = 0; i < 500; ++i) {
+    a.insert(i*7 % 500);
+    b.insert(i*7 % 500);
+  }
+  assert(a.getHeight(a.getPresent()) == b.getHeight(b.getPresent()));
+  for(int h = 0; h < a.getHeight(a.getPresent()); ++h) {
+    PSLIterator<int> ia = a.begin(a.getPresent(),h);
+    PSLIterator<int> ib = b.begin(b.getPresent(),h);
+    for(; ia != a.end(a.getPresent()); ++ia, ++ib)
+      assert(*ia == *ib);
+    assert(ib == b.end(b.getPresent()));
+  }
+  cout << "success." << endl;
+
+  cout << "Inserting with a custom level generator...";
+  PersistentSkipList<int,HeapAllocator,FixedLevels> fixed(3,FixedLevels(4));
+  for(int i = 0; i < 100; ++i)
+    fixed.insert(i);
+  assert(fixed.getHeight(fixed.getPresent()) == 4);
+  for(int i = 0; i < 100; ++i)
+    assert(*fixed.find(i,fixed.getPresent()) == i);
+  cout << "success." << endl;
+
+  // success
+  return 0;
+}
@@ -0,0 +1,154 @@
+///////////////////////////////////////////////////////////////////////////////
+//                       Copyright (c) 2011 - 2012 by                        //
+//                                Simon Pratt                                //
+//                           (All rights reserved)                           //
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// FILE:    test_persistent_sharded_list.cpp                                 //
+//                                                                           //
+// MODULE:  Persistent Skip List                                             //
+//                                                                           //
+// NOTES:   A reader thread checks every published version while the         //
+//          shards are changed.                                              //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include <iostream>
+#include <cassert>
+#include <cstdlib>
+#include <set>
+#include <vector>
+#include <iterator>
+#include <thread>
+#include "../PersistentShardedList.hpp"
+
+using namespace std;
+using namespace persistent_skip_list;
+
+static const int KEYS = 1000;
+static const int VERSIONS = 100;
+
+// true if version t of the list holds exactly the data of the model
+static bool sameData(PersistentShardedList<int>& list, const set<int>& data,
+		     int t) {
+  vector<int> found;
+  list.range(-1,KEYS,t,back_inserter(found));
+  if(found != vector<int>(data.begin(),data.end()))
+    return false;
+  if(list.countRange(-1,KEYS,t) != (int)data.size())
+    return false;
+  for(int key = -1; key <= KEYS; ++key)
+    if(list.contains(key,t) != (data.count(key) == 1))
+      return false;
+  return true;
+}
+
+int main(int argv, char** argc) {
+  srand(1);
+  vector<int> bounds;
+  bounds.push_back(250);
+  bounds.push_back(500);
+  bounds.push_back(750);
+
+  /////////////////////////////////////////////////////////////////////////////
+  // Test changing shards over many versions                                 //
+  /////////////////////////////////////////////////////////////////////////////
+  cout << "Changing shards over many versions...";
+  PersistentShardedList<int> list(bounds,2);
+  assert(list.getShardCount() == 4);
+  vector< set<int> > versions(1);
+  // the sizes of the versions, written before each is published
+  vector<int> sizes(VERSIONS+1,-1);
+  int read = 0;
+  thread reader([&] {
+      // every published version holds as many data as its model
+      int t = 0;
+      while(t < VERSIONS) {
+	if(t >= list.getPresent()) {
+	  this_thread::yield();
+	  continue;
+	}
+	if(list.countRange(-1,KEYS,t) != sizes[t]) {
+	  cout << "Read the wrong size at time " << t << endl;
+	  abort();
+	}
+	++t;
+	++read;
+      }
+    });
+  for(int v = 0; v < VERSIONS; ++v) {
+    for(int i = 0; i < 50; ++i) {
+      int key = rand() % KEYS;
+      if(versions.back().count(key) == 1) {
+	list.remove(key);
+	versions.back().erase(key);
+      } else {
+	list.insert(key);
+	versions.back().insert(key);
+      }
+    }
+    sizes[v] = (int)versions.back().size();
+    list.incTime();
+    versions.push_back(versions.back());
+  }
+  reader.join();
+  assert(read == VERSIONS);
+  cout << "success." << endl;
+
+  cout << "Querying every version...";
+  for(int t = 0; t < (int)versions.size(); ++t)
+    assert(sameData(list,versions[t],t));
+  cout << "success." << endl;
+
+  /////////////////////////////////////////////////////////////////////////////
+  // Test finding across shards                                              //
+  /////////////////////////////////////////////////////////////////////////////
+  cout << "Finding across empty shards...";
+  PersistentShardedList<int> sparse(bounds);
+  sparse.insert(100);
+  sparse.insert(900);
+  sparse.incTime();
+  assert(*sparse.find(100,0) == 100);
+  // the shards from 250 to 750 are empty, so the first holds the answer
+  assert(*sparse.find(600,0) == 100);
+  assert(*sparse.find(950,0) == 900);
+  assert(*sparse.find(899,0) == 100);
+  // nothing is at or before 50, so the head of the first shard is found
+  assert(sparse.find(50,0) < 50);
+  cout << "success." << endl;
+
+  /////////////////////////////////////////////////////////////////////////////
+  // Test errors                                                             //
+  /////////////////////////////////////////////////////////////////////////////
+  cout << "Inserting a duplicate...";
+  sparse.insert(900);
+  sparse.insert(901);
+  bool threw = false;
+  try {
+    sparse.flush();
+  } catch(const char* message) {
+    threw = true;
+  }
+  assert(threw);
+  // the changes which didn't fail are kept
+  assert(sparse.contains(901,sparse.getPresent()));
+  cout << "success." << endl;
+
+  cout << "Removing a missing datum...";
+  sparse.remove(5);
+  threw = false;
+  try {
+    sparse.incTime();
+  } catch(const char* message) {
+    threw = true;
+  }
+  assert(threw);
+  // the version is published anyway
+  assert(sparse.getPresent() == 2);
+  assert(sparse.contains(901,1));
+  sparse.flush();
+  cout << "success." << endl;
+
+  // success
+  return 0;
+}
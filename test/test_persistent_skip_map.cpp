@@ -0,0 +1,178 @@
+///////////////////////////////////////////////////////////////////////////////
+//                       Copyright (c) 2011 - 2012 by                        //
+//                                Simon Pratt                                //
+//                           (All rights reserved)                           //
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// FILE:    test_persistent_skip_map.cpp                                     //
+//                                                                           //
+// MODULE:  Persistent Skip List                                             //
+//                                                                           //
+// NOTES:   None.                                                            //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+#include <iostream>
+#include <cassert>
+#include <cstdlib>
+#include <map>
+#include <vector>
+#include <string>
+#include <functional>
+#include "../PersistentSkipMap.hpp"
+
+using namespace std;
+using namespace persistent_skip_list;
+
+// a heap allocator which counts the bytes it has given out
+class CountingAllocator {
+public:
+  static size_t live;
+  void* allocate(size_t bytes) {
+    live += bytes;
+    return ::operator new(bytes);
+  }
+  void deallocate(void* p, size_t bytes) {
+    live -= bytes;
+    ::operator delete(p);
+  }
+  void release(void) {}
+};
+size_t CountingAllocator::live = 0;
+
+// true if version t of the map holds exactly the data of the model
+static bool sameData(PersistentSkipMap<int,int>& map,
+		     const std::map<int,int>& data, int t) {
+  for(int key = -1; key <= 100; ++key) {
+    std::map<int,int>::const_iterator found = data.find(key);
+    if(map.contains(key,t) != (found != data.end()))
+      return false;
+    if(found != data.end() && map.get(key,t) != found->second)
+      return false;
+  }
+  return true;
+}
+
+int main(int argv, char** argc) {
+  srand(1);
+
+  /////////////////////////////////////////////////////////////////////////////
+  // Test putting and removing over many versions                            //
+  /////////////////////////////////////////////////////////////////////////////
+  cout << "Putting and removing over many versions...";
+  PersistentSkipMap<int,int> map(2);
+  vector< std::map<int,int> > versions(1);
+  for(int v = 0; v < 60; ++v) {
+    for(int i = 0; i < 20; ++i) {
+      int key = rand() % 100;
+      if(versions.back().count(key) == 1 && rand() % 4 == 0) {
+	map.remove(key);
+	versions.back().erase(key);
+      } else {
+	int value = rand();
+	map.put(key,value);
+	versions.back()[key] = value;
+      }
+    }
+    map.incTime();
+    versions.push_back(versions.back());
+  }
+  cout << "success." << endl;
+
+  cout << "Getting every version...";
+  for(int t = 0; t < (int)versions.size(); ++t)
+    assert(sameData(map,versions[t],t));
+  cout << "success." << endl;
+
+  /////////////////////////////////////////////////////////////////////////////
+  // Test updating one key                                                   //
+  /////////////////////////////////////////////////////////////////////////////
+  cout << "Updating a value in every version...";
+  PersistentSkipMap<int,string> names;
+  names.put(1,"one");
+  names.put(2,"two");
+  for(int v = 0; v < 20; ++v) {
+    names.incTime();
+    names.put(1,string(v+1,'x'));
+  }
+  // a second put in a version replaces the first
+  names.put(1,"last");
+  for(int t = 1; t < names.getPresent(); ++t)
+    assert(names.get(1,t) == string(t,'x'));
+  assert(names.get(1,0) == "one");
+  assert(names.get(1,names.getPresent()) == "last");
+  assert(names.get(2,names.getPresent()) == "two");
+  cout << "success." << endl;
+
+  /////////////////////////////////////////////////////////////////////////////
+  // Test a custom comparator                                                //
+  /////////////////////////////////////////////////////////////////////////////
+  cout << "Ordering keys with a comparator...";
+  PersistentSkipMap<int,int,greater<int> > descending;
+  for(int key = 0; key < 10; ++key)
+    descending.put(key,key*key);
+  descending.incTime();
+  descending.put(3,0);
+  assert(descending.get(3,0) == 9);
+  assert(descending.get(3,1) == 0);
+  assert(descending.get(9,1) == 81);
+  assert(! descending.contains(10,1));
+  cout << "success." << endl;
+
+  /////////////////////////////////////////////////////////////////////////////
+  // Test errors                                                             //
+  /////////////////////////////////////////////////////////////////////////////
+  cout << "Getting a missing key...";
+  bool threw = false;
+  try {
+    names.get(3,names.getPresent());
+  } catch(const char* message) {
+    threw = true;
+  }
+  assert(threw);
+  cout << "success." << endl;
+
+  cout << "Removing a missing key...";
+  threw = false;
+  try {
+    names.remove(3);
+  } catch(const char* message) {
+    threw = true;
+  }
+  assert(threw);
+  cout << "success." << endl;
+
+  cout << "Putting a removed key again...";
+  names.incTime();
+  names.remove(1);
+  assert(! names.contains(1,names.getPresent()));
+  names.put(1,"again");
+  assert(names.get(1,names.getPresent()) == "again");
+  assert(names.get(1,names.getPresent()-1) == "last");
+  cout << "success." << endl;
+
+  /////////////////////////////////////////////////////////////////////////////
+  // Test the allocator policy                                               //
+  /////////////////////////////////////////////////////////////////////////////
+  cout << "Allocating logs and slots from the allocator...";
+  {
+    PersistentSkipMap<int,string,less<int>,CountingAllocator> counted;
+    for(int key = 0; key < 10; ++key)
+      counted.put(key,"first");
+    // putting existing keys adds only versions, and slots once full
+    size_t indexed = CountingAllocator::live;
+    for(int v = 0; v < 20; ++v) {
+      counted.incTime();
+      for(int key = 0; key < 10; ++key)
+	counted.put(key,to_string(v));
+    }
+    assert(CountingAllocator::live > indexed);
+    assert(counted.get(3,counted.getPresent()) == "19");
+    assert(counted.get(3,1) == "0");
+  }
+  // and everything goes back to it
+  assert(CountingAllocator::live == 0);
+  cout << "success." << endl;
+
+  // success
+  return 0;
+}
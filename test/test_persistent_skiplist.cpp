@@ -13,12 +13,45 @@
 ///////////////////////////////////////////////////////////////////////////////
 
 #include <iostream>
+#include <iterator>
+#include <sstream>
 #include "../TimeStampedArray.hpp"
 #include "../PersistentSkipList.hpp"
 
 using namespace persistent_skip_list;
 using namespace timestamped_array;
 
+// a datum which counts how often it is copied and moved
+static int copies = 0, moves = 0;
+struct Heavy {
+  int key;
+  char payload[200];
+  Heavy() : key(0) {}
+  Heavy(int k) : key(k) {}
+  Heavy(const Heavy& other) : key(other.key) { ++copies; }
+  Heavy(Heavy&& other) : key(other.key) { ++moves; }
+  bool operator<(const Heavy& other) const { return key < other.key; }
+  bool operator>(const Heavy& other) const { return key > other.key; }
+};
+
+// a list which keeps the widths of its links, for rank and select
+typedef PersistentSkipList<int,HeapAllocator,GeometricLevels,true> RankedList;
+typedef PSLIterator<int,HeapAllocator,GeometricLevels,true> RankedIterator;
+
+// an allocator policy which counts the bytes it has outstanding
+static long outstanding = 0;
+struct CountingAllocator {
+  void* allocate(size_t bytes) {
+    outstanding += bytes;
+    return ::operator new(bytes);
+  }
+  void deallocate(void* p, size_t bytes) {
+    outstanding -= bytes;
+    ::operator delete(p);
+  }
+  void release(void) {}
+};
+
 void printBar() {
   cout << "======================================================================"
        << endl;
@@ -90,23 +123,23 @@ int main(int argv, char** argc) {
   found = psl.find(72,0);
   cout << "Querying for 72 at time 0, found: " << *found << endl;
   found = psl.find(72,1);
-#ifndef NDEBUG
+#ifdef PSL_SEARCH_PATH
   cout << "\t Search path:";
-  for(vector<int>::iterator it = psl.lastSearchPath.begin();
+  for(vector<const int*>::iterator it = psl.lastSearchPath.begin();
       it != psl.lastSearchPath.end();
       ++it) {
-    cout << *it << ", ";
+    cout << **it << ", ";
   }
   cout << endl;
 #endif
   cout << "Querying for 72 at time 1, found: " << *found << endl;
   found = psl.find(72,2);
-#ifndef NDEBUG
+#ifdef PSL_SEARCH_PATH
   cout << "\t Search path:";
-  for(vector<int>::iterator it = psl.lastSearchPath.begin();
+  for(vector<const int*>::iterator it = psl.lastSearchPath.begin();
       it != psl.lastSearchPath.end();
       ++it) {
-    cout << *it << ", ";
+    cout << **it << ", ";
   }
   cout << endl;
 #endif
@@ -125,23 +158,23 @@ int main(int argv, char** argc) {
 
   found = psl.find(17,0);
   cout << "Querying for 17 at time 0, found: " << *found << endl;
-#ifndef NDEBUG
+#ifdef PSL_SEARCH_PATH
   cout << "\t Search path:";
-  for(vector<int>::iterator it = psl.lastSearchPath.begin();
+  for(vector<const int*>::iterator it = psl.lastSearchPath.begin();
       it != psl.lastSearchPath.end();
       ++it) {
-    cout << *it << ", ";
+    cout << **it << ", ";
   }
   cout << endl;
 #endif
   found = psl.find(17,1);
   cout << "Querying for 17 at time 1, found: " << *found << endl;
-#ifndef NDEBUG
+#ifdef PSL_SEARCH_PATH
   cout << "\t Search path:";
-  for(vector<int>::iterator it = psl.lastSearchPath.begin();
+  for(vector<const int*>::iterator it = psl.lastSearchPath.begin();
       it != psl.lastSearchPath.end();
       ++it) {
-    cout << *it << ", ";
+    cout << **it << ", ";
   }
   cout << endl;
 #endif
@@ -158,6 +191,516 @@ int main(int argv, char** argc) {
   cout << "Querying for 10 at time 2, found: " << *found << endl;
   found = psl.find(10,3);
   cout << "Querying for 10 at time 3, found: " << *found << endl;
+  printBar();
+
+  /////////////////////////////////////////////////////////////////////////////
+  // Test node copying                                                       //
+  /////////////////////////////////////////////////////////////////////////////
+
+  cout << "Allocating PersistentSkipList<int> with node size 1...";
+  RankedList copying(1);
+  cout << "success." << endl;
+
+  cout << "Inserting one value per time...";
+  for(int i = 0; i < 32; ++i) {
+    copying.insert((i * 7) % 32);
+    copying.incTime();
+  }
+  cout << "success." << endl;
+
+  cout << "Querying every value at every time...";
+  for(int t = 0; t < copying.getPresent(); ++t) {
+    for(int i = 0; i <= t; ++i) {
+      assert(*copying.find((i * 7) % 32,t) == (i * 7) % 32);
+    }
+    int count = 0;
+    for(RankedIterator it = copying.begin(t); it != copying.end(t); ++it)
+      ++count;
+    assert(count == t+1);
+  }
+  cout << "success." << endl;
+  printBar();
+
+  /////////////////////////////////////////////////////////////////////////////
+  // Test bulk loading                                                       //
+  /////////////////////////////////////////////////////////////////////////////
+
+  cout << "Bulk loading 1000 values over the present...";
+  vector<int> sorted;
+  for(int i = 0; i < 1000; ++i)
+    sorted.push_back(i * 3);
+  copying.bulkLoad(sorted.begin(), sorted.end());
+  cout << "success." << endl;
+
+  cout << "Querying the loaded values...";
+  int present = copying.getPresent();
+  for(int i = 0; i < 1000; ++i) {
+    assert(*copying.find(i * 3,present) == i * 3);
+    assert(*copying.find(i * 3 + 1,present) == i * 3);
+  }
+  int count = 0;
+  for(RankedIterator it = copying.begin(present);
+      it != copying.end(present); ++it)
+    assert(*it == 3 * count++);
+  assert(count == 1000);
+  cout << "success." << endl;
+
+  cout << "Checking earlier versions are unchanged...";
+  for(int i = 0; i < 32; ++i)
+    assert(*copying.find((i * 7) % 32,present-1) == (i * 7) % 32);
+  cout << "success." << endl;
+
+  cout << "Inserting and removing after a bulk load...";
+  copying.incTime();
+  present = copying.getPresent();
+  copying.insert(1);
+  RankedIterator three = copying.find(3,present);
+  three.remove();
+  assert(*copying.find(1,present) == 1);
+  assert(*copying.find(4,present) == 1);
+  assert(*copying.find(4,present-1) == 3);
+  cout << "success." << endl;
+
+  cout << "Rejecting unsorted data...";
+  sorted[500] = 0;
+  try {
+    copying.bulkLoad(sorted.begin(), sorted.end());
+    assert(false);
+  } catch(const char*) {
+  }
+  assert(*copying.find(1,present) == 1);
+  {
+    // the nodes built before the unsorted datum are freed
+    PersistentSkipList<int,CountingAllocator> counted;
+    counted.insert(1);
+    long before = outstanding;
+    try {
+      counted.bulkLoad(sorted.begin(), sorted.end());
+      assert(false);
+    } catch(const char*) {
+    }
+    assert(outstanding == before);
+    assert(counted.countRange(0,2000,counted.getPresent()) == 1);
+  }
+  assert(outstanding == 0);
+  cout << "success." << endl;
+  printBar();
+
+  /////////////////////////////////////////////////////////////////////////////
+  // Test batch insertion                                                    //
+  /////////////////////////////////////////////////////////////////////////////
+
+  cout << "Inserting an unsorted batch between existing values...";
+  copying.incTime();
+  present = copying.getPresent();
+  vector<int> batch;
+  for(int i = 0; i < 1000; ++i)
+    batch.push_back(((i * 7) % 1000) * 3 + 2);
+  copying.insertBatch(batch.begin(), batch.end());
+  cout << "success." << endl;
+
+  cout << "Querying the batch and the earlier values...";
+  for(int i = 0; i < 1000; ++i) {
+    assert(*copying.find(i * 3 + 2,present) == i * 3 + 2);
+    assert(*copying.find(i * 3 + 2,present-1) != i * 3 + 2);
+  }
+  count = 0;
+  for(RankedIterator it = copying.begin(present);
+      it != copying.end(present); ++it)
+    ++count;
+  assert(count == 2000);
+  cout << "success." << endl;
+
+  cout << "Rejecting a batch with a present value...";
+  batch.clear();
+  batch.push_back(10000);
+  batch.push_back(5);
+  try {
+    copying.insertBatch(batch.begin(), batch.end());
+    assert(false);
+  } catch(const char*) {
+  }
+  assert(*copying.find(10000,present) != 10000);
+  // the data before the present one were linked, then taken out again
+  batch.clear();
+  batch.push_back(-1);
+  batch.push_back(5);
+  batch.push_back(-3);
+  try {
+    copying.insertBatch(batch.begin(), batch.end());
+    assert(false);
+  } catch(const char*) {
+  }
+  assert(*copying.find(-1,present) != -1);
+  assert(*copying.find(-3,present) != -3);
+  assert(copying.countRange(-10,10000,present) == 2000);
+  count = 0;
+  for(RankedIterator it = copying.begin(present);
+      it != copying.end(present); ++it, ++count)
+    assert(copying.rank(*it,present) == count);
+  cout << "success." << endl;
+
+  cout << "Inserting a batch read once from a stream...";
+  istringstream stream("4000 3500 3800");
+  copying.insertBatch(istream_iterator<int>(stream), istream_iterator<int>());
+  assert(copying.countRange(3500,4000,present) == 3);
+  assert(copying.countRange(-10,10000,present) == 2003);
+  cout << "success." << endl;
+  printBar();
+
+  /////////////////////////////////////////////////////////////////////////////
+  // Test finger search                                                      //
+  /////////////////////////////////////////////////////////////////////////////
+
+  cout << "Inserting from hints in both directions...";
+  RankedList hinted(2);
+  RankedIterator hint = hinted.insert(1000,hinted.end(0));
+  for(int i = 1; i < 500; ++i) {
+    hint = hinted.insert(1000 + i * 2,hint);
+    if(i % 100 == 0)
+      hinted.incTime();
+  }
+  for(int i = 1; i < 500; ++i) {
+    hint = hinted.insert(1000 - i * 2,hint);
+    if(i % 100 == 0)
+      hinted.incTime();
+  }
+  present = hinted.getPresent();
+  count = 0;
+  for(RankedIterator it = hinted.begin(present);
+      it != hinted.end(present); ++it) {
+    assert(*it == 2 + count * 2);
+    ++count;
+  }
+  assert(count == 999);
+  cout << "success." << endl;
+
+  cout << "Finding from hints at present and in the past...";
+  for(int t = present - 5; t <= present; ++t) {
+    RankedIterator middle = hinted.find(1000,t);
+    for(int i = 1; i < 1000; i += 7) {
+      assert(*hinted.find(i,t,middle) == *hinted.find(i,t));
+      assert(*hinted.find(i + 1000,t,middle) == *hinted.find(i + 1000,t));
+    }
+  }
+  cout << "success." << endl;
+
+  cout << "Ignoring hints which have left the present...";
+  RankedIterator removed = hinted.find(1000,present);
+  RankedIterator remover = hinted.find(1000,present);
+  remover.remove();
+  assert(*hinted.find(1001,present,removed) == 998);
+  assert(*hinted.find(997,present,removed) == 996);
+  RankedIterator past = hinted.find(1000,present-1);
+  assert(*hinted.find(1001,present,past) == 998);
+  hint = hinted.insert(1001,removed);
+  assert(*hinted.find(1001,present) == 1001);
+  assert(*hinted.find(1002,present,hint) == 1002);
+  cout << "success." << endl;
+  printBar();
+
+  /////////////////////////////////////////////////////////////////////////////
+  // Test range queries                                                      //
+  /////////////////////////////////////////////////////////////////////////////
+
+  cout << "Querying ranges at present and in the past...";
+  vector<int> in_range;
+  hinted.range(100,120,present,back_inserter(in_range));
+  assert(in_range.size() == 11);
+  for(int i = 0; i < 11; ++i)
+    assert(in_range[i] == 100 + i * 2);
+  assert(hinted.countRange(99,121,present) == 11);
+  // 1000 was removed, and 1001 inserted, at present
+  in_range.clear();
+  hinted.range(999,1001,present,back_inserter(in_range));
+  assert(in_range.size() == 1 && in_range[0] == 1001);
+  in_range.clear();
+  hinted.range(999,1001,present-1,back_inserter(in_range));
+  assert(in_range.size() == 1 && in_range[0] == 1000);
+  assert(hinted.countRange(0,5000,present) == 999);
+  assert(hinted.countRange(0,5000,0) == 101);
+  cout << "success." << endl;
+
+  cout << "Querying empty and out of bounds ranges...";
+  assert(hinted.countRange(3,3,present) == 0);
+  assert(hinted.countRange(20,10,present) == 0);
+  assert(hinted.countRange(5000,6000,present) == 0);
+  assert(hinted.countRange(-10,0,present) == 0);
+  assert(*hinted.lowerBound(3,present) == 4);
+  assert(*hinted.lowerBound(4,present) == 4);
+  assert(hinted.lowerBound(5000,present) == hinted.end(present));
+  cout << "success." << endl;
+  printBar();
+
+  /////////////////////////////////////////////////////////////////////////////
+  // Test rank and select                                                    //
+  /////////////////////////////////////////////////////////////////////////////
+
+  cout << "Ranking and selecting at every time...";
+  for(int t = 0; t <= present; ++t) {
+    int rank = 0;
+    for(RankedIterator it = hinted.begin(t); it != hinted.end(t); ++it) {
+      assert(hinted.rank(*it,t) == rank);
+      assert(hinted.rank(*it + 1,t) == rank + 1);
+      assert(*hinted.select(rank,t) == *it);
+      ++rank;
+    }
+    assert(hinted.select(rank,t) == hinted.end(t));
+    assert(hinted.select(rank+1,t) == hinted.end(t));
+    assert(hinted.select(rank+1000,t) == hinted.end(t));
+    assert(hinted.select(-1,t) == hinted.end(t));
+    assert(hinted.rank(5000,t) == rank);
+  }
+  cout << "success." << endl;
+
+  cout << "Ranking and selecting after a bulk load...";
+  copying.incTime();
+  present = copying.getPresent();
+  copying.bulkLoad(sorted.begin(), sorted.begin() + 500);
+  for(int i = 0; i < 500; ++i) {
+    assert(copying.rank(sorted[i],present) == i);
+    assert(*copying.select(i,present) == sorted[i]);
+  }
+  assert(copying.select(500,present) == copying.end(present));
+  assert(copying.select(501,present) == copying.end(present));
+  assert(copying.rank(2,present-1) == copying.countRange(0,1,present-1));
+  cout << "success." << endl;
+
+  cout << "Selecting past the end of a small list...";
+  RankedList pair;
+  pair.insert(1);
+  pair.insert(2);
+  assert(*pair.select(1,0) == 2);
+  assert(pair.select(2,0) == pair.end(0));
+  assert(pair.select(3,0) == pair.end(0));
+  assert(pair.select(1 << 20,0) == pair.end(0));
+  cout << "success." << endl;
+  printBar();
+
+  /////////////////////////////////////////////////////////////////////////////
+  // Test duplicate detection                                                //
+  /////////////////////////////////////////////////////////////////////////////
+
+  cout << "Rejecting present values without changing the list...";
+  for(int i = 0; i < 500; i += 50) {
+    try {
+      copying.insert(sorted[i]);
+      assert(false);
+    } catch(const char*) {
+    }
+    try {
+      copying.insert(sorted[i],copying.find(sorted[i] + 100,present));
+      assert(false);
+    } catch(const char*) {
+    }
+  }
+  assert(copying.countRange(0,5000,present) == 500);
+  assert(copying.rank(sorted[499],present) == 499);
+  cout << "success." << endl;
+
+  cout << "Reinserting a removed value...";
+  RankedIterator removed_value = copying.find(sorted[250],present);
+  removed_value.remove();
+  copying.insert(sorted[250]);
+  assert(*copying.find(sorted[250],present) == sorted[250]);
+  assert(copying.rank(sorted[251],present) == 251);
+  cout << "success." << endl;
+  printBar();
+
+  /////////////////////////////////////////////////////////////////////////////
+  // Test dropping old versions                                              //
+  /////////////////////////////////////////////////////////////////////////////
+
+  cout << "Dropping old versions while replacing values...";
+  RankedList collected(2);
+  RankedList uncollected(2);
+  for(int i = 0; i < 100; ++i) {
+    collected.insert(i);
+    uncollected.insert(i);
+  }
+  for(int i = 100; i < 1000; ++i) {
+    collected.find(i - 100,collected.getPresent()).remove();
+    uncollected.find(i - 100,uncollected.getPresent()).remove();
+    collected.insert(i);
+    uncollected.insert(i);
+    collected.incTime();
+    uncollected.incTime();
+    if(i % 50 == 49)
+      assert(collected.dropVersionsBefore(collected.getPresent() - 10) > 0);
+  }
+  cout << "success." << endl;
+
+  cout << "Querying the versions kept...";
+  int oldest = collected.getPresent() - 10;
+  collected.dropVersionsBefore(oldest);
+  assert(collected.dropVersionsBefore(oldest) == 0);
+  for(int t = oldest; t <= collected.getPresent(); ++t) {
+    RankedIterator expected = uncollected.begin(t);
+    RankedIterator collected_end = collected.end(t);
+    for(RankedIterator it = collected.begin(t); it != collected_end; ++it) {
+      assert(*it == *expected);
+      ++expected;
+    }
+    assert(expected == uncollected.end(t));
+    assert(*collected.find(950,t) == *uncollected.find(950,t));
+    assert(collected.rank(950,t) == uncollected.rank(950,t));
+  }
+  collected.insert(5000);
+  assert(collected.countRange(0,6000,collected.getPresent()) == 101);
+  cout << "success." << endl;
+
+  /////////////////////////////////////////////////////////////////////////////
+  // Test diffing versions                                                   //
+  /////////////////////////////////////////////////////////////////////////////
+  cout << "Diffing every pair of versions...";
+  PersistentSkipList<int> diffed(2);
+  vector< set<int> > diffed_versions(1);
+  for(int v = 0; v < 40; ++v) {
+    for(int i = 0; i < 10; ++i) {
+      int key = rand() % 60;
+      if(diffed_versions.back().count(key) == 1) {
+	diffed.find(key,diffed.getPresent()).remove();
+	diffed_versions.back().erase(key);
+      } else {
+	diffed.insert(key);
+	diffed_versions.back().insert(key);
+      }
+    }
+    // a datum inserted and removed in one version is never seen
+    diffed.insert(100);
+    diffed.find(100,diffed.getPresent()).remove();
+    diffed.incTime();
+    diffed_versions.push_back(diffed_versions.back());
+  }
+  for(int t1 = 0; t1 < (int)diffed_versions.size(); ++t1)
+    for(int t2 = t1; t2 < (int)diffed_versions.size(); ++t2) {
+      const set<int>& before = diffed_versions[t1];
+      const set<int>& after = diffed_versions[t2];
+      vector<int> inserted, removed, expected_inserted, expected_removed;
+      set_difference(after.begin(),after.end(),before.begin(),before.end(),
+		     back_inserter(expected_inserted));
+      set_difference(before.begin(),before.end(),after.begin(),after.end(),
+		     back_inserter(expected_removed));
+      int reported =
+	diffed.diff(t1,t2,
+		    [&](const int& datum) { inserted.push_back(datum); },
+		    [&](const int& datum) { removed.push_back(datum); });
+      assert(inserted == expected_inserted);
+      assert(removed == expected_removed);
+      assert(reported == (int)(inserted.size()+removed.size()));
+    }
+  cout << "success." << endl;
+
+  cout << "Diffing a bulk load and dropped versions...";
+  int loaded[] = { 10, 20, 30 };
+  diffed.bulkLoad(loaded,loaded+3);
+  diffed.incTime();
+  const set<int>& last = diffed_versions.back();
+  int inserted_count = 0;
+  vector<int> dropped;
+  diffed.diff(diffed.getPresent()-2,diffed.getPresent()-1,
+	      [&](const int& datum) { ++inserted_count; },
+	      [&](const int& datum) { dropped.push_back(datum); });
+  assert(inserted_count ==
+	 3 - (int)(last.count(10) + last.count(20) + last.count(30)));
+  assert((int)dropped.size() ==
+	 (int)last.size() - 3 + inserted_count);
+  diffed.dropVersionsBefore(30);
+  dropped.clear();
+  diffed.diff(30,diffed.getPresent(),
+	      [&](const int& datum) {},
+	      [&](const int& datum) { dropped.push_back(datum); });
+  vector<int> expected_dropped;
+  set<int> now(loaded,loaded+3);
+  set_difference(diffed_versions[30].begin(),diffed_versions[30].end(),
+		 now.begin(),now.end(),back_inserter(expected_dropped));
+  assert(dropped == expected_dropped);
+  cout << "success." << endl;
+
+  /////////////////////////////////////////////////////////////////////////////
+  // Test searching many versions at once                                    //
+  /////////////////////////////////////////////////////////////////////////////
+  cout << "Finding a datum across every version...";
+  PersistentSkipList<int> audited(2);
+  for(int v = 0; v < 50; ++v) {
+    for(int i = 0; i < 5; ++i) {
+      int key = rand() % 40;
+      PSLIterator<int> at = audited.find(key,audited.getPresent());
+      if(at == key)
+	at.remove();
+      else
+	audited.insert(key);
+    }
+    audited.incTime();
+  }
+  vector<int> every_time;
+  for(int t = 0; t <= audited.getPresent(); ++t) {
+    every_time.push_back(t);
+    // repeated times are searched once each
+    if(t % 7 == 0)
+      every_time.push_back(t);
+  }
+  for(int key = -1; key <= 41; ++key) {
+    vector< PSLIterator<int> > across;
+    audited.findAcrossVersions(key,every_time,back_inserter(across));
+    assert(across.size() == every_time.size());
+    for(size_t i = 0; i < every_time.size(); ++i)
+      assert(across[i] == audited.find(key,every_time[i]));
+  }
+  cout << "success." << endl;
+
+  cout << "Finding a datum at a few versions...";
+  vector<int> some_times;
+  some_times.push_back(3);
+  some_times.push_back(20);
+  some_times.push_back(21);
+  some_times.push_back(audited.getPresent());
+  vector< PSLIterator<int> > across;
+  audited.findAcrossVersions(17,some_times,back_inserter(across));
+  for(size_t i = 0; i < some_times.size(); ++i)
+    assert(across[i] == audited.find(17,some_times[i]));
+  across.clear();
+  audited.findAcrossVersions(17,vector<int>(),back_inserter(across));
+  assert(across.empty());
+  cout << "success." << endl;
+
+  /////////////////////////////////////////////////////////////////////////////
+  // Test constructing data in place                                         //
+  /////////////////////////////////////////////////////////////////////////////
+  cout << "Emplacing and moving data into nodes...";
+  PersistentSkipList<Heavy> heavy;
+  for(int i = 0; i < 50; ++i)
+    heavy.emplace(2*i);
+  assert(copies == 0 && moves == 0);
+  for(int i = 0; i < 50; ++i)
+    heavy.insert(Heavy(2*i+1));
+  assert(copies == 0 && moves == 50);
+  bool threw = false;
+  try {
+    heavy.emplace(42);
+  } catch(const char* message) {
+    threw = true;
+  }
+  assert(threw);
+  assert(heavy.countRange(Heavy(0),Heavy(99),heavy.getPresent()) == 100);
+  int expected_key = 0;
+  PSLIterator<Heavy> heavy_end = heavy.end(heavy.getPresent());
+  for(PSLIterator<Heavy> it = heavy.begin(heavy.getPresent());
+      it != heavy_end; ++it)
+    assert(it->key == expected_key++);
+  cout << "success." << endl;
+
+  cout << "Diffing without copying data...";
+  heavy.incTime();
+  for(int i = 0; i < 10; ++i)
+    heavy.find(Heavy(i),heavy.getPresent()).remove();
+  int heavy_removes = 0;
+  heavy.diff(0,1,
+	     [&](const Heavy& datum) {},
+	     [&](const Heavy& datum) { ++heavy_removes; });
+  assert(heavy_removes == 10);
+  assert(copies == 0 && moves == 50);
+  cout << "success." << endl;
 
   // success
   return 0;
@@ -0,0 +1,220 @@
+///////////////////////////////////////////////////////////////////////////////
+//                       Copyright (c) 2011 - 2012 by                        //
+//                                Simon Pratt                                //
+//                           (All rights reserved)                           //
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// FILE:    test_persistent_unrolled_list.cpp                                //
+//                                                                           //
+// MODULE:  Persistent Skip List                                             //
+//                                                                           //
+// NOTES:   None.                                                            //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+#include <iostream>
+#include <cassert>
+#include <cstdlib>
+#include <set>
+#include <vector>
+#include <iterator>
+#include <string>
+#include <limits>
+#include <type_traits>
+#include "../PersistentUnrolledList.hpp"
+
+using namespace std;
+using namespace persistent_skip_list;
+
+// a heap allocator which counts the bytes it has given out
+class CountingAllocator {
+public:
+  static size_t live;
+  void* allocate(size_t bytes) {
+    live += bytes;
+    return ::operator new(bytes);
+  }
+  void deallocate(void* p, size_t bytes) {
+    live -= bytes;
+    ::operator delete(p);
+  }
+  void release(void) {}
+};
+size_t CountingAllocator::live = 0;
+
+// true if version t of the list holds exactly the data of the set
+static bool sameData(PersistentUnrolledList<int>& list, const set<int>& data,
+		     int t) {
+  vector<int> found;
+  list.range(-1,1000,t,back_inserter(found));
+  if(found != vector<int>(data.begin(),data.end()))
+    return false;
+  for(int i = -1; i <= 300; ++i)
+    if(list.contains(i,t) != (data.count(i) == 1))
+      return false;
+  return true;
+}
+
+// true if countLess agrees with a scan on blocks of keys of type T which
+// cross zero, or for unsigned types the top bit, in steps of three
+template < class T >
+static bool countsLikeScan(void) {
+  const int KEYS = 70;
+  T keys[KEYS];
+  T first = is_signed<T>::value ? (T)(-35 * 3)
+    : (T)(numeric_limits<T>::max() / 2 - 35 * 3);
+  for(int i = 0; i < KEYS; ++i)
+    keys[i] = (T)(first + i * 3);
+  for(int count = 0; count <= KEYS; ++count)
+    for(int j = -1; j <= KEYS; ++j) {
+      T data[3];
+      if(j < 0) {
+	data[0] = data[1] = numeric_limits<T>::min();
+	data[2] = numeric_limits<T>::max();
+      } else {
+	T key = keys[j < KEYS ? j : KEYS-1];
+	data[0] = (T)(key - 1);
+	data[1] = key;
+	data[2] = (T)(key + 1);
+      }
+      for(int d = 0; d < 3; ++d) {
+	int less = 0;
+	while(less < count && keys[less] < data[d])
+	  ++less;
+	if(BlockSearch<T>::countLess(keys,count,data[d]) != less)
+	  return false;
+      }
+    }
+  return true;
+}
+
+int main(int argv, char** argc) {
+  srand(1);
+
+  /////////////////////////////////////////////////////////////////////////////
+  // Test searching blocks                                                   //
+  /////////////////////////////////////////////////////////////////////////////
+  cout << "Counting keys less than a datum...";
+  int keys[40];
+  for(int i = 0; i < 40; ++i)
+    keys[i] = 3*i - 20;
+  for(int count = 0; count <= 40; ++count)
+    for(int datum = -25; datum < 125; ++datum) {
+      int less = 0;
+      while(less < count && keys[less] < datum)
+	++less;
+      assert(BlockSearch<int>::countLess(keys,count,datum) == less);
+    }
+  double halves[5] = {0.5, 1.0, 1.5, 2.0, 2.5};
+  assert(BlockSearch<double>::countLess(halves,5,1.2) == 2);
+  assert(BlockSearch<double>::countLess(halves,5,0.5) == 0);
+  assert(BlockSearch<double>::countLess(halves,5,3.0) == 5);
+  assert(countsLikeScan<signed char>());
+  assert(countsLikeScan<unsigned char>());
+  assert(countsLikeScan<short>());
+  assert(countsLikeScan<unsigned short>());
+  assert(countsLikeScan<unsigned>());
+  assert(countsLikeScan<long>());
+  assert(countsLikeScan<long long>());
+  assert(countsLikeScan<unsigned long long>());
+  cout << "success." << endl;
+
+  /////////////////////////////////////////////////////////////////////////////
+  // Test inserting and removing over many versions                          //
+  /////////////////////////////////////////////////////////////////////////////
+  cout << "Inserting and removing over many versions...";
+  // small blocks and slots split and replace often
+  PersistentUnrolledList<int> list(4,2);
+  vector< set<int> > versions(1);
+  for(int v = 0; v < 60; ++v) {
+    for(int i = 0; i < 20; ++i) {
+      int datum = rand() % 300;
+      if(versions.back().count(datum) == 1) {
+	list.remove(datum);
+	versions.back().erase(datum);
+      } else {
+	list.insert(datum);
+	versions.back().insert(datum);
+      }
+    }
+    list.incTime();
+    versions.push_back(versions.back());
+  }
+  cout << "success." << endl;
+
+  cout << "Searching every version...";
+  for(int t = 0; t < (int)versions.size(); ++t)
+    assert(sameData(list,versions[t],t));
+  cout << "success." << endl;
+
+  cout << "Searching ranges...";
+  int t = list.getPresent()/2;
+  vector<int> found;
+  list.range(100,150,t,back_inserter(found));
+  vector<int> expected(versions[t].lower_bound(100),
+		       versions[t].upper_bound(150));
+  assert(found == expected);
+  cout << "success." << endl;
+
+  /////////////////////////////////////////////////////////////////////////////
+  // Test errors                                                             //
+  /////////////////////////////////////////////////////////////////////////////
+  cout << "Inserting a duplicate...";
+  int present = list.getPresent();
+  int existing = *versions[present].begin();
+  bool threw = false;
+  try {
+    list.insert(existing);
+  } catch(const char* message) {
+    threw = true;
+  }
+  assert(threw);
+  cout << "success." << endl;
+
+  cout << "Removing a missing datum...";
+  threw = false;
+  try {
+    list.remove(1000);
+  } catch(const char* message) {
+    threw = true;
+  }
+  assert(threw);
+  cout << "success." << endl;
+
+  cout << "Emptying the list...";
+  while(! versions.back().empty()) {
+    list.remove(*versions.back().begin());
+    versions.back().erase(versions.back().begin());
+  }
+  assert(sameData(list,versions.back(),list.getPresent()));
+  list.insert(7);
+  assert(list.contains(7,list.getPresent()));
+  assert(sameData(list,versions[present-1],present-1));
+  cout << "success." << endl;
+
+  /////////////////////////////////////////////////////////////////////////////
+  // Test the allocator policy                                               //
+  /////////////////////////////////////////////////////////////////////////////
+  cout << "Allocating blocks and slots from the allocator...";
+  {
+    PersistentUnrolledList<string,CountingAllocator> strings(4,2);
+    size_t indexOnly = CountingAllocator::live;
+    for(int i = 0; i < 200; ++i) {
+      strings.insert(to_string(i * 7 % 200));
+      if(i % 16 == 0)
+	strings.incTime();
+    }
+    for(int i = 0; i < 200; i += 3)
+      strings.remove(to_string(i));
+    // far more than the index's nodes alone would take
+    assert(CountingAllocator::live > indexOnly + 200 * sizeof(string));
+    assert(strings.contains("199",strings.getPresent()));
+    assert(!strings.contains("198",strings.getPresent()));
+    assert(strings.contains("198",strings.getPresent()-1));
+  }
+  // and everything goes back to it
+  assert(CountingAllocator::live == 0);
+  cout << "success." << endl;
+
+  // success
+  return 0;
+}
@@ -0,0 +1,109 @@
+///////////////////////////////////////////////////////////////////////////////
+//                       Copyright (c) 2011 - 2012 by                        //
+//                                Simon Pratt                                //
+//                           (All rights reserved)                           //
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// FILE:    test_psl_concurrency.cpp                                         //
+//                                                                           //
+// MODULE:  Persistent Skip List                                             //
+//                                                                           //
+// NOTES:   One writer builds versions while several readers check every     //
+//          published version against the contents it must have.            //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include <iostream>
+#include <cstdlib>
+#include <pthread.h>
+#include "../PersistentSkipList.hpp"
+
+using namespace std;
+using namespace persistent_skip_list;
+
+// each version inserts one block of keys and removes the block WINDOW
+// versions older, so version t holds blocks max(0,t-WINDOW+1) to t
+static const int BLOCK = 8;
+static const int WINDOW = 4;
+static const int VERSIONS = 2000;
+static const int READERS = 4;
+
+static PersistentSkipList<int> psl(2);
+static int writer_done = 0;
+
+int firstKey(int t) {
+  int first_block = t - WINDOW + 1;
+  return (first_block > 0 ? first_block : 0) * BLOCK;
+}
+
+void* writer(void*) {
+  for(int t = 0; t < VERSIONS; ++t) {
+    // insert the keys of a block out of order
+    for(int i = 0; i < BLOCK; ++i)
+      psl.insert(t * BLOCK + (i * 5) % BLOCK);
+    // remove the oldest block
+    if(t >= WINDOW)
+      for(int i = 0; i < BLOCK; ++i) {
+	int key = (t - WINDOW) * BLOCK + i;
+	PSLIterator<int> found = psl.find(key, t);
+	assert(found == key);
+	found.remove();
+      }
+    psl.incTime();
+  }
+  atomicStore(&writer_done, 1);
+  return NULL;
+}
+
+void* reader(void* arg) {
+  unsigned int seed = (unsigned int)(size_t)arg;
+  long checked = 0;
+  while(! atomicLoad(&writer_done) || checked == 0) {
+    int present = psl.getPresent();
+    if(present == 0)
+      continue;
+    int t = rand_r(&seed) % present;
+    // scan the whole version
+    int expected = firstKey(t);
+    PSLIterator<int> end = psl.end(t);
+    for(PSLIterator<int> it = psl.begin(t); it != end; ++it) {
+      if(*it != expected) {
+	cout << "Read " << *it << " at time " << t
+	     << ", expected " << expected << endl;
+	abort();
+      }
+      ++expected;
+    }
+    if(expected != (t + 1) * BLOCK) {
+      cout << "Version " << t << " ended at " << expected << endl;
+      abort();
+    }
+    // search for a key which must be present
+    int key = firstKey(t) + rand_r(&seed) % (expected - firstKey(t));
+    if(psl.find(key, t) != key) {
+      cout << "Couldn't find " << key << " at time " << t << endl;
+      abort();
+    }
+    ++checked;
+  }
+  return NULL;
+}
+
+int main(int argc, char** argv) {
+  cout << "Starting one writer and " << READERS << " readers...";
+  pthread_t writer_thread;
+  pthread_t reader_threads[READERS];
+  for(int i = 0; i < READERS; ++i)
+    pthread_create(&reader_threads[i], NULL, reader, (void*)(size_t)(i+1));
+  pthread_create(&writer_thread, NULL, writer, NULL);
+  cout << "success." << endl;
+
+  cout << "Checking published versions while writing...";
+  pthread_join(writer_thread, NULL);
+  for(int i = 0; i < READERS; ++i)
+    pthread_join(reader_threads[i], NULL);
+  cout << "success." << endl;
+
+  // success
+  return 0;
+}
@@ -17,20 +17,36 @@
 #include "../PSLIterator.hpp"
 #include "../PersistentSkipList.hpp"
 
+// a datum which counts how often it is copied
+static int copies = 0;
+struct Counted {
+  int key;
+  Counted() : key(0) {}
+  Counted(int k) : key(k) {}
+  Counted(const Counted& other) : key(other.key) { ++copies; }
+  bool operator<(const Counted& other) const { return key < other.key; }
+  bool operator>(const Counted& other) const { return key > other.key; }
+};
+
 int main(int argc, char** argv) {
   /////////////////////////////////////////////////////////////////////////////
   // SET UP LIST NODES                                                       //
   /////////////////////////////////////////////////////////////////////////////
   
-  SmartPointer<ListNode<int> > tallerNode(new ListNode<int>(1));
-  SmartPointer<ListNode<int> > shorterNode(new ListNode<int>(2));
+  // heights come from a list's generator, as in the skip list
+  GeometricLevels levels;
+  HeapAllocator allocator;
+  ListNode<int>* tallerNode =
+    new ListNode<int>(1,levels.pickHeight(),3,&allocator);
+  ListNode<int>* shorterNode =
+    new ListNode<int>(2,levels.pickHeight(),3,&allocator);
   if(tallerNode->getHeight() < shorterNode->getHeight()) {
-    SmartPointer<ListNode<int> > temp = shorterNode;
+    ListNode<int>* temp = shorterNode;
     shorterNode = tallerNode;
     tallerNode = temp;
   }
-  TimeStampedArray<SmartPointer<ListNode<int> > >* tsa
-    = new TimeStampedArray<SmartPointer<ListNode<int> > >(0,tallerNode->getHeight());
+  ListNode<int>::TSA* tsa
+    = shorterNode->createNext(0);
   for(int i = 0; i < tsa->getSize(); ++i) {
     tsa->setElement(i,tallerNode);
   }
@@ -58,6 +74,23 @@ int main(int argc, char** argv) {
   
   assert(*iter == 1 || *iter == 2);
   cout << "Second node datum: " << *iter << endl;
+
+  cout << "Reading data without copying them...";
+  PersistentSkipList<Counted> counted;
+  for(int i = 0; i < 100; ++i)
+    counted.insert(Counted(i));
+  copies = 0;
+  int t = counted.getPresent();
+  int next_key = 0;
+  for(PSLIterator<Counted> it = counted.begin(t); it != counted.end(t); ++it)
+    assert(it->key == next_key++);
+  assert(next_key == 100);
+  assert((*counted.find(Counted(42),t)).key == 42);
+  assert(copies == 0);
+  cout << "success." << endl;
+
+  delete tallerNode;
+  delete shorterNode;
   
   // success
   return 0;
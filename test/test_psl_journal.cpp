@@ -0,0 +1,168 @@
+///////////////////////////////////////////////////////////////////////////////
+//                       Copyright (c) 2011 - 2012 by                        //
+//                                Simon Pratt                                //
+//                           (All rights reserved)                           //
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// FILE:    test_psl_journal.cpp                                             //
+//                                                                           //
+// MODULE:  Persistent Skip List                                             //
+//                                                                           //
+// NOTES:   Writes its journal to the current directory, and removes it      //
+//          when done.                                                       //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+#include <iostream>
+#include <fstream>
+#include <cassert>
+#include <cstdio>
+#include <vector>
+#include "../PersistentSkipList.hpp"
+
+using namespace std;
+using namespace persistent_skip_list;
+
+static const char* PATH = "test_psl_journal.tmp";
+
+// true if every version of both lists holds the same data
+static bool sameVersions(PersistentSkipList<int>& a,
+			 PersistentSkipList<int>& b) {
+  if(a.getPresent() != b.getPresent())
+    return false;
+  for(int t = 0; t <= a.getPresent(); ++t) {
+    PSLIterator<int> b_it = b.begin(t);
+    PSLIterator<int> b_end = b.end(t);
+    PSLIterator<int> a_end = a.end(t);
+    for(PSLIterator<int> a_it = a.begin(t); a_it != a_end; ++a_it) {
+      if(b_it == b_end || *a_it != *b_it)
+	return false;
+      ++b_it;
+    }
+    if(b_it != b_end)
+      return false;
+  }
+  return true;
+}
+
+int main(int argv, char** argc) {
+  remove(PATH);
+
+  /////////////////////////////////////////////////////////////////////////////
+  // Test recording changes                                                  //
+  /////////////////////////////////////////////////////////////////////////////
+  cout << "Recording a list over many versions...";
+  PSLJournal<int> journal(PATH);
+  PersistentSkipList<int> psl(2);
+  psl.setJournal(&journal);
+  for(int i = 0; i < 200; ++i) {
+    psl.insert((i * 37) % 200);
+    if(i % 10 == 0)
+      psl.incTime();
+  }
+  for(int i = 0; i < 200; i += 3) {
+    PSLIterator<int> found = psl.find(i,psl.getPresent());
+    found.remove();
+    // removed and inserted again within a version
+    if(i % 9 == 0)
+      psl.insert(i);
+    if(i % 30 == 0)
+      psl.incTime();
+  }
+  vector<int> sorted;
+  for(int i = 0; i < 100; ++i)
+    sorted.push_back(i * 5);
+  psl.incTime();
+  psl.bulkLoad(sorted.begin(),sorted.end());
+  PSLIterator<int> hint = psl.insert(1,psl.begin(psl.getPresent()));
+  psl.insert(2,hint);
+  psl.find(5,psl.getPresent()).remove();
+  psl.incTime();
+  vector<int> batch;
+  for(int i = 0; i < 50; ++i)
+    batch.push_back(i * 10 + 3);
+  psl.insertBatch(batch.begin(),batch.end());
+  psl.incTime();
+  // emptied, then filled again in one version
+  psl.bulkLoad(sorted.begin(),sorted.begin());
+  psl.insert(7);
+  psl.incTime();
+  psl.bulkLoad(sorted.begin(),sorted.begin());
+  journal.sync();
+  cout << "success." << endl;
+
+  /////////////////////////////////////////////////////////////////////////////
+  // Test replaying                                                          //
+  /////////////////////////////////////////////////////////////////////////////
+  cout << "Replaying every version...";
+  PersistentSkipList<int> replayed(2);
+  assert(replayed.replayJournal(PATH) > 0);
+  assert(sameVersions(psl,replayed));
+  assert(replayed.countRange(0,999,replayed.getPresent()) == 0);
+  cout << "success." << endl;
+
+  cout << "Replaying a missing journal...";
+  PersistentSkipList<int> missing;
+  assert(missing.replayJournal("test_psl_journal.missing") == 0);
+  assert(missing.empty(0));
+  cout << "success." << endl;
+
+  /////////////////////////////////////////////////////////////////////////////
+  // Test recovering from a partial record                                   //
+  /////////////////////////////////////////////////////////////////////////////
+  cout << "Ignoring a partial record...";
+  psl.setJournal(NULL);
+  int records;
+  {
+    PersistentSkipList<int> whole;
+    records = whole.replayJournal(PATH);
+  }
+  {
+    ofstream torn(PATH,ios::out | ios::binary | ios::app);
+    torn.put(PSLJournal<int>::INSERT);
+    torn.put(0);
+  }
+  {
+    PersistentSkipList<int> partial;
+    assert(partial.replayJournal(PATH) == records);
+  }
+  cout << "success." << endl;
+
+  cout << "Appending after a partial record...";
+  {
+    // sync every few records, rather than every version
+    PSLJournal<int> reopened(PATH,4);
+    psl.setJournal(&reopened);
+    for(int i = 0; i < 10; ++i)
+      psl.insert(i * 2 + 1000);
+    psl.incTime();
+    psl.insert(2000);
+    psl.setJournal(NULL);
+  }
+  {
+    PersistentSkipList<int> appended(2);
+    assert(appended.replayJournal(PATH) == records + 12);
+    assert(sameVersions(psl,appended));
+  }
+  cout << "success." << endl;
+
+  /////////////////////////////////////////////////////////////////////////////
+  // Test rejecting bad files                                                //
+  /////////////////////////////////////////////////////////////////////////////
+  cout << "Rejecting a journal of another type...";
+  try {
+    PersistentSkipList<double> wrong;
+    wrong.replayJournal(PATH);
+    assert(false);
+  } catch(const char*) {
+  }
+  try {
+    PSLJournal<double> wrong(PATH);
+    assert(false);
+  } catch(const char*) {
+  }
+  cout << "success." << endl;
+
+  remove(PATH);
+  // done
+  return 0;
+}
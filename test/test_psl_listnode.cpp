@@ -19,18 +19,26 @@
 using namespace persistent_skip_list;
 using namespace timestamped_array;
 
+// a node which keeps the widths of its links
+typedef ListNode<int,HeapAllocator,true> RankedNode;
+
 int main(int argv, char** argc) {
   
   cout << "Allocating ListNode<int> on stack...";
-  SmartPointer<ListNode<int> > tallerNode(new ListNode<int>(1));
-  SmartPointer<ListNode<int> > shorterNode(new ListNode<int>(2));
+  // heights come from a list's generator, as in the skip list
+  GeometricLevels levels;
+  HeapAllocator allocator;
+  ListNode<int>* tallerNode =
+    new ListNode<int>(1,levels.pickHeight(),3,&allocator);
+  ListNode<int>* shorterNode =
+    new ListNode<int>(2,levels.pickHeight(),3,&allocator);
   if(tallerNode->getHeight() < shorterNode->getHeight()) {
-    SmartPointer<ListNode<int> > temp = shorterNode;
+    ListNode<int>* temp = shorterNode;
     shorterNode = tallerNode;
     tallerNode = temp;
   }
-  SmartPointer<ListNode<int> > lnPos(new ListNode<int>(tallerNode->getHeight(),true));
-  SmartPointer<ListNode<int> > lnNeg(new ListNode<int>(tallerNode->getHeight(),false));
+  ListNode<int>* lnPos = new ListNode<int>(tallerNode->getHeight(),true);
+  ListNode<int>* lnNeg = new ListNode<int>(tallerNode->getHeight(),false);
   assert(lnPos->isPositiveInfinity());
   assert(lnNeg->isNegativeInfinity());
   cout << "success." << endl;
@@ -54,9 +62,9 @@ int main(int argv, char** argc) {
   assert(*lnPos         > *tallerNode);
   cout << "success." << endl;
 
-  cout << "Allocating TimeStampedArray<SmartPointer<ListNode<int> > > on stack...";
-  TimeStampedArray<SmartPointer<ListNode<int> > >* tsa
-    = new TimeStampedArray<SmartPointer<ListNode<int> > >(0,tallerNode->getHeight());
+  cout << "Allocating ListNode<int>::TSA...";
+  ListNode<int>::TSA* tsa
+    = shorterNode->createNext(0);
   cout << "success." << endl;
 
   cout << "Setting next element on tsa...";
@@ -65,6 +73,31 @@ int main(int argv, char** argc) {
   }
   cout << "success." << endl;
 
+  cout << "Setting widths on a ranked node's tsa...";
+  RankedNode* rankedNode = new RankedNode(2,false);
+  RankedNode::TSA* ranked_tsa = rankedNode->createNext(0);
+  for(int i = 0; i < ranked_tsa->getSize(); ++i) {
+    ranked_tsa->setElement(i,rankedNode);
+    assert(rankedNode->getWidth(ranked_tsa,i) == 0);
+    rankedNode->setWidth(ranked_tsa,i,i+1);
+  }
+  for(int i = 0; i < ranked_tsa->getSize(); ++i)
+    assert(rankedNode->getWidth(ranked_tsa,i) == i+1);
+  // the elements are unchanged by the widths
+  for(int i = 0; i < ranked_tsa->getSize(); ++i)
+    assert(ranked_tsa->getElement(i) == rankedNode);
+  // only a ranked node has room for them
+  assert(ListNode<int>::getStorageSize(3,2) < RankedNode::getStorageSize(3,2));
+  cout << "success." << endl;
+
+  cout << "Copying widths with next pointers...";
+  RankedNode::TSA* copied_tsa = rankedNode->createNext(0,*ranked_tsa);
+  for(int i = 0; i < copied_tsa->getSize(); ++i)
+    assert(rankedNode->getWidth(copied_tsa,i) == i+1);
+  rankedNode->destroyNext(copied_tsa);
+  rankedNode->addNext(ranked_tsa);
+  cout << "success." << endl;
+
   cout << "Adding next to list node...";
   shorterNode->addNext(tsa);
   cout << "success." << endl;
@@ -77,17 +110,112 @@ int main(int argv, char** argc) {
   cout << "success." << endl;
 
   cout << "Getting next pointer at given index...";
-  TimeStampedArray<SmartPointer<ListNode<int> > >* change =
+  ListNode<int>::TSA* change =
     shorterNode->getNextAtIndex(index);
   assert(change == tsa);
   cout << "success." << endl;
 
   cout << "Getting next pointer at index+1...";
-  TimeStampedArray<SmartPointer< ListNode<int> > >* change2 =
+  ListNode<int>::TSA* change2 =
     shorterNode->getNext(1);
   assert(change2 == tsa);
   cout << "success." << endl;
 
+  cout << "Testing isFull...";
+  ListNode<int>* smallNode = new ListNode<int>(1,false,1);
+  assert(! smallNode->isFull(0));
+  ListNode<int>::TSA* small_tsa
+    = smallNode->createNext(0);
+  for(int i = 0; i < small_tsa->getSize(); ++i)
+    small_tsa->setElement(i,lnPos);
+  smallNode->addNext(small_tsa);
+  assert(! smallNode->isFull(0));
+  assert(smallNode->isFull(1));
+  cout << "success." << endl;
+
+  cout << "Copying a full node...";
+  ListNode<int>* copyNode = new ListNode<int>(*smallNode);
+  assert(copyNode->getHeight() == smallNode->getHeight());
+  assert(copyNode->isNegativeInfinity());
+  assert(copyNode->numberOfNextChangeIndices() == 0);
+  assert(! copyNode->isFull(1));
+  cout << "success." << endl;
+
+  cout << "Changing only the upper levels...";
+  RankedNode* deltaNode = new RankedNode(4,false,3);
+  RankedNode* deltaTail = new RankedNode(4,true);
+  RankedNode::TSA* full = deltaNode->createNext(0);
+  for(int i = 0; i < 4; ++i) {
+    deltaNode->setLink(full,i,deltaTail);
+    deltaNode->setWidth(full,i,i+1);
+  }
+  deltaNode->addNext(full);
+  RankedNode::TSA* upper = deltaNode->createNext(1,*full,2);
+  assert(upper->getSize() == 2);
+  assert(deltaNode->getLowest(upper) == 2);
+  deltaNode->setWidth(upper,3,10);
+  deltaNode->addNext(upper);
+  // the levels below are read from the change before
+  assert(deltaNode->getWidth(deltaNode->getNext(1),0) == 1);
+  assert(deltaNode->getLink(deltaNode->getNext(1),1) == deltaTail);
+  assert(deltaNode->getWidth(deltaNode->getNext(1),3) == 10);
+  assert(deltaNode->getWidth(deltaNode->getNext(0),3) == 4);
+  // a change at the same time replaces it, keeping its levels
+  RankedNode::TSA* lower = deltaNode->createNext(1,*upper,1);
+  assert(deltaNode->getLowest(lower) == 1);
+  deltaNode->setWidth(lower,1,20);
+  deltaNode->addNext(lower);
+  assert(deltaNode->numberOfNextChangeIndices() == 2);
+  assert(deltaNode->getWidth(deltaNode->getNext(1),0) == 1);
+  assert(deltaNode->getWidth(deltaNode->getNext(1),1) == 20);
+  assert(deltaNode->getWidth(deltaNode->getNext(1),3) == 10);
+  assert(deltaNode->getWidth(deltaNode->getNext(0),1) == 2);
+  cout << "success." << endl;
+
+  cout << "Getting next pointers at many times...";
+  RankedNode::TSA* third = deltaNode->createNext(4,*lower,3);
+  deltaNode->addNext(third);
+  int at[] = { 0, 1, 1, 3, 4, 9 };
+  RankedNode::TSA* nexts[6];
+  deltaNode->getNexts(at,6,nexts);
+  for(int i = 0; i < 6; ++i)
+    assert(nexts[i] == deltaNode->getNext(at[i]));
+  cout << "success." << endl;
+
+  cout << "Placing a node in one block with its storage...";
+  size_t bytes = sizeof(ListNode<int>) + ListNode<int>::getStorageSize(3,2);
+  HeapAllocator heap;
+  void* block = heap.allocate(bytes);
+  ListNode<int>* placed = new (block) ListNode<int>(5,3,2,&heap,
+						     (ListNode<int>*)block + 1);
+  ListNode<int>* placedTail = new ListNode<int>(3,true);
+  ListNode<int>::TSA* first = placed->createNext(0);
+  for(int i = 0; i < 3; ++i)
+    placed->setLink(first,i,placedTail);
+  placed->addNext(first);
+  // the first change is in the block, later ones aren't
+  assert((char*)first > (char*)block && (char*)first < (char*)block + bytes);
+  assert(placed->getBytes() == bytes);
+  ListNode<int>::TSA* second = placed->createNext(1,*first,2);
+  placed->addNext(second);
+  assert(placed->getBytes() > bytes);
+  assert(placed->getLink(placed->getNext(1),2) == placedTail);
+  placed->~ListNode<int>();
+  heap.deallocate(block,bytes);
+  delete placedTail;
+  cout << "success." << endl;
+
+  // nodes outside a skip list are owned by whoever created them
+  delete tallerNode;
+  delete shorterNode;
+  delete lnPos;
+  delete lnNeg;
+  delete smallNode;
+  delete copyNode;
+  delete rankedNode;
+  delete deltaNode;
+  delete deltaTail;
+
   // success
   return 0;
 }
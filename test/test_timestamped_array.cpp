@@ -12,6 +12,7 @@
 //                                                                           //
 ///////////////////////////////////////////////////////////////////////////////
 #include <iostream>
+#include <utility>
 #include "../TimeStampedArray.hpp"
 
 using namespace std;
@@ -67,6 +68,13 @@ int main(int argv, char** argc) {
   tsa_copy->lock();
   testTSA(*tsa_copy);
 
+  // Move a TSA, leaving the original empty
+  TimeStampedArray<int> moved(std::move(*tsa_copy));
+  assert(tsa_copy->getSize() == 0);
+  assert(moved.getSize() == 3 && moved.getElement(1) == 3);
+  cout << "Structure moved successfully." << endl;
+  testTSA(moved);
+
   // test destructor
   delete tsa_copy;
   cout << "Structure deleted successfully." << endl;